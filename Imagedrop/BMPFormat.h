@@ -17,6 +17,15 @@ BitCount specifies the color resolution of the bitmap, and values are:
 #pragma once
 
 #include "ImageFormatBase.h"
+#include "MappedFile.h"
+#include "FileWriter.h"
+#include "ByteOrder.h"
+#include "ImageBuffer.h"
+#include "Profiler.h"
+#include "Resampler.h"
+
+//BitmapFileHeader + BitmapInfoHeader
+static const size_t bmpHeaderSize = 54;
 
 class BMP_Format : public ImageFormatBase
 {
@@ -41,22 +50,52 @@ public:
 	uint32_t m_ColorsUsed;				//[4bytes]	-	The number of colors used in the bitmap (in the color palette). If this set to 0 the number of colors is calculated using the m_BitCount structure member
 	uint32_t m_ColorsImportant;			//[4bytes]	-	The number of colors that are important for the bitmap. Set to 0 when all colors are important. And generally ignored value
 
-	std::vector<uint8_t> m_Pixels;
+	//a mapped read leaves the pixels inside the file mapping, m_Image is just a view over them then
+	//the rows are kept in the file order (bottom-up or top-down) with the file stride (padded to 4 bytes)
+	MappedFile m_Mapping;
+	ImageBuffer m_Image;
+	bool m_FlipRows;					//the pixels are in the other rows order than the header says (a converted TGA), reversed on their way out
+	bool m_MirrorColumns;				//the pixels are right-to-left (a converted TGA), a BMP has no such origin so the columns get reversed on their way out
 
 	BMP_Format()
 	{
 		ImageFormat = EImageFormat::BMP;
+		m_FlipRows = false;
+		m_MirrorColumns = false;
 	}
 	~BMP_Format()
 	{
-		m_Pixels.clear();
-		m_Pixels.shrink_to_fit();
+		m_Image.Release();
 	}
 
 	size_t SizeInBytes() override
 	{
 		//this shall match the size found in [Right click-> properties] within explorer, if not, then there is an issue
-		return (m_Width * m_Height * m_BitCount / 8);
+		//a top-down bitmap has a negative height, the rows count is what matters here
+		return (size_t(m_Width) * RowsCount() * m_BitCount / 8);
+	}
+
+	//A negative height is a top-down bitmap, the rows count is the same either way
+	uint32_t RowsCount() const
+	{
+		return int32_t(m_Height) < 0 ? uint32_t(-int32_t(m_Height)) : m_Height;
+	}
+
+	//A negative height, the first row in the file is the top one
+	bool IsTopDown() const
+	{
+		return int32_t(m_Height) < 0;
+	}
+
+	//The pixel array as it is in the file, padding included
+	size_t PixelArraySize() const
+	{
+		return size_t(RowStride(m_Width, m_BitCount)) * RowsCount();
+	}
+
+	EPixelFormat PixelFormat() const
+	{
+		return ImageBuffer::FromDepth(m_BitCount);
 	}
 
 	uint32_t IsGrayScale(const BMP_Format &format)
@@ -91,20 +130,126 @@ public:
 			);
 	}
 
-	void OnImageRead(const char *path) override
+	//Decodes the 54 bytes of the BitmapFileHeader & the BitmapInfoHeader, the fields are little endian & packed
+	void ParseHeader(const uint8_t *data)
+	{
+		m_Type = ByteOrder::Read16(data + 0);
+		m_FileSize = ByteOrder::Read32(data + 2);
+		m_Reserved1 = ByteOrder::Read16(data + 6);
+		m_Reserved2 = ByteOrder::Read16(data + 8);
+		m_OffsetBits = ByteOrder::Read32(data + 10);
+
+		m_Size = ByteOrder::Read32(data + 14);
+		m_Width = ByteOrder::Read32(data + 18);
+		m_Height = ByteOrder::Read32(data + 22);
+		m_Planes = ByteOrder::Read16(data + 26);
+		m_BitCount = ByteOrder::Read16(data + 28);
+		m_Compression = ByteOrder::Read32(data + 30);
+		m_SizeImage = ByteOrder::Read32(data + 34);
+		m_XPelsPerMeter = ByteOrder::Read32(data + 38);
+		m_YPelsPerMeter = ByteOrder::Read32(data + 42);
+		m_ColorsUsed = ByteOrder::Read32(data + 46);
+		m_ColorsImportant = ByteOrder::Read32(data + 50);
+	}
+
+	//The other way around, the 54 bytes as they go in the file
+	void PackHeader(uint8_t *data) const
+	{
+		ByteOrder::Write16(data + 0, m_Type);
+		ByteOrder::Write32(data + 2, m_FileSize);
+		ByteOrder::Write16(data + 6, m_Reserved1);
+		ByteOrder::Write16(data + 8, m_Reserved2);
+		ByteOrder::Write32(data + 10, m_OffsetBits);
+
+		ByteOrder::Write32(data + 14, m_Size);
+		ByteOrder::Write32(data + 18, m_Width);
+		ByteOrder::Write32(data + 22, m_Height);
+		ByteOrder::Write16(data + 26, m_Planes);
+		ByteOrder::Write16(data + 28, m_BitCount);
+		ByteOrder::Write32(data + 30, m_Compression);
+		ByteOrder::Write32(data + 34, m_SizeImage);
+		ByteOrder::Write32(data + 38, m_XPelsPerMeter);
+		ByteOrder::Write32(data + 42, m_YPelsPerMeter);
+		ByteOrder::Write32(data + 46, m_ColorsUsed);
+		ByteOrder::Write32(data + 50, m_ColorsImportant);
+	}
+
+	/*
+	The whole file as bytes in memory (the mapping, or a buffer handed over by the caller), the headers are parsed
+	straight from there & the pixels are left in place, m_Image is a view over them.
+	Only BI_RGB can stay in place, anything else (or bytes cut short) returns false.
+	*/
+	bool ReadSpan(const uint8_t *data, size_t size)
 	{
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
-#endif // USE_LOG_TIME
+		if (size < bmpHeaderSize)
+			return false;
+
+		//same decoding as the buffered read
+		ParseHeader(data);
+
+		if (m_BitCount < 24)
+		{
+			LOG_ERROR("m_imagePixelDepth is neither 32b nor 24b");
+			THROW_ERROR("m_imagePixelDepth is neither 32b nor 24b");
+		}
 
+		if (m_Compression != BMP_COMPRESSION_METHOD_BI_RGB || size_t(m_OffsetBits) + PixelArraySize() > size)
+			return false;
+
+		m_Image.View(data + m_OffsetBits, m_Width, RowsCount(), PixelFormat(), RowStride(m_Width, m_BitCount));
+		PROFILE_COUNT(BytesRead, PixelArraySize());
+		return true;
+	}
+
+	//The zero-copy read, the file is mapped & read by ReadSpan(), false sends it through the buffered read
+	bool ReadMapped(const char *path)
+	{
+		if (!m_Mapping.Open(path))
+			return false;
+
+		if (!ReadSpan(m_Mapping.m_Data, m_Mapping.m_Size))
+		{
+			m_Mapping.Close();
+			return false;
+		}
+		return true;
+	}
+
+	//A whole BMP file already in memory, the pixels stay a view over data, keep it alive
+	void OnImageDecode(const uint8_t *data, size_t size) override
+	{
+		PROFILE_SCOPE("read");
+
+		if (!ReadSpan(data, size))
+		{
+			LOG_ERROR("BMP data is cut short or compressed");
+			THROW_ERROR("BMP data is cut short or compressed");
+		}
+
+		LOG("Decoded " << m_Width << "x" << RowsCount() << " " << size_t(m_BitCount) << "bit BMP from memory");
+	}
+
+	//A read that has to get all its bytes, the file gets closed & it throws if it's cut short
+	static void ReadFully(void *data, size_t size, FILE *file)
+	{
+		if (size > 0 && fread(data, size, 1, file) != 1)
+		{
+			fclose(file);
+			LOG_ERROR("BMP file is cut short");
+			THROW_ERROR("BMP file is cut short");
+		}
+	}
+
+	//The plain fread of the headers & the pixel array
+	void ReadBuffered(const char *path)
+	{
 		//open the file
 		//I usually use fopen, but at the same time didn't want to hide warnings with _CRT_SECURE_NO_WARNINGS in a job application test, so used the secure one
 		FILE *_file;
 		fopen_s(&_file, path, "rb");
-		LOG(path);
 		if (_file == NULL)
 		{
-			LOG("ERR	fopen is NULL [Read]");
+			LOG_ERROR("fopen is NULL [Read]");
 			THROW_ERROR("fopen is NULL  [Read]");
 		}
 
@@ -128,78 +273,56 @@ public:
 		uint32_t m_ColorsUsed;				//[4bytes]	-	The number of colors used in the bitmap (in the color palette). If this set to 0 the number of colors is calculated using the m_BitCount structure member
 		uint32_t m_ColorsImportant;			//[4bytes]	-	The number of colors that are important for the bitmap. Set to 0 when all colors are important. And generally ignored value
 		*/
-		fread(&m_Type, 2, 1, _file);
-		fread(&m_FileSize, 4, 1, _file);
-		fread(&m_Reserved1, 2, 1, _file);
-		fread(&m_Reserved2, 2, 1, _file);
-		fread(&m_OffsetBits, 4, 1, _file);
-
-		fread(&m_Size, 4, 1, _file);
-		fread(&m_Width, 4, 1, _file);
-		fread(&m_Height, 4, 1, _file);
-		fread(&m_Planes, 2, 1, _file);
-		fread(&m_BitCount, 2, 1, _file);
-		fread(&m_Compression, 4, 1, _file);
-		fread(&m_SizeImage, 4, 1, _file);
-		fread(&m_XPelsPerMeter, 4, 1, _file);
-		fread(&m_YPelsPerMeter, 4, 1, _file);
-		fread(&m_ColorsUsed, 4, 1, _file);
-		fread(&m_ColorsImportant, 4, 1, _file);
+		//both headers in one read
+		uint8_t _header[bmpHeaderSize] = {};
+		ReadFully(_header, bmpHeaderSize, _file);
+		ParseHeader(_header);
 
 		if (m_BitCount < 24)
 		{
-			LOG("ERR	m_imagePixelDepth is neither 32b nor 24b");
+			fclose(_file);
+			LOG_ERROR("m_imagePixelDepth is neither 32b nor 24b");
 			THROW_ERROR("m_imagePixelDepth is neither 32b nor 24b");
 		}
 
-		//TODO::Read the pixels data of the bmp
-		//It's a good place to check if any of the read values is invalid, if needed.
-
-		//Resolve the core required data
-		/*
-		if (format.m_colorMapType == TGA_COLOR_MAP_TYPE_PRESENT)
+		if (IsCompressed(*this))
 		{
-			format.m_colorMapData = (uint8_t*)malloc((format.m_colorMapFirstEntryIndex + format.m_colorMapLength) * format.m_colorMapEntrySize / 8);
-
-			if (format.m_colorMapData == NULL)
-			{
-				LOG("ERR	m_colorMapData is NULL");
-				THROW_ERROR("m_colorMapData is NULL");
-			}
-
-			fread(&format.m_colorMapData + (format.m_colorMapFirstEntryIndex * format.m_colorMapEntrySize / 8), format.m_colorMapLength * format.m_colorMapEntrySize / 8, 1, _file);
+			fclose(_file);
+			LOG_ERROR("Compressed BMP not supported yet!");
+			THROW_ERROR("Compressed BMP not supported yet!");
 		}
 
-		format.m_pixels.resize(SizeInBytes(format));
+		//the pixel array, as it is in the file (padded rows, bottom-up unless the height is negative)
+		//the pooled block holds whatever the last image left, a short read must not pass
+		m_Image.Allocate(m_Width, RowsCount(), PixelFormat(), RowStride(m_Width, m_BitCount));
+		fseek(_file, m_OffsetBits, SEEK_SET);
+		ReadFully(m_Image.m_Data, PixelArraySize(), _file);
+		PROFILE_COUNT(BytesRead, PixelArraySize());
 
-		//check for RLE
-		if (IsCompressed(format))
-		{
-			LOG("ERR	RLE not supported yet!");
-			THROW_ERROR("RLE not supported yet!");
-		}
-		else
-		{
-			fread(&format.m_pixels[0], SizeInBytes(format), 1, _file);
-		}
-
-		format.m_channels = format.m_imageWidth * (format.m_imagePixelDepth > 24 ? format.m_imagePixelDepth > 16 ? 4 : 3 : 3);
-		*/
+		//It's a good place to check if any of the read values is invalid, if needed.
 
 		//close the file
 		fclose(_file);
+	}
+
+	void OnImageRead(const char *path) override
+	{
+		PROFILE_SCOPE("read");
+
+		LOG(path);
 
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _endTime = std::chrono::high_resolution_clock::now();
-		std::chrono::duration<float> _duration = _endTime - _startTime;
-		LOG("Time Spent - Reading: " << _duration.count()* 1000.f << "ms");
-#endif // USE_LOG_TIME
+		//BI_RGB is mapped & read in place, anything else (or a failed mapping) goes through fread
+		if (USE_MAPPED_READ == 0 || !ReadMapped(path))
+			ReadBuffered(path);
 
 #ifdef USE_LOG_IMAGE_DATA
-		if (m_Pixels.size() != 0)
-			LOG(m_Pixels.data());
+		//a peek at the first bytes, the pixels aren't a string to print
+		if (m_Image.IsView())
+			LOG_DEBUG("Pixels mapped in place: " << Logger::Hex(m_Image.m_Data, PixelArraySize()));
+		else if (!m_Image.IsEmpty())
+			LOG_DEBUG("Pixels: " << Logger::Hex(m_Image.m_Data, PixelArraySize()));
 		else
-			LOG("ERR, the pixels vector is empty or null!");
+			LOG_WARNING("the pixels vector is empty or null!");
 #endif // USE_LOG_IMAGE_DATA
 
 		LOG("=================R=E=A=D====B=M=P===============");
@@ -210,7 +333,162 @@ public:
 		LOG("================================================");
 	}
 
-	void OnImageWrite(const char *path) override {}
+	//Rows are padded to 4 bytes
+	static long RowStride(uint32_t width, uint16_t bitCount)
+	{
+		return long((width * bitCount / 8 + 3) & ~3u);
+	}
+
+	//Writes the BitmapFileHeader & the BitmapInfoHeader, the pixel array comes next
+	void WriteHeader(FileWriter &file)
+	{
+		uint8_t _header[bmpHeaderSize];
+		PackHeader(_header);
+		file.Write(_header, bmpHeaderSize);
+	}
+
+	void OnImageWrite(const char *path) override
+	{
+		LOG("===================W=R=I=T=E====================");
+		LOG("ImageWidth: " << m_Width);
+		LOG("ImageHeigh: " << m_Height);
+		LOG("ImageSize: " << SizeInBytes() << "Bytes");
+		LOG("ImageBitsPerPixel: " << size_t(m_BitCount) << "bit");
+		LOG("================================================");
+
+		PROFILE_SCOPE("write");
+
+		//the headers & the pixel array are gathered in one buffer, a small image goes out in a single write
+		FileWriter _file;
+		bool _opened = _file.Open(path, bmpHeaderSize + PixelArraySize());
+		LOG(path);
+		if (!_opened)
+		{
+			LOG_ERROR("fopen is NULL [Write]");
+			THROW_ERROR("fopen is NULL [Write]");
+		}
+
+		WriteImage(_file);
+
+		_file.Close();
+	}
+
+	//The same bytes OnImageWrite() puts in the file, appended to output instead
+	void OnImageEncode(std::vector<uint8_t> &output) override
+	{
+		PROFILE_SCOPE("write");
+
+		FileWriter _memory;
+		_memory.Open(output, bmpHeaderSize + PixelArraySize());
+		WriteImage(_memory);
+		_memory.Close();
+	}
+
+	//The whole file, to disk or to memory
+	void WriteImage(FileWriter &file)
+	{
+		WriteHeader(file);
+
+		//the pixel array is kept padded & in the file row order, so it goes out in one write
+		long _fileStride = RowStride(m_Width, m_BitCount);
+		bool _sameChannels = m_Image.Channels() == m_BitCount / 8;
+		if (!m_Image.IsEmpty())
+			PROFILE_COUNT(BytesWritten, PixelArraySize());
+		if (!m_Image.IsEmpty() && m_Image.m_Stride == _fileStride && _sameChannels && !m_FlipRows && !m_MirrorColumns)
+		{
+			file.Write(m_Image.m_Data, PixelArraySize());
+		}
+		else if (!m_Image.IsEmpty() && _sameChannels && !m_MirrorColumns)
+		{
+			//pixels with a stride or a rows order of their own, every row gets the file padding on its way out
+			static const uint8_t _padding[4] = { 0, 0, 0, 0 };
+			for (int y = 0; y < m_Image.m_Height; y++)
+			{
+				file.Write(m_Image.Row(m_FlipRows ? m_Image.m_Height - 1 - y : y), m_Image.RowBytes());
+				file.Write(_padding, _fileStride - m_Image.RowBytes());
+			}
+		}
+		else if (!m_Image.IsEmpty())
+		{
+			//8bit gray (a converted TGA) goes out as 24bit & right-to-left columns get mirrored, a row at a time into the padded file row
+			const int _channels = m_Image.Channels();
+			const int _fileChannels = m_BitCount / 8;
+			std::vector<uint8_t> _row(_fileStride, 0);
+			for (int y = 0; y < m_Image.m_Height; y++)
+			{
+				const uint8_t *_pixels = m_Image.Row(m_FlipRows ? m_Image.m_Height - 1 - y : y);
+				for (int x = 0; x < m_Image.m_Width; x++)
+				{
+					const uint8_t *_pixel = _pixels + size_t(m_MirrorColumns ? m_Image.m_Width - 1 - x : x) * _channels;
+					for (int c = 0; c < _fileChannels; c++)
+						_row[x * _fileChannels + c] = _pixel[_channels == 1 ? 0 : c];
+				}
+				file.Write(_row.data(), _fileStride);
+			}
+		}
+	}
 
-	void OnImageResize(ImageFormatBase &newFormat, float resizeMultiplier) override {}
+	//Fills the headers of the resized version, everything but the pixels. The result is always a plain BI_RGB bitmap
+	void ResizedHeader(BMP_Format &newFormat, float resizeMultiplier)
+	{
+		uint32_t _rows = uint32_t(float(RowsCount())*resizeMultiplier);
+
+		newFormat.m_Type = m_Type;
+		newFormat.m_Reserved1 = 0;
+		newFormat.m_Reserved2 = 0;
+		newFormat.m_OffsetBits = uint32_t(bmpHeaderSize);
+
+		newFormat.m_Size = uint32_t(bmpHeaderSize) - 14;
+		newFormat.m_Width = uint32_t(float(m_Width)*resizeMultiplier);
+		//keep the rows order of the source, a top-down source gives a top-down result
+		newFormat.m_Height = int32_t(m_Height) < 0 ? uint32_t(-int32_t(_rows)) : _rows;
+		newFormat.m_Planes = 1;
+		newFormat.m_BitCount = m_BitCount;
+		newFormat.m_Compression = BMP_COMPRESSION_METHOD_BI_RGB;
+		newFormat.m_XPelsPerMeter = m_XPelsPerMeter;
+		newFormat.m_YPelsPerMeter = m_YPelsPerMeter;
+		newFormat.m_ColorsUsed = 0;
+		newFormat.m_ColorsImportant = 0;
+
+		newFormat.m_SizeImage = uint32_t(newFormat.PixelArraySize());
+		newFormat.m_FileSize = newFormat.m_OffsetBits + newFormat.m_SizeImage;
+	}
+
+	//The depth & origin a resize asks for, on the headers of the resized version. The origin is the sign of the height
+	void ResizedLayout(BMP_Format &newFormat, const ResampleSettings &settings)
+	{
+		//no gray without a palette, 8bit is kept as gray pixels & the writer widens them to 24bit on their way out
+		if (settings.m_OutputDepth != 0)
+			newFormat.m_BitCount = settings.m_OutputDepth == 32 ? BMP_PIXEL_FORMAT_32_BPP : BMP_PIXEL_FORMAT_24_BPP;
+		if (settings.m_Origin != EOutputOrigin::KeepOrigin)
+			newFormat.m_Height = settings.m_Origin == EOutputOrigin::TopLeft ? uint32_t(-int32_t(newFormat.RowsCount())) : newFormat.RowsCount();
+
+		newFormat.m_SizeImage = uint32_t(newFormat.PixelArraySize());
+		newFormat.m_FileSize = newFormat.m_OffsetBits + newFormat.m_SizeImage;
+	}
+
+	/*
+	The rows are resampled in the order they are in the file, bottom-up or top-down, the result keeps the same
+	order unless another origin is asked for, then the store step flips them. The padding is just the stride, the
+	shared resampler skips it.
+	*/
+	void OnImageResize(BMP_Format &newFormat, float resizeMultiplier, const ResampleSettings &settings = ResampleSettings())
+	{
+		PROFILE_SCOPE("resize");
+
+		ResizedHeader(newFormat, resizeMultiplier);
+		ResizedLayout(newFormat, settings);
+
+		//the file stride rather than the aligned one, so the result is written in a single go. The padding bytes are zeros
+		//(gray pixels aren't the file ones, they get aligned rows)
+		EPixelFormat _format = settings.OutputFormat(m_Image.m_Format);
+		long _stride = _format == EPixelFormat::Gray8 ? 0 : RowStride(newFormat.m_Width, newFormat.m_BitCount);
+		newFormat.m_Image.Allocate(newFormat.m_Width, newFormat.RowsCount(), _format, _stride);
+		newFormat.m_Image.ClearPadding();
+
+		Resampler _resampler;
+		_resampler.Configure(resizeMultiplier, settings);
+		_resampler.Orient(IsTopDown() != newFormat.IsTopDown(), false, false);
+		_resampler.Resize(m_Image, newFormat.m_Image);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,415 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include "Macros.h"
+#include "ImageJob.h"
+#include "ImageIndex.h"
+#include "BatchManifest.h"
+#include "ThreadPool.h"
+
+/*
+The batch mode, many images in a single run of the exe
+- The inputs come from a directory (all the supported images inside it, recursively), a glob
+	(D:\images\*_albedo.tga, wildcards in the file name only) or a manifest (a text file, one path per line)
+- Images run concurrently on the shared pool, each of them can still split into bands on the same pool
+- The decoded bytes in flight are capped, an image is only handed to the pool once its budget is granted, so a
+	folder of huge TGAs can't eat the whole RAM. An image bigger than the cap alone still runs, just alone.
+	The budget is waited for by the thread handing the images out, never inside a pool task: a task blocked on it
+	could sit under the stack of the very image holding the budget (nested ParallelFor helping) & never wake up.
+- A failing image is logged & counted, it never stops the rest of the batch
+- With --out, the results of a directory keep their subdirectories under it (src/a/x.tga -> out/a/x.tga). Two inputs
+	that would still write the same result (a glob or a manifest from many directories) are failed before anything runs
+- With an index from the probe mode (--index=PATH) the budget comes from the real decoded sizes & the biggest
+	images start first, so the small ones fill the end of the batch instead of a big one running alone last
+- The incremental mode (--incremental) skips the inputs a previous run already did & that didn't change since,
+	a stat of the input & of its result against the manifest (BatchManifest.h)
+*/
+class BatchJob
+{
+public:
+	std::vector<std::string> m_Inputs;
+	std::string m_OutputDirectory;				//empty means next to every source, with the _RESIZED suffix
+	std::string m_Root;							//the directory the inputs were collected from, empty for a glob or a manifest
+	std::string m_OutputExtension;				//.tga or .bmp to convert the results, empty keeps the source one
+	ImageJobOptions m_Options;
+	uint64_t m_MaxInFlightBytes;
+	std::map<std::string, ImageIndexEntry> m_Index;	//by path, as the inputs are collected
+	std::string m_ManifestPath;					//empty means not incremental
+	BatchManifest m_Manifest;
+	std::vector<BatchManifestEntry> m_Records;	//per input, what goes in the next manifest
+	std::vector<char> m_Recorded;				//per input, done or skipped (not a vector<bool>, the workers write it in parallel)
+
+	//results
+	std::atomic<int> m_Succeeded;
+	std::atomic<int> m_Failed;
+	std::atomic<int> m_Skipped;
+	std::atomic<uint64_t> m_Pixels;
+	std::atomic<uint64_t> m_BytesRead;
+	std::atomic<uint64_t> m_BytesWritten;
+	std::mutex m_FailuresLock;
+	std::vector<std::string> m_Failures;
+
+	//the in flight memory budget
+	std::mutex m_BudgetLock;
+	uint64_t m_InFlightBytes;
+
+	BatchJob(const ImageJobOptions &options, uint64_t maxInFlightBytes)
+	{
+		m_Options = options;
+		m_MaxInFlightBytes = maxInFlightBytes;
+		m_Succeeded = 0;
+		m_Failed = 0;
+		m_Skipped = 0;
+		m_Pixels = 0;
+		m_BytesRead = 0;
+		m_BytesWritten = 0;
+		m_InFlightBytes = 0;
+	}
+
+	//A simple wildcard match, * for any run of characters & ? for a single one
+	static bool MatchGlob(const char *pattern, const char *name)
+	{
+		if (*pattern == '\0')
+			return *name == '\0';
+
+		if (*pattern == '*')
+			return MatchGlob(pattern + 1, name) || (*name != '\0' && MatchGlob(pattern, name + 1));
+
+		if (*name != '\0' && (*pattern == '?' || *pattern == *name))
+			return MatchGlob(pattern + 1, name + 1);
+
+		return false;
+	}
+
+	void CollectInputs(const std::string &source)
+	{
+		if (source.find_first_of("*?") == std::string::npos && std::experimental::filesystem::is_directory(source))
+			m_Root = source;
+		Collect(source, m_Inputs);
+	}
+
+	//The images of a directory, a glob or a manifest, the probe mode collects its inputs the same way
+	static void Collect(const std::string &source, std::vector<std::string> &inputs)
+	{
+		namespace fs = std::experimental::filesystem;
+		fs::path _source = source;
+
+		if (source.find_first_of("*?") != std::string::npos)
+		{
+			fs::path _directory = _source.has_parent_path() ? _source.parent_path() : fs::path(".");
+			std::string _pattern = _source.filename().string();
+
+			for (fs::directory_iterator _entry(_directory), _end; _entry != _end; ++_entry)
+			{
+				if (fs::is_regular_file(_entry->status()) && MatchGlob(_pattern.c_str(), _entry->path().filename().string().c_str()))
+					inputs.push_back(_entry->path().string());
+			}
+		}
+		else if (fs::is_directory(_source))
+		{
+			for (fs::recursive_directory_iterator _entry(_source), _end; _entry != _end; ++_entry)
+			{
+				if (fs::is_regular_file(_entry->status()) && ImageJob::IsSupported(_entry->path().string()))
+					inputs.push_back(_entry->path().string());
+			}
+		}
+		else
+		{
+			std::ifstream _manifest(source);
+			if (!_manifest)
+			{
+				LOG_ERROR("Can't open the batch manifest " << source);
+				THROW_ERROR("Can't open the batch manifest");
+			}
+
+			std::string _line;
+			while (std::getline(_manifest, _line))
+			{
+				//tolerate windows line endings & empty lines
+				if (!_line.empty() && _line.back() == '\r')
+					_line.pop_back();
+				if (!_line.empty())
+					inputs.push_back(_line);
+			}
+		}
+	}
+
+	std::string OutputPath(const std::string &inputPath)
+	{
+		std::experimental::filesystem::path _path;
+		if (m_OutputDirectory.empty())
+		{
+			_path = ImageJob::ResizedPath(inputPath);
+		}
+		else
+		{
+			//the path under the collected directory, the inputs of a directory all start with it
+			_path = m_OutputDirectory;
+			if (!m_Root.empty() && inputPath.compare(0, m_Root.size(), m_Root) == 0)
+			{
+				size_t _start = inputPath.find_first_not_of("/\\", m_Root.size());
+				_path /= inputPath.substr(_start == std::string::npos ? inputPath.size() : _start);
+			}
+			else
+			{
+				_path /= std::experimental::filesystem::path(inputPath).filename();
+			}
+		}
+
+		if (!m_OutputExtension.empty())
+			_path.replace_extension(m_OutputExtension);
+		return _path.string();
+	}
+
+	//false if the index can't be read, the batch runs without it then
+	bool LoadIndex(const std::string &path)
+	{
+		ImageIndex _index;
+		if (!_index.Load(path))
+			return false;
+
+		for (size_t i = 0; i < _index.m_Entries.size(); i++)
+			m_Index[_index.m_Entries[i].m_Path] = _index.m_Entries[i];
+		return true;
+	}
+
+	//The decoded source + the resized result, from the index if the file didn't change since, or else from the file size
+	uint64_t EstimateBytes(const std::string &inputPath)
+	{
+		//a streamed image only holds a few blocks of rows, nothing worth waiting for (an RLE one or a BMP result isn't streamed)
+		if (ImageJob::Streams(inputPath, OutputPath(inputPath), m_Options))
+			return 0;
+
+		auto _entry = m_Index.find(inputPath);
+		int64_t _modifiedTime;
+		uint64_t _fileSize;
+		if (_entry != m_Index.end() && _entry->second.m_Supported && ImageIndex::Stat(inputPath, _modifiedTime, _fileSize) &&
+			_modifiedTime == _entry->second.m_ModifiedTime && _fileSize == _entry->second.m_FileSize)
+			return _entry->second.DecodedBytes(m_Options.m_ResizeMultiplier);
+
+		std::error_code _error;
+		uint64_t _size = std::experimental::filesystem::file_size(inputPath, _error);
+		if (_error)
+			return 0;
+
+		return _size + uint64_t(double(_size) * m_Options.m_ResizeMultiplier * m_Options.m_ResizeMultiplier);
+	}
+
+	uint64_t IndexedPixels(const std::string &inputPath) const
+	{
+		auto _entry = m_Index.find(inputPath);
+		return _entry != m_Index.end() ? uint64_t(_entry->second.m_Width) * _entry->second.m_Height : 0;
+	}
+
+	//false while the images in flight leave no room for bytes, nothing in flight always has room
+	bool TryAcquireBudget(uint64_t bytes)
+	{
+		std::lock_guard<std::mutex> _lock(m_BudgetLock);
+		if (m_InFlightBytes != 0 && m_InFlightBytes + bytes > m_MaxInFlightBytes)
+			return false;
+		m_InFlightBytes += bytes;
+		return true;
+	}
+
+	void ReleaseBudget(uint64_t bytes)
+	{
+		std::lock_guard<std::mutex> _lock(m_BudgetLock);
+		m_InFlightBytes -= bytes;
+	}
+
+	//The manifest next to the results, or else next to the sources (the directory itself, the glob or manifest one)
+	std::string DefaultManifestPath(const std::string &source) const
+	{
+		namespace fs = std::experimental::filesystem;
+		fs::path _directory = !m_OutputDirectory.empty() ? fs::path(m_OutputDirectory) : fs::is_directory(source) ? fs::path(source) : fs::path(source).parent_path();
+		return (_directory / "Imagedrop_Manifest.txt").string();
+	}
+
+	//The stat of an input against the manifest, the record is kept for the next manifest either way
+	bool IsUpToDate(int i)
+	{
+		BatchManifestEntry &_record = m_Records[i];
+		_record.m_Parameters = ImageJob::ResultParameters(OutputPath(m_Inputs[i]), m_Options);
+		if (!ImageIndex::Stat(m_Inputs[i], _record.m_ModifiedTime, _record.m_FileSize) || !m_Manifest.IsUpToDate(m_Inputs[i], _record))
+			return false;
+
+		//a mip chain is checked by its first level
+		std::string _outputPath = m_Options.m_MipChain ? ImageJob::MipPath(OutputPath(m_Inputs[i]), 1) : OutputPath(m_Inputs[i]);
+		std::error_code _error;
+		return std::experimental::filesystem::exists(_outputPath, _error);
+	}
+
+	//An image whose budget was granted already, it gives it back once done
+	bool RunOne(const std::string &inputPath, uint64_t budget)
+	{
+		bool _succeeded = false;
+
+		try
+		{
+			ImageJobStats _stats = ImageJob::Run(inputPath, OutputPath(inputPath), m_Options);
+			m_Pixels += _stats.m_Pixels;
+			m_BytesRead += _stats.m_BytesRead;
+			m_BytesWritten += _stats.m_BytesWritten;
+			m_Succeeded++;
+			_succeeded = true;
+		}
+		catch (const std::exception &_exception)
+		{
+			m_Failed++;
+			std::lock_guard<std::mutex> _lock(m_FailuresLock);
+			m_Failures.push_back(inputPath + " -> " + _exception.what());
+		}
+
+		ReleaseBudget(budget);
+		return _succeeded;
+	}
+
+	//Only what's done or skipped goes in, the failed inputs & the ones gone from the tree drop out
+	void SaveManifest()
+	{
+		BatchManifest _next;
+		for (size_t i = 0; i < m_Inputs.size(); i++)
+		{
+			if (m_Recorded[i])
+				_next.m_Entries[m_Inputs[i]] = m_Records[i];
+		}
+
+		if (!_next.Save(m_ManifestPath))
+			LOG_WARNING("Can't write the manifest " << m_ManifestPath << ", the next run does everything again");
+	}
+
+	/*
+	Fails the inputs whose result path an earlier input already has, they would overwrite each other while both
+	count as done. Makes the directories of the results too. Returns the inputs to run.
+	*/
+	std::vector<char> CheckOutputs()
+	{
+		namespace fs = std::experimental::filesystem;
+		std::vector<char> _runnable(m_Inputs.size(), 1);
+		std::map<std::string, size_t> _outputs;
+		for (size_t i = 0; i < m_Inputs.size(); i++)
+		{
+			std::string _outputPath = OutputPath(m_Inputs[i]);
+			auto _taken = _outputs.insert(std::make_pair(_outputPath, i));
+			if (!_taken.second)
+			{
+				_runnable[i] = 0;
+				m_Failed++;
+				m_Failures.push_back(m_Inputs[i] + " -> same result path as " + m_Inputs[_taken.first->second] + " (" + _outputPath + ")");
+				continue;
+			}
+
+			std::error_code _error;
+			if (!m_OutputDirectory.empty())
+				fs::create_directories(fs::path(_outputPath).parent_path(), _error);
+		}
+		return _runnable;
+	}
+
+	void Run()
+	{
+		if (!m_OutputDirectory.empty())
+			std::experimental::filesystem::create_directories(m_OutputDirectory);
+
+		//the biggest images first, the pool takes the inputs about in order
+		if (!m_Index.empty())
+		{
+			std::stable_sort(m_Inputs.begin(), m_Inputs.end(), [this](const std::string &a, const std::string &b)
+			{
+				return IndexedPixels(a) > IndexedPixels(b);
+			});
+		}
+
+		PROFILE_SCOPE("batch");
+		std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
+
+		std::vector<char> _runnable = CheckOutputs();
+		const bool _incremental = !m_ManifestPath.empty();
+		if (_incremental)
+		{
+			m_Manifest.Load(m_ManifestPath);
+			m_Records.assign(m_Inputs.size(), BatchManifestEntry());
+			m_Recorded.assign(m_Inputs.size(), 0);
+		}
+
+		//the images go to the pool in order, each once its budget is granted, this thread runs queued work while it waits
+		ThreadPool &_pool = ThreadPool::Get();
+		std::atomic<int> _remaining(0);
+		for (int i = 0; i < int(m_Inputs.size()); i++)
+		{
+			if (!_runnable[i])
+				continue;
+			if (_incremental && IsUpToDate(i))
+			{
+				m_Skipped++;
+				m_Recorded[i] = 1;
+				continue;
+			}
+
+			uint64_t _budget = EstimateBytes(m_Inputs[i]);
+			while (!TryAcquireBudget(_budget))
+			{
+				if (!_pool.HelpOne())
+					std::this_thread::yield();
+			}
+
+			_remaining++;
+			_pool.Submit([this, i, _budget, _incremental, &_remaining]()
+			{
+				bool _succeeded = RunOne(m_Inputs[i], _budget);
+				if (_incremental)
+					m_Recorded[i] = _succeeded ? 1 : 0;
+				_remaining--;
+			});
+		}
+
+		while (_remaining > 0)
+		{
+			if (!_pool.HelpOne())
+				std::this_thread::yield();
+		}
+
+		if (_incremental)
+			SaveManifest();
+
+		std::chrono::duration<double> _duration = std::chrono::high_resolution_clock::now() - _startTime;
+		if (m_Options.m_Cache != NULL)
+			m_Options.m_Cache->Trim();
+		PrintSummary(_duration.count());
+	}
+
+	//The summary is the product of a batch, so it goes out even with the logs turned off
+	void PrintSummary(double seconds)
+	{
+		double _seconds = seconds > 0.0 ? seconds : 1e-9;
+		double _megaBytes = double(m_BytesRead + m_BytesWritten) / (1024.0 * 1024.0);
+
+		//the logs still pending go out first, so they don't land in the middle
+		LOG_FLUSH();
+		std::cout << "=================B=A=T=C=H=====================" << "\n";
+		std::cout << "Files: " << m_Inputs.size() << " (" << m_Succeeded << " done, " << m_Failed << " failed";
+		if (!m_ManifestPath.empty())
+			std::cout << ", " << m_Skipped << " unchanged";
+		std::cout << ")" << "\n";
+		std::cout << "Time: " << seconds * 1000.0 << "ms" << "\n";
+		std::cout << "Pixels/s: " << double(m_Pixels) / _seconds << "\n";
+		std::cout << "MB/s: " << _megaBytes / _seconds << "\n";
+		if (m_Options.m_Cache != NULL)
+		{
+			std::cout << "Cache: " << m_Options.m_Cache->m_Hits << " hits, " << m_Options.m_Cache->m_Misses << " misses, "
+				<< m_Options.m_Cache->m_Evictions << " evicted, " << m_Options.m_Cache->m_BytesSaved / (1024 * 1024) << "MB from the cache" << "\n";
+		}
+		for (size_t i = 0; i < m_Failures.size(); i++)
+			std::cout << "Failed: " << m_Failures[i] << "\n";
+		std::cout << "================================================" << std::endl;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <filesystem>
+
+/*
+The state of the incremental batch mode (--incremental), what every input was when it got resized
+- A text file, a line per input: the path, size, mtime & the result parameters, tab separated.
+- An input is skipped when its size & mtime are the same, the parameters are the same & its result is still
+	there, that's a stat or two per file & no read at all, a re-run of an unchanged tree costs the directory walk.
+- The file is rewritten whole at the end of the batch, under a temp name & renamed, a batch killed halfway keeps
+	the previous state. Inputs gone from the tree drop out of it, failed ones aren't recorded so they run again.
+*/
+#define BATCH_MANIFEST_HEADER						"#Imagedrop incremental manifest 1"
+
+struct BatchManifestEntry
+{
+	uint64_t m_FileSize;
+	int64_t m_ModifiedTime;
+	std::string m_Parameters;
+
+	BatchManifestEntry() : m_FileSize(0), m_ModifiedTime(0) {}
+};
+
+class BatchManifest
+{
+public:
+	std::map<std::string, BatchManifestEntry> m_Entries;
+
+	//An empty manifest when there's none yet (the first run) or it isn't ours
+	void Load(const std::string &path)
+	{
+		m_Entries.clear();
+		std::ifstream _file(path);
+		std::string _line;
+		if (!std::getline(_file, _line) || _line != BATCH_MANIFEST_HEADER)
+			return;
+
+		while (std::getline(_file, _line))
+		{
+			size_t _size = _line.find('\t');
+			size_t _time = _size == std::string::npos ? _size : _line.find('\t', _size + 1);
+			size_t _parameters = _time == std::string::npos ? _time : _line.find('\t', _time + 1);
+			if (_parameters == std::string::npos)
+				continue;
+
+			BatchManifestEntry &_entry = m_Entries[_line.substr(0, _size)];
+			_entry.m_FileSize = strtoull(_line.c_str() + _size + 1, NULL, 10);
+			_entry.m_ModifiedTime = strtoll(_line.c_str() + _time + 1, NULL, 10);
+			_entry.m_Parameters = _line.substr(_parameters + 1);
+		}
+	}
+
+	bool Save(const std::string &path) const
+	{
+		std::string _temp = path + ".tmp";
+		{
+			std::ofstream _file(_temp);
+			if (!_file)
+				return false;
+
+			_file << BATCH_MANIFEST_HEADER << "\n";
+			for (auto _entry = m_Entries.begin(); _entry != m_Entries.end(); ++_entry)
+				_file << _entry->first << "\t" << _entry->second.m_FileSize << "\t" << _entry->second.m_ModifiedTime << "\t" << _entry->second.m_Parameters << "\n";
+			if (!_file)
+				return false;
+		}
+
+		std::error_code _error;
+		std::experimental::filesystem::rename(_temp, path, _error);
+		return !_error;
+	}
+
+	//Unchanged since it got recorded, the result is checked apart
+	bool IsUpToDate(const std::string &inputPath, const BatchManifestEntry &current) const
+	{
+		auto _entry = m_Entries.find(inputPath);
+		return _entry != m_Entries.end() && _entry->second.m_FileSize == current.m_FileSize &&
+			_entry->second.m_ModifiedTime == current.m_ModifiedTime && _entry->second.m_Parameters == current.m_Parameters;
+	}
+};
\ No newline at end of file
@@ -15,6 +15,9 @@
 #define TGA_SPECIFICATION_DESCRIPTION_ALPHA_DEPTH			(uint8_t)(1 << 0 | 1 << 1 | 1 << 2 | 1 << 3)
 #define TGA_SPECIFICATION_DESCRIPTION_RIGHT_TO_LEFT			(uint8_t)(1 << 4)
 #define TGA_SPECIFICATION_DESCRIPTION_LEFT_TO_RIGHT			(uint8_t)(1 << 5)
+#define TGA_SPECIFICATION_DESCRIPTION_TOP_TO_BOTTOM			(uint8_t)(1 << 5)		//same bit, the first row in the file is the top one
+
+#define BMP_TYPE_BM											0x4D42					//"BM"
 
 #define BMP_PIXEL_FORMAT_1_BPP								1
 #define BMP_PIXEL_FORMAT_2_BPP								2
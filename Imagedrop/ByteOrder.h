@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+The little endian fields of the file headers, TGA & BMP both store them this way
+- Decoded byte by byte, so a header comes out right on any host & from any alignment (a mapping, a
+	packed block read in one go), the compilers turn these into a plain load or store on x86.
+*/
+class ByteOrder
+{
+public:
+	static uint16_t Read16(const uint8_t *data)
+	{
+		return uint16_t(data[0] | (data[1] << 8));
+	}
+
+	static uint32_t Read32(const uint8_t *data)
+	{
+		return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+	}
+
+	static uint64_t Read64(const uint8_t *data)
+	{
+		return uint64_t(Read32(data)) | (uint64_t(Read32(data + 4)) << 32);
+	}
+
+	static void Write16(uint8_t *data, uint16_t value)
+	{
+		data[0] = uint8_t(value);
+		data[1] = uint8_t(value >> 8);
+	}
+
+	static void Write32(uint8_t *data, uint32_t value)
+	{
+		data[0] = uint8_t(value);
+		data[1] = uint8_t(value >> 8);
+		data[2] = uint8_t(value >> 16);
+		data[3] = uint8_t(value >> 24);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+
+/*
+The commandline, split into:
+- Arguments, the positional ones [Image] [New Name] [Scale Factor], same order as always
+- Options, anything starting with "--", either "--name=value" or a bare "--name" flag
+This way the old way of calling the exe keeps working, and new features just add options.
+*/
+class CommandLine
+{
+public:
+	std::vector<std::string> m_Arguments;
+	std::map<std::string, std::string> m_Options;
+
+	CommandLine(int argc, char *argv[])
+	{
+		//[0] is the exe itself
+		for (int i = 1; i < argc; i++)
+		{
+			std::string _arg = argv[i];
+
+			if (_arg.size() > 2 && _arg[0] == '-' && _arg[1] == '-')
+			{
+				size_t _equal = _arg.find('=');
+				if (_equal == std::string::npos)
+					m_Options[_arg.substr(2)] = "";
+				else
+					m_Options[_arg.substr(2, _equal - 2)] = _arg.substr(_equal + 1);
+			}
+			else
+			{
+				m_Arguments.push_back(_arg);
+			}
+		}
+	}
+
+	bool Has(const char *name) const
+	{
+		return m_Options.find(name) != m_Options.end();
+	}
+
+	std::string Get(const char *name, const std::string &defaultValue) const
+	{
+		auto _option = m_Options.find(name);
+		return _option != m_Options.end() ? _option->second : defaultValue;
+	}
+
+	int GetInt(const char *name, int defaultValue) const
+	{
+		auto _option = m_Options.find(name);
+		return (_option != m_Options.end() && !_option->second.empty()) ? atoi(_option->second.c_str()) : defaultValue;
+	}
+
+	float GetFloat(const char *name, float defaultValue) const
+	{
+		auto _option = m_Options.find(name);
+		return (_option != m_Options.end() && !_option->second.empty()) ? (float)atof(_option->second.c_str()) : defaultValue;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Runtime CPU features detection (CPUID), so the fast kernels can be picked at startup
+and the same exe still runs on older machines.
+Both of the project platforms (Win32 & x64) are x86, anything else just gets the scalar path.
+*/
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define IMAGEDROP_X86									1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#else
+#define IMAGEDROP_X86									0
+#endif
+
+//The instruction set target of a function, MSVC allows the intrinsics anywhere, gcc/clang need the attribute
+#if defined(_MSC_VER) || !IMAGEDROP_X86
+#define TARGET_SSE2
+#define TARGET_AVX2
+#else
+#define TARGET_SSE2										__attribute__((target("sse2")))
+#define TARGET_AVX2										__attribute__((target("avx2")))
+#endif
+
+class CpuFeatures
+{
+public:
+	bool m_HasSSE2;
+	bool m_HasAVX2;
+
+	CpuFeatures()
+	{
+		m_HasSSE2 = false;
+		m_HasAVX2 = false;
+
+#if IMAGEDROP_X86
+		int _info[4] = { 0, 0, 0, 0 };
+		Cpuid(_info, 0, 0);
+		int _maxLeaf = _info[0];
+
+		if (_maxLeaf >= 1)
+		{
+			Cpuid(_info, 1, 0);
+			m_HasSSE2 = (_info[3] & (1 << 26)) != 0;
+
+			//AVX2 needs the OS to save the YMM registers too (OSXSAVE + XCR0 bits 1 & 2)
+			bool _osxsave = (_info[2] & (1 << 27)) != 0;
+			if (_osxsave && _maxLeaf >= 7 && (Xgetbv() & 0x6) == 0x6)
+			{
+				Cpuid(_info, 7, 0);
+				m_HasAVX2 = (_info[1] & (1 << 5)) != 0;
+			}
+		}
+#endif // IMAGEDROP_X86
+	}
+
+	//The features are the same for the whole run, so detect once & reuse
+	static const CpuFeatures& Get()
+	{
+		static const CpuFeatures _features;
+		return _features;
+	}
+
+private:
+#if IMAGEDROP_X86
+	static void Cpuid(int info[4], int leaf, int subLeaf)
+	{
+#if defined(_MSC_VER)
+		__cpuidex(info, leaf, subLeaf);
+#else
+		unsigned int _a, _b, _c, _d;
+		__cpuid_count(leaf, subLeaf, _a, _b, _c, _d);
+		info[0] = int(_a);
+		info[1] = int(_b);
+		info[2] = int(_c);
+		info[3] = int(_d);
+#endif
+	}
+
+	static uint64_t Xgetbv()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int _eax, _edx;
+		__asm__ volatile("xgetbv" : "=a"(_eax), "=d"(_edx) : "c"(0));
+		return (uint64_t(_edx) << 32) | _eax;
+#endif
+	}
+#endif // IMAGEDROP_X86
+};
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Settings.h"
+
+/*
+The output file of the codecs, the header, ID, color map, pixels & footer gathered into one buffer
+- A small image (an icon) goes out in a single write call, instead of a dozen tiny fwrite calls each
+	going through the locked stdio.
+- The buffer is sized to the file it's told to expect (up to FILE_WRITE_BUFFER_KB), so a small file
+	doesn't pay for a big buffer. A block that doesn't fit (the pixels of a big image) goes straight
+	to the file right after what's buffered, it's never copied.
+- stdio buffering is turned off, the writer is the buffer, so nothing gets copied twice.
+- It can also write into a caller's growable buffer instead of a file (the in-memory encode), the bytes
+	are appended there right away, reserved once from the size hint.
+*/
+class FileWriter
+{
+public:
+	FILE *m_File;
+	std::vector<uint8_t> m_Buffer;
+	size_t m_Used;
+	std::vector<uint8_t> *m_Target;				//the memory mode, NULL when writing a file
+
+	FileWriter() : m_File(NULL), m_Used(0), m_Target(NULL) {}
+	~FileWriter()
+	{
+		Close();
+	}
+
+	//false if the file can't be created, sizeHint is the whole file size as far as it's known
+	bool Open(const char *path, size_t sizeHint)
+	{
+		//a new file rather than the old one truncated, it may be a result hard-linked from the cache (or the mapped source)
+		remove(path);
+		fopen_s(&m_File, path, "wb");
+		if (m_File == NULL)
+			return false;
+
+		setvbuf(m_File, NULL, _IONBF, 0);
+		size_t _maxSize = size_t(FILE_WRITE_BUFFER_KB) * 1024;
+		m_Buffer.resize(sizeHint < _maxSize ? sizeHint : _maxSize);
+		m_Used = 0;
+		return true;
+	}
+
+	//The memory mode, the file bytes get appended to target
+	void Open(std::vector<uint8_t> &target, size_t sizeHint)
+	{
+		m_Target = &target;
+		m_Target->reserve(m_Target->size() + sizeHint);
+	}
+
+	void Write(const void *data, size_t size)
+	{
+		if (size == 0)
+			return;
+
+		if (m_Target != NULL)
+		{
+			const uint8_t *_data = static_cast<const uint8_t*>(data);
+			m_Target->insert(m_Target->end(), _data, _data + size);
+			return;
+		}
+
+		if (m_Used + size > m_Buffer.size())
+		{
+			Flush();
+			if (size >= m_Buffer.size())
+			{
+				fwrite(data, size, 1, m_File);
+				return;
+			}
+		}
+
+		memcpy(m_Buffer.data() + m_Used, data, size);
+		m_Used += size;
+	}
+
+	void Flush()
+	{
+		if (m_Used > 0)
+			fwrite(m_Buffer.data(), m_Used, 1, m_File);
+		m_Used = 0;
+	}
+
+	void Close()
+	{
+		m_Target = NULL;
+		if (m_File == NULL)
+			return;
+
+		Flush();
+		fclose(m_File);
+		m_File = NULL;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Macros.h"
+#include "Bits.h"
+#include "ImageBuffer.h"
+#include "BMPFormat.h"
+#include "TGAFormat.h"
+
+/*
+TGA <-> BMP, the result format is the one of the output extension
+- Both formats keep their pixels as B, G, R (& A) bytes, so the decoded ImageBuffer is already the shared
+	representation, there is no channel swizzle to do. The converted image is only the headers of the other
+	format around a view of the same pixels, nothing gets copied.
+- What does differ is done by the encoder while it writes, a row at a time:
+	- the rows order, a top-down source is written bottom-up (the origin every reader knows), unless the
+		top-left origin is asked for, which a resize with that origin already has, so nothing gets flipped then
+	- the BMP padding of every row to 4 bytes
+	- an 8bit grayscale TGA widened to 24bit BGR, a BMP has no gray without a palette
+	- the columns of a right-to-left TGA reversed, a BMP row always starts at the left
+- The converted image points into its source, it must not outlive it.
+*/
+
+//The other format of a conversion, for the code templated on the format
+template<typename Format>
+struct ConvertedFormat;
+
+template<>
+struct ConvertedFormat<TGA_Format>
+{
+	typedef BMP_Format Type;
+};
+
+template<>
+struct ConvertedFormat<BMP_Format>
+{
+	typedef TGA_Format Type;
+};
+
+class FormatConverter
+{
+public:
+	//A plain BI_RGB bitmap, 24 or 32bit, bottom-up but for the top-left origin
+	static void Convert(TGA_Format &source, BMP_Format &target, EOutputOrigin origin = EOutputOrigin::KeepOrigin)
+	{
+		const ImageBuffer &_pixels = source.m_Image;
+		bool _topDown = origin == EOutputOrigin::TopLeft;
+		target.m_Type = BMP_TYPE_BM;
+		target.m_Reserved1 = 0;
+		target.m_Reserved2 = 0;
+		target.m_OffsetBits = uint32_t(bmpHeaderSize);
+
+		target.m_Size = uint32_t(bmpHeaderSize) - 14;
+		target.m_Width = uint32_t(_pixels.m_Width);
+		target.m_Height = _topDown ? uint32_t(-_pixels.m_Height) : uint32_t(_pixels.m_Height);
+		target.m_Planes = 1;
+		target.m_BitCount = _pixels.m_Format == EPixelFormat::BGRA32 ? BMP_PIXEL_FORMAT_32_BPP : BMP_PIXEL_FORMAT_24_BPP;
+		target.m_Compression = BMP_COMPRESSION_METHOD_BI_RGB;
+		target.m_XPelsPerMeter = 0;
+		target.m_YPelsPerMeter = 0;
+		target.m_ColorsUsed = 0;
+		target.m_ColorsImportant = 0;
+		target.m_SizeImage = uint32_t(target.PixelArraySize());
+		target.m_FileSize = target.m_OffsetBits + target.m_SizeImage;
+
+		target.m_Image.View(_pixels.m_Data, _pixels.m_Width, _pixels.m_Height, _pixels.m_Format, _pixels.m_Stride);
+		target.m_FlipRows = source.IsTopDown() != _topDown;
+		target.m_MirrorColumns = source.IsRightToLeft();
+	}
+
+	/*
+	A true color TGA (gray for the gray pixels of an 8bit resize), bottom-left but for the top-left origin, RLE or not as the
+	compression says (the same as the source is uncompressed, BMP has no RLE of ours)
+	*/
+	static void Convert(BMP_Format &source, TGA_Format &target, EOutputCompression compression, EOutputOrigin origin = EOutputOrigin::KeepOrigin)
+	{
+		const ImageBuffer &_pixels = source.m_Image;
+		bool _topDown = origin == EOutputOrigin::TopLeft;
+		bool _gray = _pixels.m_Format == EPixelFormat::Gray8;
+		if (_pixels.m_Width > 0xFFFF || _pixels.m_Height > 0xFFFF)
+		{
+			LOG_ERROR("A TGA side can't be over 65535 pixels");
+			THROW_ERROR("A TGA side can't be over 65535 pixels");
+		}
+
+		target.m_IdLength = 0;
+		target.m_ColorMapType = TGA_COLOR_MAP_TYPE_NO_COLOR_MAP;
+		target.m_ImageType = _gray ? TGA_IMAGE_TYPE_UNCOMPRESSED_GRAYSCALE : TGA_IMAGE_TYPE_UNCOMPRESSED_TRUE_COLOR;
+		target.m_ColorMapFirstEntryIndex = 0;
+		target.m_ColorMapLength = 0;
+		target.m_ColorMapEntrySize = 0;
+		target.m_ImageOriginX = 0;
+		target.m_ImageOriginY = 0;
+		target.m_ImageWidth = uint16_t(_pixels.m_Width);
+		target.m_ImageHeigh = uint16_t(_pixels.m_Height);
+		target.m_ImagePixelDepth = uint8_t(_pixels.Channels() * 8);
+		//the alpha bits count & the origin bits
+		target.m_ImageDescription = _pixels.m_Format == EPixelFormat::BGRA32 ? 8 : 0;
+		if (_topDown)
+			target.m_ImageDescription |= TGA_SPECIFICATION_DESCRIPTION_TOP_TO_BOTTOM;
+		target.ApplyCompression(compression);
+
+		target.m_Image.View(_pixels.m_Data, _pixels.m_Width, _pixels.m_Height, _pixels.m_Format, _pixels.m_Stride);
+		target.m_FlipRows = source.IsTopDown() != _topDown;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "ByteOrder.h"
+
+/*
+A 64bit XXH64 hash (xxHash, the same values as the reference implementation)
+- Four lanes of 8 bytes over 32 byte stripes, a few multiplies & rotates per 8 bytes, so hashing a whole
+	image runs at memory speed, far below what decoding & resampling it costs.
+- Used to key the result cache by the input bytes, it's not a cryptographic hash.
+*/
+class Hash
+{
+public:
+	static const uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+	static const uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	static const uint64_t Prime3 = 0x165667B19E3779F9ULL;
+	static const uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+	static const uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+	static uint64_t Rotate(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	static uint64_t Round(uint64_t accumulator, uint64_t input)
+	{
+		accumulator += input * Prime2;
+		accumulator = Rotate(accumulator, 31);
+		return accumulator * Prime1;
+	}
+
+	static uint64_t Merge(uint64_t accumulator, uint64_t lane)
+	{
+		accumulator ^= Round(0, lane);
+		return accumulator * Prime1 + Prime4;
+	}
+
+	static uint64_t XXH64(const void *data, size_t size, uint64_t seed = 0)
+	{
+		const uint8_t *_data = static_cast<const uint8_t*>(data);
+		const uint8_t *_end = _data + size;
+		uint64_t _hash;
+
+		if (size >= 32)
+		{
+			uint64_t _lanes[4] = { seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 };
+			for (; _end - _data >= 32; _data += 32)
+			{
+				_lanes[0] = Round(_lanes[0], ByteOrder::Read64(_data));
+				_lanes[1] = Round(_lanes[1], ByteOrder::Read64(_data + 8));
+				_lanes[2] = Round(_lanes[2], ByteOrder::Read64(_data + 16));
+				_lanes[3] = Round(_lanes[3], ByteOrder::Read64(_data + 24));
+			}
+
+			_hash = Rotate(_lanes[0], 1) + Rotate(_lanes[1], 7) + Rotate(_lanes[2], 12) + Rotate(_lanes[3], 18);
+			for (int i = 0; i < 4; i++)
+				_hash = Merge(_hash, _lanes[i]);
+		}
+		else
+		{
+			_hash = seed + Prime5;
+		}
+
+		_hash += uint64_t(size);
+
+		for (; _end - _data >= 8; _data += 8)
+		{
+			_hash ^= Round(0, ByteOrder::Read64(_data));
+			_hash = Rotate(_hash, 27) * Prime1 + Prime4;
+		}
+
+		if (_end - _data >= 4)
+		{
+			_hash ^= uint64_t(ByteOrder::Read32(_data)) * Prime1;
+			_hash = Rotate(_hash, 23) * Prime2 + Prime3;
+			_data += 4;
+		}
+
+		for (; _data < _end; _data++)
+		{
+			_hash ^= uint64_t(*_data) * Prime5;
+			_hash = Rotate(_hash, 11) * Prime1;
+		}
+
+		//the avalanche
+		_hash ^= _hash >> 33;
+		_hash *= Prime2;
+		_hash ^= _hash >> 29;
+		_hash *= Prime3;
+		_hash ^= _hash >> 32;
+		return _hash;
+	}
+};
\ No newline at end of file
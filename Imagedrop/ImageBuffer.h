@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include "Macros.h"
+#include "Profiler.h"
+
+/*
+The pixels of an image, whatever format they came from
+- Interleaved 8bit channels, width, height, pixel format & an explicit row stride in bytes, so nobody
+	has to guess the stride out of the depth anymore.
+- The memory is 64 bytes aligned, and by default every row starts on a 64 bytes boundary too.
+	A codec can still ask for its own stride (a packed TGA for a single fread, a padded BMP row).
+- The memory comes from a pool, a batch of images of similar sizes keeps reusing the same few blocks
+	instead of a malloc/free (and the page faults of fresh memory) per image.
+- An ImageBuffer can also be a view over memory it doesn't own (a file mapping), it is read only then.
+*/
+
+enum EPixelFormat
+{
+	Gray8,
+	BGR24,
+	BGRA32
+};
+
+//What a pixel format is made of, known at compile time so the kernels can be templates on it
+template<EPixelFormat Format>
+struct PixelTraits
+{
+	static const int Channels = Format == EPixelFormat::BGRA32 ? 4 : Format == EPixelFormat::BGR24 ? 3 : 1;
+	static const bool HasAlpha = Format == EPixelFormat::BGRA32;
+	static const int AlphaIndex = 3;			//B G R A
+};
+
+//Aligned blocks kept around for reuse, best fit by size, up to IMAGE_POOL_MAX_MB cached
+class ImageBufferPool
+{
+public:
+	std::mutex m_Lock;
+	std::multimap<size_t, uint8_t*> m_Free;		//capacity -> block
+	size_t m_FreeBytes;
+	size_t m_MaxFreeBytes;
+
+	ImageBufferPool(size_t maxFreeBytes) : m_FreeBytes(0), m_MaxFreeBytes(maxFreeBytes) {}
+
+	~ImageBufferPool()
+	{
+		for (auto _block = m_Free.begin(); _block != m_Free.end(); ++_block)
+			FreeAligned(_block->second);
+	}
+
+	static ImageBufferPool& Get()
+	{
+		static ImageBufferPool _pool(size_t(IMAGE_POOL_MAX_MB) * 1024 * 1024);
+		return _pool;
+	}
+
+	static uint8_t* AllocateAligned(size_t bytes)
+	{
+#if defined(_WIN32)
+		return (uint8_t*)_aligned_malloc(bytes, IMAGE_ROW_ALIGNMENT);
+#else
+		void *_block = NULL;
+		if (posix_memalign(&_block, IMAGE_ROW_ALIGNMENT, bytes) != 0)
+			return NULL;
+		return (uint8_t*)_block;
+#endif
+	}
+
+	static void FreeAligned(uint8_t *block)
+	{
+#if defined(_WIN32)
+		_aligned_free(block);
+#else
+		free(block);
+#endif
+	}
+
+	//A block of at least bytes, capacity gets the real size of it. A cached block is only taken if it isn't more than twice too big
+	uint8_t* Acquire(size_t bytes, size_t &capacity)
+	{
+		{
+			std::lock_guard<std::mutex> _lock(m_Lock);
+			auto _block = m_Free.lower_bound(bytes);
+			if (_block != m_Free.end() && _block->first <= bytes * 2)
+			{
+				uint8_t *_data = _block->second;
+				capacity = _block->first;
+				m_FreeBytes -= capacity;
+				m_Free.erase(_block);
+				PROFILE_COUNT(PoolReuses, 1);
+				return _data;
+			}
+		}
+
+		//rounded up, so blocks of close sizes can serve each other
+		capacity = (bytes + IMAGE_ROW_ALIGNMENT - 1) / IMAGE_ROW_ALIGNMENT * IMAGE_ROW_ALIGNMENT;
+		uint8_t *_data = AllocateAligned(capacity);
+		if (_data == NULL)
+		{
+			LOG_ERROR("Can't allocate " << capacity << " bytes for the pixels");
+			THROW_ERROR("Can't allocate the pixels");
+		}
+		PROFILE_COUNT(Allocations, 1);
+		PROFILE_COUNT(AllocatedBytes, capacity);
+		return _data;
+	}
+
+	void Release(uint8_t *block, size_t capacity)
+	{
+		{
+			std::lock_guard<std::mutex> _lock(m_Lock);
+			if (m_FreeBytes + capacity <= m_MaxFreeBytes)
+			{
+				m_Free.insert(std::make_pair(capacity, block));
+				m_FreeBytes += capacity;
+				return;
+			}
+		}
+		FreeAligned(block);
+	}
+};
+
+class ImageBuffer
+{
+public:
+	int m_Width;
+	int m_Height;
+	EPixelFormat m_Format;
+	long m_Stride;								//bytes from a row to the next one, padding included
+	uint8_t *m_Data;
+	size_t m_Capacity;							//0 for a view, the memory belongs to someone else
+
+	ImageBuffer() : m_Width(0), m_Height(0), m_Format(EPixelFormat::BGR24), m_Stride(0), m_Data(NULL), m_Capacity(0) {}
+	~ImageBuffer()
+	{
+		Release();
+	}
+
+	//a block goes back to the pool once, so no copies
+	ImageBuffer(const ImageBuffer&) = delete;
+	ImageBuffer& operator=(const ImageBuffer&) = delete;
+
+	static int BytesPerPixel(EPixelFormat format)
+	{
+		return format == EPixelFormat::BGRA32 ? 4 : format == EPixelFormat::BGR24 ? 3 : 1;
+	}
+
+	//The pixel format of a depth in bits, anything that isn't 32 or 8 is treated as 24
+	static EPixelFormat FromDepth(int bitsPerPixel)
+	{
+		return bitsPerPixel == 32 ? EPixelFormat::BGRA32 : bitsPerPixel == 8 ? EPixelFormat::Gray8 : EPixelFormat::BGR24;
+	}
+
+	static long AlignedStride(int width, EPixelFormat format)
+	{
+		long _bytes = long(width) * BytesPerPixel(format);
+		return (_bytes + IMAGE_ROW_ALIGNMENT - 1) / IMAGE_ROW_ALIGNMENT * IMAGE_ROW_ALIGNMENT;
+	}
+
+	int Channels() const
+	{
+		return BytesPerPixel(m_Format);
+	}
+
+	//The pixel bytes of a row, no padding
+	long RowBytes() const
+	{
+		return long(m_Width) * Channels();
+	}
+
+	size_t SizeInBytes() const
+	{
+		return size_t(m_Stride) * m_Height;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_Data == NULL;
+	}
+
+	bool IsView() const
+	{
+		return m_Data != NULL && m_Capacity == 0;
+	}
+
+	//No padding between the rows, the whole image can go through a single read or write
+	bool IsPacked() const
+	{
+		return m_Stride == RowBytes();
+	}
+
+	uint8_t* Row(int y)
+	{
+		return m_Data + size_t(y) * m_Stride;
+	}
+
+	const uint8_t* Row(int y) const
+	{
+		return m_Data + size_t(y) * m_Stride;
+	}
+
+	//Pooled pixels, stride 0 means every row aligned to IMAGE_ROW_ALIGNMENT. The content is undefined
+	void Allocate(int width, int height, EPixelFormat format, long stride = 0)
+	{
+		if (stride == 0)
+			stride = AlignedStride(width, format);
+
+		size_t _bytes = size_t(stride) * height;
+		if (m_Capacity == 0 || m_Capacity < _bytes)
+		{
+			Release();
+			if (_bytes > 0)
+				m_Data = ImageBufferPool::Get().Acquire(_bytes, m_Capacity);
+		}
+
+		m_Width = width;
+		m_Height = height;
+		m_Format = format;
+		m_Stride = stride;
+	}
+
+	//Points at pixels owned by someone else, they must outlive this buffer
+	void View(const uint8_t *data, int width, int height, EPixelFormat format, long stride)
+	{
+		Release();
+		m_Data = const_cast<uint8_t*>(data);
+		m_Width = width;
+		m_Height = height;
+		m_Format = format;
+		m_Stride = stride;
+	}
+
+	//Zeroes the bytes between the end of every row & the next one, so a padded image can be written as is
+	void ClearPadding()
+	{
+		long _rowBytes = RowBytes();
+		if (m_Stride == _rowBytes || IsView())
+			return;
+
+		for (int y = 0; y < m_Height; y++)
+			memset(Row(y) + _rowBytes, 0, m_Stride - _rowBytes);
+	}
+
+	void Release()
+	{
+		if (m_Capacity != 0)
+			ImageBufferPool::Get().Release(m_Data, m_Capacity);
+
+		m_Data = NULL;
+		m_Capacity = 0;
+		m_Width = 0;
+		m_Height = 0;
+		m_Stride = 0;
+	}
+};
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <cstdint>
 #include <vector>
 
 enum EImageFormat
@@ -11,6 +12,14 @@ enum EImageFormat
 	TGA
 };
 
+//How a result gets compressed, if the format has a say in it
+enum EOutputCompression
+{
+	SameAsSource,
+	Uncompressed,
+	RLE
+};
+
 class ImageFormatBase
 {
 public:
@@ -20,6 +29,8 @@ public:
 
 	virtual void OnImageRead(const char *path) {} //virtual void OnImageRead(ImageFormatBase &format, const char *path);
 	virtual void OnImageWrite(const char *path) {} //virtual void OnImageWrite(ImageFormatBase &format, const char *path);
+	virtual void OnImageDecode(const uint8_t *data, size_t size) {}		//a whole file already in memory, no filesystem at all
+	virtual void OnImageEncode(std::vector<uint8_t> &output) {}			//the file bytes appended to output
 	virtual void OnImageResize(ImageFormatBase &newFormat, float resizeMultiplier) {}
 		
 	ImageFormatBase(){}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include "Consts.h"
+#include "Macros.h"
+#include "ByteOrder.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "BMPFormat.h"
+#include "TGAFormat.h"
+
+/*
+The probe mode & its index, what every image is without touching its pixels
+- Only the header bytes are read (a single read of bmpHeaderSize bytes, the bigger of the two headers),
+	through the same ParseHeader() the codecs use, the files are probed in parallel on the shared pool.
+- An entry is the path, mtime & size of the file, its format, dimensions, depth & type, and the estimated
+	size of its result for the probe scale.
+- The index is JSON lines (one object per image) or a compact little endian binary (a path ending with .bin),
+	Load() reads both back. A batch given an index (--index=PATH) takes the decoded sizes from it for the memory
+	budget & starts with the biggest images, an entry whose file changed since (mtime or size) is ignored.
+*/
+
+//The binary index, "IDXB" then the version & the entries count, then the entries
+#define IMAGE_INDEX_MAGIC							"IDXB"
+#define IMAGE_INDEX_VERSION							1
+
+struct ImageIndexEntry
+{
+	std::string m_Path;
+	int64_t m_ModifiedTime;						//seconds since the epoch
+	uint64_t m_FileSize;
+	uint8_t m_Format;							//EImageFormat
+	uint8_t m_Type;								//the TGA image type, the BMP compression method
+	uint8_t m_Depth;							//bits per pixel
+	bool m_Supported;							//a header the codecs can resize
+	bool m_Compressed;
+	uint32_t m_Width;
+	uint32_t m_Height;
+	uint64_t m_OutputSize;						//the estimated result file, RLE counted as uncompressed
+
+	ImageIndexEntry() : m_ModifiedTime(0), m_FileSize(0), m_Format(EImageFormat::TGA), m_Type(0), m_Depth(0),
+		m_Supported(false), m_Compressed(false), m_Width(0), m_Height(0), m_OutputSize(0) {}
+
+	//The decoded source & result pixels, what the batch memory budget is about
+	uint64_t DecodedBytes(float resizeMultiplier) const
+	{
+		uint64_t _source = uint64_t(m_Width) * m_Height * (m_Depth / 8);
+		uint64_t _result = uint64_t(double(m_Width) * resizeMultiplier) * uint64_t(double(m_Height) * resizeMultiplier) * (m_Depth / 8);
+		return _source + _result;
+	}
+};
+
+class ImageIndex
+{
+public:
+	std::vector<ImageIndexEntry> m_Entries;
+
+	//The mtime & size of a file as they are now, false if it can't be reached
+	static bool Stat(const std::string &path, int64_t &modifiedTime, uint64_t &fileSize)
+	{
+		namespace fs = std::experimental::filesystem;
+		std::error_code _error;
+		fs::file_time_type _time = fs::last_write_time(path, _error);
+		if (_error)
+			return false;
+		fileSize = fs::file_size(path, _error);
+		if (_error)
+			return false;
+
+		modifiedTime = int64_t(fs::file_time_type::clock::to_time_t(_time));
+		return true;
+	}
+
+	//The header of a single file, the entry is left unsupported for anything unreadable or unknown
+	static void ProbeOne(const std::string &path, float resizeMultiplier, ImageIndexEntry &entry)
+	{
+		entry.m_Path = path;
+		if (!Stat(path, entry.m_ModifiedTime, entry.m_FileSize))
+			return;
+
+		FILE *_file;
+		fopen_s(&_file, path.c_str(), "rb");
+		if (_file == NULL)
+			return;
+
+		uint8_t _header[bmpHeaderSize] = {};
+		size_t _read = fread(_header, 1, bmpHeaderSize, _file);
+		fclose(_file);
+		PROFILE_COUNT(BytesRead, _read);
+
+		std::string _fileFormat = std::experimental::filesystem::path(path).extension().string();
+		if (_fileFormat == IMG_FORMAT_TGA && _read >= tgaHeaderSize)
+		{
+			TGA_Format _format;
+			_format.ParseHeader(_header);
+			entry.m_Format = EImageFormat::TGA;
+			entry.m_Type = _format.m_ImageType;
+			entry.m_Depth = _format.m_ImagePixelDepth;
+			entry.m_Width = _format.m_ImageWidth;
+			entry.m_Height = _format.m_ImageHeigh;
+			entry.m_Compressed = _format.IsCompressed(_format) != 0;
+			entry.m_Supported = _format.IsSupportedDepth();
+
+			TGA_Format _result;
+			_format.ResizedHeader(_result, resizeMultiplier);
+			entry.m_OutputSize = _result.HeaderSizeInBytes() + _result.SizeInBytes() + tgaFooterSize;
+		}
+		else if (_fileFormat == IMG_FORMAT_BMP && _read >= bmpHeaderSize)
+		{
+			BMP_Format _format;
+			_format.ParseHeader(_header);
+			entry.m_Format = EImageFormat::BMP;
+			entry.m_Type = uint8_t(_format.m_Compression);
+			entry.m_Depth = uint8_t(_format.m_BitCount);
+			entry.m_Width = _format.m_Width;
+			entry.m_Height = _format.RowsCount();
+			entry.m_Compressed = _format.IsCompressed(_format) != 0;
+			entry.m_Supported = _format.m_BitCount >= 24 && !entry.m_Compressed;
+
+			BMP_Format _result;
+			_format.ResizedHeader(_result, resizeMultiplier);
+			entry.m_OutputSize = _result.m_FileSize;
+		}
+	}
+
+	void Probe(const std::vector<std::string> &inputs, float resizeMultiplier)
+	{
+		PROFILE_SCOPE("probe");
+		m_Entries.assign(inputs.size(), ImageIndexEntry());
+		ThreadPool::Get().ParallelFor(int(inputs.size()), [this, &inputs, resizeMultiplier](int i)
+		{
+			ProbeOne(inputs[i], resizeMultiplier, m_Entries[i]);
+		});
+	}
+
+	static bool IsBinaryPath(const std::string &path)
+	{
+		return std::experimental::filesystem::path(path).extension().string() == ".bin";
+	}
+
+	void WriteJSONLines(std::ostream &stream) const
+	{
+		const char *_formats[] = { "bmp", "jpg", "png", "tga" };
+		for (size_t i = 0; i < m_Entries.size(); i++)
+		{
+			const ImageIndexEntry &_entry = m_Entries[i];
+			stream << "{\"path\": \"" << Profiler::Escape(_entry.m_Path) << "\", \"mtime\": " << _entry.m_ModifiedTime
+				<< ", \"size\": " << _entry.m_FileSize << ", \"format\": \"" << _formats[_entry.m_Format]
+				<< "\", \"width\": " << _entry.m_Width << ", \"height\": " << _entry.m_Height << ", \"depth\": " << size_t(_entry.m_Depth)
+				<< ", \"type\": " << size_t(_entry.m_Type) << ", \"compressed\": " << (_entry.m_Compressed ? "true" : "false")
+				<< ", \"supported\": " << (_entry.m_Supported ? "true" : "false") << ", \"output_size\": " << _entry.m_OutputSize << "}\n";
+		}
+	}
+
+	void WriteBinary(std::ostream &stream) const
+	{
+		uint8_t _header[12];
+		memcpy(_header, IMAGE_INDEX_MAGIC, 4);
+		ByteOrder::Write32(_header + 4, IMAGE_INDEX_VERSION);
+		ByteOrder::Write32(_header + 8, uint32_t(m_Entries.size()));
+		stream.write((const char*)_header, sizeof(_header));
+
+		//[2 path length][path][8 mtime][8 size][1 format][1 type][1 depth][1 flags][4 width][4 height][8 output size]
+		for (size_t i = 0; i < m_Entries.size(); i++)
+		{
+			const ImageIndexEntry &_entry = m_Entries[i];
+			uint8_t _record[36];
+			ByteOrder::Write32(_record + 0, uint32_t(_entry.m_ModifiedTime));
+			ByteOrder::Write32(_record + 4, uint32_t(uint64_t(_entry.m_ModifiedTime) >> 32));
+			ByteOrder::Write32(_record + 8, uint32_t(_entry.m_FileSize));
+			ByteOrder::Write32(_record + 12, uint32_t(_entry.m_FileSize >> 32));
+			_record[16] = _entry.m_Format;
+			_record[17] = _entry.m_Type;
+			_record[18] = _entry.m_Depth;
+			_record[19] = uint8_t((_entry.m_Supported ? 1 : 0) | (_entry.m_Compressed ? 2 : 0));
+			ByteOrder::Write32(_record + 20, _entry.m_Width);
+			ByteOrder::Write32(_record + 24, _entry.m_Height);
+			ByteOrder::Write32(_record + 28, uint32_t(_entry.m_OutputSize));
+			ByteOrder::Write32(_record + 32, uint32_t(_entry.m_OutputSize >> 32));
+
+			uint8_t _length[2];
+			ByteOrder::Write16(_length, uint16_t(_entry.m_Path.size()));
+			stream.write((const char*)_length, 2);
+			stream.write(_entry.m_Path.data(), uint16_t(_entry.m_Path.size()));
+			stream.write((const char*)_record, sizeof(_record));
+		}
+	}
+
+	bool Write(const std::string &path) const
+	{
+		std::ofstream _file(path, std::ios::binary);
+		if (!_file)
+			return false;
+
+		if (IsBinaryPath(path))
+			WriteBinary(_file);
+		else
+			WriteJSONLines(_file);
+		return true;
+	}
+
+	//The value after "key": in a line written by WriteJSONLines(), strings come back unescaped
+	static std::string JSONValue(const std::string &line, const char *key)
+	{
+		std::string _key = std::string("\"") + key + "\": ";
+		size_t _start = line.find(_key);
+		if (_start == std::string::npos)
+			return std::string();
+		_start += _key.size();
+
+		std::string _value;
+		if (line[_start] == '"')
+		{
+			for (size_t i = _start + 1; i < line.size() && line[i] != '"'; i++)
+			{
+				if (line[i] == '\\' && i + 1 < line.size())
+					i++;
+				_value += line[i];
+			}
+			return _value;
+		}
+
+		size_t _end = line.find_first_of(",}", _start);
+		return line.substr(_start, _end - _start);
+	}
+
+	//Either kind of index, false if it can't be read
+	bool Load(const std::string &path)
+	{
+		std::ifstream _file(path, std::ios::binary);
+		if (!_file)
+			return false;
+
+		m_Entries.clear();
+		char _magic[4] = {};
+		_file.read(_magic, 4);
+		if (_file.gcount() == 4 && memcmp(_magic, IMAGE_INDEX_MAGIC, 4) == 0)
+		{
+			uint8_t _header[8];
+			_file.read((char*)_header, 8);
+			if (ByteOrder::Read32(_header) != IMAGE_INDEX_VERSION)
+				return false;
+
+			uint32_t _count = ByteOrder::Read32(_header + 4);
+			for (uint32_t i = 0; i < _count && _file; i++)
+			{
+				ImageIndexEntry _entry;
+				uint8_t _length[2];
+				_file.read((char*)_length, 2);
+				_entry.m_Path.resize(ByteOrder::Read16(_length));
+				if (!_entry.m_Path.empty())
+					_file.read(&_entry.m_Path[0], _entry.m_Path.size());
+
+				uint8_t _record[36];
+				_file.read((char*)_record, sizeof(_record));
+				if (!_file)
+					return false;
+				_entry.m_ModifiedTime = int64_t(uint64_t(ByteOrder::Read32(_record)) | (uint64_t(ByteOrder::Read32(_record + 4)) << 32));
+				_entry.m_FileSize = uint64_t(ByteOrder::Read32(_record + 8)) | (uint64_t(ByteOrder::Read32(_record + 12)) << 32);
+				_entry.m_Format = _record[16];
+				_entry.m_Type = _record[17];
+				_entry.m_Depth = _record[18];
+				_entry.m_Supported = (_record[19] & 1) != 0;
+				_entry.m_Compressed = (_record[19] & 2) != 0;
+				_entry.m_Width = ByteOrder::Read32(_record + 20);
+				_entry.m_Height = ByteOrder::Read32(_record + 24);
+				_entry.m_OutputSize = uint64_t(ByteOrder::Read32(_record + 28)) | (uint64_t(ByteOrder::Read32(_record + 32)) << 32);
+				m_Entries.push_back(_entry);
+			}
+			return true;
+		}
+
+		_file.clear();
+		_file.seekg(0);
+		const char *_formats[] = { "bmp", "jpg", "png", "tga" };
+		std::string _line;
+		while (std::getline(_file, _line))
+		{
+			if (_line.empty() || _line[0] != '{')
+				continue;
+
+			ImageIndexEntry _entry;
+			_entry.m_Path = JSONValue(_line, "path");
+			_entry.m_ModifiedTime = atoll(JSONValue(_line, "mtime").c_str());
+			_entry.m_FileSize = strtoull(JSONValue(_line, "size").c_str(), NULL, 10);
+			std::string _format = JSONValue(_line, "format");
+			for (uint8_t f = 0; f < 4; f++)
+			{
+				if (_format == _formats[f])
+					_entry.m_Format = f;
+			}
+			_entry.m_Width = uint32_t(strtoul(JSONValue(_line, "width").c_str(), NULL, 10));
+			_entry.m_Height = uint32_t(strtoul(JSONValue(_line, "height").c_str(), NULL, 10));
+			_entry.m_Depth = uint8_t(atoi(JSONValue(_line, "depth").c_str()));
+			_entry.m_Type = uint8_t(atoi(JSONValue(_line, "type").c_str()));
+			_entry.m_Compressed = JSONValue(_line, "compressed") == "true";
+			_entry.m_Supported = JSONValue(_line, "supported") == "true";
+			_entry.m_OutputSize = strtoull(JSONValue(_line, "output_size").c_str(), NULL, 10);
+			m_Entries.push_back(_entry);
+		}
+		return true;
+	}
+
+	//The summary of a probe, the index itself is the product so it goes out even with the logs turned off
+	void PrintSummary(double seconds) const
+	{
+		size_t _supported = 0;
+		uint64_t _pixels = 0;
+		uint64_t _outputBytes = 0;
+		for (size_t i = 0; i < m_Entries.size(); i++)
+		{
+			if (!m_Entries[i].m_Supported)
+				continue;
+			_supported++;
+			_pixels += uint64_t(m_Entries[i].m_Width) * m_Entries[i].m_Height;
+			_outputBytes += m_Entries[i].m_OutputSize;
+		}
+
+		LOG_FLUSH();
+		std::cout << "=================P=R=O=B=E=====================" << "\n";
+		std::cout << "Files: " << m_Entries.size() << " (" << _supported << " supported)" << "\n";
+		std::cout << "Time: " << seconds * 1000.0 << "ms" << "\n";
+		std::cout << "Pixels: " << _pixels << "\n";
+		std::cout << "Output bytes (estimated): " << _outputBytes << "\n";
+		std::cout << "================================================" << std::endl;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+#include "Consts.h"
+#include "Macros.h"
+#include "Profiler.h"
+#include "ResultCache.h"
+#include "BMPFormat.h"
+#include "TGAFormat.h"
+#include "TGAStream.h"
+#include "FormatConverter.h"
+
+/*
+A single image job, read -> resize -> write.
+Both the single image commandline & the batch mode go through here, so they behave the same.
+Errors still come out as THROW_ERROR exceptions, it is up to the caller to stop or to carry on.
+The library side of it works on buffers only, Resize() takes a whole file in memory & gives back a whole file
+in memory, or takes & gives raw pixels, with no filesystem at all.
+*/
+
+//How a job runs, the same for every image of a batch
+struct ImageJobOptions
+{
+	float m_ResizeMultiplier;
+	bool m_Streaming;							//resize a block of rows at a time, never holding the whole image
+	EOutputCompression m_Compression;			//the result compression, by default the same as the source
+	bool m_MipChain;							//every half size level down to a 1 pixel side, instead of a single resize
+	ResampleSettings m_Resample;				//the filter, linear light & premultiplied alpha
+	ResultCache *m_Cache;						//NULL for no cache, owned by the caller
+
+	ImageJobOptions() : m_ResizeMultiplier(DEFAULT_RESIZE_MULTIPLIER), m_Streaming(false), m_Compression(EOutputCompression::SameAsSource), m_MipChain(false), m_Cache(NULL) {}
+};
+
+//What a job has done, for the batch summary
+struct ImageJobStats
+{
+	uint64_t m_Pixels;							//source pixels decoded
+	uint64_t m_BytesRead;						//decoded source bytes
+	uint64_t m_BytesWritten;					//encoded result bytes (pixels only)
+
+	ImageJobStats() : m_Pixels(0), m_BytesRead(0), m_BytesWritten(0) {}
+};
+
+class ImageJob
+{
+public:
+	//The default name of a result, [name].tga -> [name]_RESIZED.tga next to the source
+	static std::string ResizedPath(const std::string &inputPath)
+	{
+		std::experimental::filesystem::path _path = inputPath;
+		std::string _name = _path.stem().string() + "_RESIZED" + _path.extension().string();
+		_path.replace_filename(_name);
+		return _path.string();
+	}
+
+	//The name of a mip level, [name]_RESIZED.tga -> [name]_RESIZED_MIP1.tga, _MIP2, ...
+	static std::string MipPath(const std::string &outputPath, int level)
+	{
+		std::experimental::filesystem::path _path = outputPath;
+		std::string _name = _path.stem().string() + "_MIP" + std::to_string(level) + _path.extension().string();
+		_path.replace_filename(_name);
+		return _path.string();
+	}
+
+	static bool IsSupported(const std::string &inputPath)
+	{
+		std::string _fileFormat = std::experimental::filesystem::path(inputPath).extension().string();
+		return _fileFormat == IMG_FORMAT_TGA || _fileFormat == IMG_FORMAT_BMP;
+	}
+
+	static void ApplyOptions(TGA_Format &format, const ImageJobOptions &options)
+	{
+		format.ApplyCompression(options.m_Compression);
+	}
+
+	//BMP has no output options (no compression), nothing to apply
+	static void ApplyOptions(BMP_Format &, const ImageJobOptions &) {}
+
+	//The format of a path by its extension, fallback for anything else
+	static EImageFormat FormatOf(const std::string &path, EImageFormat fallback)
+	{
+		std::string _fileFormat = std::experimental::filesystem::path(path).extension().string();
+		return _fileFormat == IMG_FORMAT_BMP ? EImageFormat::BMP : _fileFormat == IMG_FORMAT_TGA ? EImageFormat::TGA : fallback;
+	}
+
+	//The image to write in a format, itself or converted into the holder, which then only views its pixels
+	static ImageFormatBase& Target(TGA_Format &image, EImageFormat format, BMP_Format &converted, const ImageJobOptions &options)
+	{
+		if (format != EImageFormat::BMP)
+			return image;
+		FormatConverter::Convert(image, converted, options.m_Resample.m_Origin);
+		return converted;
+	}
+
+	static ImageFormatBase& Target(BMP_Format &image, EImageFormat format, TGA_Format &converted, const ImageJobOptions &options)
+	{
+		if (format != EImageFormat::TGA)
+			return image;
+		FormatConverter::Convert(image, converted, options.m_Compression, options.m_Resample.m_Origin);
+		return converted;
+	}
+
+	//Writes an image in the format of the path extension, a TGA goes out as a BMP & the other way around
+	template<typename Format>
+	static void WriteAs(Format &image, const std::string &path, const ImageJobOptions &options)
+	{
+		typename ConvertedFormat<Format>::Type _converted;
+		Target(image, FormatOf(path, image.ImageFormat), _converted, options).OnImageWrite(path.c_str());
+	}
+
+	template<typename Format>
+	static void EncodeAs(Format &image, EImageFormat format, std::vector<uint8_t> &output, const ImageJobOptions &options)
+	{
+		typename ConvertedFormat<Format>::Type _converted;
+		Target(image, format, _converted, options).OnImageEncode(output);
+	}
+
+	/*
+	Writes the half size levels of a loaded image, each level is the 2x2 box (or the filter asked for) of the previous one, which was
+	just written & is still in the cache, so the whole chain costs about a third of the source to compute.
+	Only two levels live at once, a level reuses the pixels of the one before its previous one.
+	Stops once a side would go below 1 pixel.
+	*/
+	template<typename Format>
+	static uint64_t WriteMipChain(Format &source, const std::string &outputPath, const ImageJobOptions &options)
+	{
+		PROFILE_SCOPE("mips");
+		uint64_t _bytesWritten = 0;
+		Format _levels[2];
+		Format *_previous = &source;
+
+		for (int _level = 1; _previous->m_Image.m_Width >= 2 && _previous->m_Image.m_Height >= 2; _level++)
+		{
+			Format &_current = _levels[_level & 1];
+			_previous->OnImageResize(_current, 0.5f, options.m_Resample);
+			ApplyOptions(_current, options);
+			WriteAs(_current, MipPath(outputPath, _level), options);
+
+			_bytesWritten += _current.SizeInBytes();
+			_previous = &_current;
+		}
+
+		return _bytesWritten;
+	}
+
+	//Everything the results depend on besides the input (the cache key, the incremental manifest), the streaming gives the same bytes so it's left out
+	static std::string ResultParameters(const std::string &outputPath, const ImageJobOptions &options)
+	{
+		char _parameters[128];
+		sprintf_s(_parameters, "v%d %a %d %d %d %d %d %d %d ", RESULT_CACHE_VERSION, double(options.m_ResizeMultiplier),
+			int(options.m_Resample.m_Filter), int(options.m_Resample.m_Linear), int(options.m_Resample.m_Premultiplied), int(options.m_Compression), int(options.m_MipChain),
+			options.m_Resample.m_OutputDepth, int(options.m_Resample.m_Origin));
+		return _parameters + std::experimental::filesystem::path(outputPath).extension().string();
+	}
+
+	//The job through the result cache, a hit puts the cached result at the output path & skips the job. Mip chains aren't cached
+	static ImageJobStats Run(const std::string &inputPath, const std::string &outputPath, const ImageJobOptions &options)
+	{
+		if (options.m_Cache == NULL || options.m_MipChain)
+			return RunUncached(inputPath, outputPath, options);
+
+		std::string _entryPath = options.m_Cache->EntryPath(inputPath, ResultParameters(outputPath, options), outputPath);
+		if (options.m_Cache->Fetch(_entryPath, outputPath))
+		{
+			LOG("Cache hit: " << inputPath << " -> " << outputPath);
+			return ImageJobStats();
+		}
+
+		ImageJobStats _stats = RunUncached(inputPath, outputPath, options);
+		options.m_Cache->Store(_entryPath, outputPath);
+		return _stats;
+	}
+
+	/*
+	Whether the streaming asked for really streams a job, the rest goes the whole image way:
+	- an RLE source, its rows have no random access
+	- a BMP result, the converter works on a whole image
+	- an asked origin, the blocks are written in the rows order of the file & may need a flip
+	*/
+	static bool Streams(const std::string &inputPath, const std::string &outputPath, const ImageJobOptions &options)
+	{
+		return options.m_Streaming && !options.m_MipChain && std::experimental::filesystem::path(inputPath).extension().string() == IMG_FORMAT_TGA &&
+			FormatOf(outputPath, EImageFormat::TGA) == EImageFormat::TGA && options.m_Resample.m_Origin == EOutputOrigin::KeepOrigin &&
+			TGA_Stream::IsStreamable(inputPath.c_str());
+	}
+
+	//A BMP starts with "BM", a TGA has no signature of its own so it's anything else
+	static EImageFormat DetectFormat(const uint8_t *data, size_t size)
+	{
+		return size >= 2 && data[0] == 'B' && data[1] == 'M' ? EImageFormat::BMP : EImageFormat::TGA;
+	}
+
+	template<typename Format>
+	static ImageJobStats ResizeEncoded(const uint8_t *data, size_t size, EImageFormat outputFormat, std::vector<uint8_t> &output, const ImageJobOptions &options)
+	{
+		PROFILE_SCOPE("image");
+		ImageJobStats _stats;
+		Format _formatLoaded;
+		Format _formatGenerated;
+		_formatLoaded.OnImageDecode(data, size);
+		_formatLoaded.OnImageResize(_formatGenerated, options.m_ResizeMultiplier, options.m_Resample);
+		ApplyOptions(_formatGenerated, options);
+		EncodeAs(_formatGenerated, outputFormat, output, options);
+
+		_stats.m_Pixels = uint64_t(_formatLoaded.m_Image.m_Width) * _formatLoaded.m_Image.m_Height;
+		_stats.m_BytesRead = _formatLoaded.SizeInBytes();
+		_stats.m_BytesWritten = _formatGenerated.SizeInBytes();
+		return _stats;
+	}
+
+	/*
+	The in-memory job, a whole TGA or BMP file in data, the resized file appended to output, the same bytes the file job writes.
+	The uncompressed pixels are resampled right where they are in data, nothing gets copied on the way in.
+	Mip chains, streaming & the cache are about files, they are left to Run().
+	*/
+	static ImageJobStats Resize(const uint8_t *data, size_t size, std::vector<uint8_t> &output, const ImageJobOptions &options)
+	{
+		return Resize(data, size, DetectFormat(data, size), output, options);
+	}
+
+	//The same, the result converted to outputFormat (TGA or BMP)
+	static ImageJobStats Resize(const uint8_t *data, size_t size, EImageFormat outputFormat, std::vector<uint8_t> &output, const ImageJobOptions &options)
+	{
+		if (DetectFormat(data, size) == EImageFormat::BMP)
+			return ResizeEncoded<BMP_Format>(data, size, outputFormat, output, options);
+		return ResizeEncoded<TGA_Format>(data, size, outputFormat, output, options);
+	}
+
+	/*
+	Raw pixels in & out, no codec at all, the result gets aligned rows & the pixel format of the settings depth (the source one by default).
+	The source is taken as top-left, the bottom-left origin flips the rows, & the channels can come out as RGB(A).
+	*/
+	static void Resize(const ImageBuffer &source, ImageBuffer &result, float resizeMultiplier, const ResampleSettings &settings = ResampleSettings())
+	{
+		PROFILE_SCOPE("resize");
+		result.Allocate(int(float(source.m_Width) * resizeMultiplier), int(float(source.m_Height) * resizeMultiplier), settings.OutputFormat(source.m_Format));
+
+		Resampler _resampler;
+		_resampler.Configure(resizeMultiplier, settings);
+		_resampler.Orient(settings.m_Origin == EOutputOrigin::BottomLeft, false, settings.m_SwapRedBlue);
+		_resampler.Resize(source, result);
+	}
+
+	static ImageJobStats RunUncached(const std::string &inputPath, const std::string &outputPath, const ImageJobOptions &options)
+	{
+		PROFILE_SCOPE_FILE("image", inputPath);
+		ImageJobStats _stats;
+		std::string _fileFormat = std::experimental::filesystem::path(inputPath).extension().string();
+
+		if (options.m_MipChain && (_fileFormat == IMG_FORMAT_BMP || _fileFormat == IMG_FORMAT_TGA))
+		{
+			//the source is read once & the levels never go back to the disk, streaming has nothing to save here
+			if (_fileFormat == IMG_FORMAT_BMP)
+			{
+				BMP_Format _formatLoaded;
+				_formatLoaded.OnImageRead(inputPath.c_str());
+				_stats.m_BytesWritten = WriteMipChain(_formatLoaded, outputPath, options);
+				_stats.m_Pixels = uint64_t(_formatLoaded.m_Width) * _formatLoaded.RowsCount();
+				_stats.m_BytesRead = _formatLoaded.SizeInBytes();
+			}
+			else
+			{
+				TGA_Format _formatLoaded;
+				_formatLoaded.OnImageRead(inputPath.c_str());
+				_stats.m_BytesWritten = WriteMipChain(_formatLoaded, outputPath, options);
+				_stats.m_Pixels = uint64_t(_formatLoaded.m_ImageWidth) * _formatLoaded.m_ImageHeigh;
+				_stats.m_BytesRead = _formatLoaded.SizeInBytes();
+			}
+		}
+		else if (_fileFormat == IMG_FORMAT_BMP)
+		{
+			//same steps as the TGA, BMP has no streaming nor compression of its own, it always comes out as BI_RGB (or a TGA by the output extension)
+			BMP_Format _formatLoaded;
+			BMP_Format _formatGenerated;
+			_formatLoaded.OnImageRead(inputPath.c_str());
+			_formatLoaded.OnImageResize(_formatGenerated, options.m_ResizeMultiplier, options.m_Resample);
+			WriteAs(_formatGenerated, outputPath, options);
+
+			_stats.m_Pixels = uint64_t(_formatLoaded.m_Width) * _formatLoaded.RowsCount();
+			_stats.m_BytesRead = _formatLoaded.SizeInBytes();
+			_stats.m_BytesWritten = _formatGenerated.SizeInBytes();
+		}
+		else if (_fileFormat == IMG_FORMAT_JPG || _fileFormat == IMG_FORMAT_PNG)
+		{
+			//not there yet, a job writing nothing has to fail rather than count as done
+			LOG_ERROR("Unsupported image format " << _fileFormat);
+			THROW_ERROR("Unsupported image format");
+		}
+		else if (_fileFormat == IMG_FORMAT_TGA && Streams(inputPath, outputPath, options))
+		{
+			TGA_Stream _stream;
+			_stream.Resize(inputPath.c_str(), outputPath.c_str(), options.m_ResizeMultiplier, options.m_Compression, options.m_Resample);
+
+			_stats.m_Pixels = uint64_t(_stream.m_Source.m_ImageWidth) * _stream.m_Source.m_ImageHeigh;
+			_stats.m_BytesRead = _stream.m_Source.SizeInBytes();
+			_stats.m_BytesWritten = _stream.m_Result.SizeInBytes();
+		}
+		else if (_fileFormat == IMG_FORMAT_TGA)
+		{
+			//A TGA to load in, and another one to fill (scale up or down)
+			TGA_Format _formatLoaded;
+			TGA_Format _formatGenerated;
+			//Read the TGA passed by arguments (drag'n'drop, commandline or debugger)
+			_formatLoaded.OnImageRead(inputPath.c_str());
+			//Resize the TGA into a new empty one
+			_formatLoaded.OnImageResize(_formatGenerated, options.m_ResizeMultiplier, options.m_Resample);
+			_formatGenerated.ApplyCompression(options.m_Compression);
+			//Write the new TGA to disk, or a BMP by the output extension
+			WriteAs(_formatGenerated, outputPath, options);
+
+			_stats.m_Pixels = uint64_t(_formatLoaded.m_ImageWidth) * _formatLoaded.m_ImageHeigh;
+			_stats.m_BytesRead = _formatLoaded.SizeInBytes();
+			_stats.m_BytesWritten = _formatGenerated.SizeInBytes();
+		}
+		else
+		{
+			LOG_ERROR("Unsupported image format " << _fileFormat);
+			THROW_ERROR("Unsupported image format");
+		}
+
+		return _stats;
+	}
+};
\ No newline at end of file
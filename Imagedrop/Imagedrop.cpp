@@ -28,6 +28,56 @@ The usage:
 		Imagedrop.exe D:\testImages\sample_2.tga
 		Imagedrop.exe D:\testImages\sample_2.tga newImage.tga
 		Imagedrop.exe D:\testImages\sample_2.tga newImage.tga 0.5
+	- Options can be added anywhere after the exe, as --name=value
+		--threads=N		threads used to process a single image (default is all the hardware threads)
+		--stream		resize a block of rows at a time, the whole image is never held in memory (uncompressed TGA)
+		--compression=rle|none	compress the result or not (default is the same as the source)
+		--filter=NAME	nearest, bilinear (default, the box for 1/2, 1/4 & 1/8), box, bicubic (catmull-rom), mitchell, lanczos2, lanczos3
+		--linear		gamma correct, filter the linear light values instead of the sRGB ones (brighter & truer details, but slower, 2-3.5x a plain bilinear, 2.5-5.5x the box & +15-65% on the other filters)
+		--premultiply	filter the 32bit colors premultiplied by their alpha, no dark or colored fringes around the transparent areas (slower, 2.5-3.5x a plain bilinear or box & +30-50% on the other filters)
+		--mips			write every half size level (a mip chain) instead of a single resize, [name]_MIP1, _MIP2, ...
+		--depth=8|24|32	the depth of the results, 24 -> 32 with an opaque alpha, 32 -> 24 without it, 8 is gray (a BMP widens it back to 24)
+		--origin=top-left|bottom-left	where the first row of the results is (default is the same as the source), right to left sources come out left to right
+		--profile[=PATH]	time the stages & count the bytes & pixels, a summary at the end or a JSON report at PATH
+		--trace=PATH	a Chrome trace (chrome://tracing, Perfetto) of every timed scope on every thread
+		--log=LEVEL		error, warning, info (default) or debug (adds a peek at the pixels)
+		--cache=DIR		results cached by the input bytes & the resize settings, an unchanged input is linked from there instead of resized
+		--cache-max-mb=MB	bound of the cache, the least recently used results go first (default 4096)
+	- Batch mode, many images in one run, pass --batch instead of the image
+		--batch=PATH		a directory, a glob (D:\testImages\*.tga) or a manifest file with one image path per line
+		--out=DIR			where the results go, the subdirectories of a --batch directory kept (default is next to every source with the _RESIZED suffix)
+		--scale=F			the resize factor (default 0.5)
+		--max-memory=MB		cap of the decoded bytes in flight (default 1024)
+		--index=PATH		an index from the probe mode, the memory cap uses its sizes & the biggest images go first
+		--format=tga|bmp	convert the results (default is the format of every source)
+		--incremental[=PATH]	skip the images done by a previous run & unchanged since (size, mtime, settings, result still there),
+							the manifest is PATH or Imagedrop_Manifest.txt next to the results (or the sources)
+	example:
+		Imagedrop.exe --batch=D:\testImages --out=D:\resized --scale=0.25
+	- Probe mode, only the headers are read, an index of the images with no pixel read at all
+		--probe=PATH		a directory, a glob or a manifest, same as --batch
+		--index=PATH		the index, JSON lines (one image per line) or binary when PATH ends with .bin (default JSON lines to the console)
+		--scale=F			the resize factor the output sizes are estimated for (default 0.5)
+	example:
+		Imagedrop.exe --probe=D:\testImages --index=D:\testImages.jsonl
+	- Server mode, a long running process resizing on request over a local socket, the threads, pixel pools & filter tables stay warm
+		--serve=PATH		the socket to listen on, the other options (--cache, --stream, --mips, ...) apply to every request
+	- Client of the server mode, sends the images & reports the latencies
+		--client=PATH		the socket of the server, the images are the positional arguments or --batch=PATH
+		--inline			send the image bytes & get the result back, instead of two paths for the server to read & write
+		--format=tga|bmp	convert the results (default is the format of every source)
+		--out=DIR			where the results go (default is next to every source with the _RESIZED suffix, inline ones are dropped)
+		--scale=F, --filter=NAME, --linear, --premultiply, --compression, --depth, --origin	the settings sent along every request
+		--pipeline=N		requests in flight at once (default 16)
+		--repeat=N			send the images N times
+		--stats, --stop		the latencies of the server so far, or stop it
+	example:
+		Imagedrop.exe --serve=C:\Temp\imagedrop.sock --cache=D:\cache
+		Imagedrop.exe --client=C:\Temp\imagedrop.sock --batch=D:\testImages --inline --pipeline=32 --repeat=10
+	example:
+		Imagedrop.exe D:\testImages\sample_2.tga newImage.tga 0.5 --threads=8
+	- Kernels benchmark, times the generic resize loop against the ones specialized per pixel format (8, 24 & 32bit)
+		Imagedrop.exe --bench-kernels
 	- When use command line, you need the source image location, not only name, so it can work regardless where the image is located at your PC
 
 #VS Debugger
@@ -41,18 +91,60 @@ The usage:
 #include <filesystem>
 #include <chrono>
 #include <array>
+#include <memory>
 #include "Consts.h"
 #include "Bits.h"
+#include "Logger.h"
 #include "Macros.h"
+#include "CommandLine.h"
+#include "ThreadPool.h"
 #include "ImageFormatBase.h"
+#include "Profiler.h"
+#include "ImageBuffer.h"
+#include "MappedFile.h"
+#include "ByteOrder.h"
+#include "FileWriter.h"
+#include "CpuFeatures.h"
+#include "LinearLight.h"
+#include "ResampleKernels.h"
+#include "ResampleFilters.h"
+#include "Resampler.h"
 #include "BMPFormat.h"
+#include "TGARLE.h"
 #include "TGAFormat.h"
+#include "TGAStream.h"
+#include "FormatConverter.h"
+#include "Hash.h"
+#include "ResultCache.h"
+#include "ImageJob.h"
+#include "ImageIndex.h"
+#include "BatchManifest.h"
+#include "Batch.h"
+#include "KernelBenchmark.h"
+#include "LocalSocket.h"
+#include "ResizeServer.h"
+#include "ResizeClient.h"
 
 //void OnReadTGA(TGA_Format &format, const char *path){}
 //void OnWriteTGA(TGA_Format &format, const char *path){}
 //void OnResizeTGA(const TGA_Format &sourceFormat, TGA_Format &newFormat, float resizeMultiplier){}
 //void OnReadBMP(BMP_Format &format, const char *path){}
 
+//The profiler reports, asked for by --profile & --trace, all the work is done by now
+void WriteProfile(const CommandLine &commandLine)
+{
+	if (!Profiler::Enabled())
+		return;
+
+	if (!commandLine.Get("profile", "").empty())
+		Profiler::Get().WriteReport(commandLine.Get("profile", ""));
+	else if (commandLine.Has("profile"))
+		Profiler::Get().PrintSummary();
+
+	if (!commandLine.Get("trace", "").empty())
+		Profiler::Get().WriteTrace(commandLine.Get("trace", ""));
+}
+
 int main(int argc, char *argv[])
 {
 	//-----------------------------------------------------------------------
@@ -60,83 +152,210 @@ int main(int argc, char *argv[])
 	//-----------------------------------------------------------------------
 
 	/*
-	The arguments i expect to be passed shall not be less than 2 or more than 4
+	The arguments i expect to be passed shall not be less than 2 or more than 4 (options aside)
 	[0] exe		[1] Image		[2] New Name		[3] Scale Factor
 	*/
+	CommandLine _commandLine(argc, argv);
+	const std::vector<std::string> &_arguments = _commandLine.m_Arguments;
 
-	if (argc < 2 || argc > 4)
+	//The pool is created on its first use, so size it before any image work starts, 0 is all the hardware threads
+	int _threads = _commandLine.GetInt("threads", DEFAULT_THREADS);
+	if (_threads < 0)
 	{
-		LOG("ERR	Few or many arguments been passed to the app, make sure to pass params correctly");
-		THROW_ERROR("Few or many arguments been passed to the app, make sure to pass params correctly");
+		LOG_ERROR("Unsupported threads count " << _commandLine.Get("threads", ""));
+		THROW_ERROR("Unsupported threads count");
 	}
-	else
+	ThreadPool::Get((unsigned int)_threads);
+
+	if (_commandLine.Has("log") && !Logger::Parse(_commandLine.Get("log", ""), Logger::Level()))
 	{
-		//the resize multiplier, either passed to the app or auto set to 0.5
-		float _resizeMultiplier;
+		LOG_ERROR("Unknown log level " << _commandLine.Get("log", ""));
+		THROW_ERROR("Unknown log level");
+	}
 
-		/*Prepare a path and filename for the new generated image
-		either way, a param passed for new image name, or not, then one
-		will be generated from the original file name in case there
-		isn't a name been apssed through arguments using the same original
-		source image file format)*/
-		std::experimental::filesystem::path _path = argv[1];
-		std::string _fileFormat = _path.extension().string().c_str();
-		std::string _autoName = _path.filename().string().c_str();
-		_autoName.replace(_autoName.end() - 4, _autoName.begin(), "_RESIZED");
-		char _buffer[256];
-		sprintf_s(_buffer, "%s%s", _autoName.c_str(), _fileFormat.c_str());
+	if (_commandLine.Has("profile") || _commandLine.Has("trace"))
+		Profiler::Get().Enable(_commandLine.Has("trace"));
 
-		//Check if user input a new file name, or we use the generated value above
-		if (argc < 3)
-			_path.replace_filename(_buffer);
-		else
-			_path.replace_filename(argv[2]);
+	ImageJobOptions _options;
+	_options.m_Streaming = _commandLine.Has("stream");
+	_options.m_MipChain = _commandLine.Has("mips");
+	_options.m_Resample.m_Linear = _commandLine.Has("linear");
+	_options.m_Resample.m_Premultiplied = _commandLine.Has("premultiply");
+	if (_commandLine.Has("filter") && !ResampleFilters::Parse(_commandLine.Get("filter", ""), _options.m_Resample.m_Filter))
+	{
+		LOG_ERROR("Unknown filter " << _commandLine.Get("filter", ""));
+		THROW_ERROR("Unknown filter");
+	}
+	if (_commandLine.Get("compression", "") == "rle")
+		_options.m_Compression = EOutputCompression::RLE;
+	else if (_commandLine.Get("compression", "") == "none")
+		_options.m_Compression = EOutputCompression::Uncompressed;
 
-		//Check if user input a resize multiplier, or we use the defualt value
-		if (argc > 3)
-			_resizeMultiplier = (float)atof(argv[3]);
-		else
-			_resizeMultiplier = DEFAULT_RESIZE_MULTIPLIER;
+	//the layout of the results, converted by the resize itself while it stores the pixels
+	_options.m_Resample.m_OutputDepth = _commandLine.GetInt("depth", 0);
+	if (_options.m_Resample.m_OutputDepth != 0 && _options.m_Resample.m_OutputDepth != 8 && _options.m_Resample.m_OutputDepth != 24 && _options.m_Resample.m_OutputDepth != 32)
+	{
+		LOG_ERROR("Unsupported depth " << _commandLine.Get("depth", ""));
+		THROW_ERROR("Unsupported depth");
+	}
+	if (_commandLine.Get("origin", "") == "top-left")
+		_options.m_Resample.m_Origin = EOutputOrigin::TopLeft;
+	else if (_commandLine.Get("origin", "") == "bottom-left")
+		_options.m_Resample.m_Origin = EOutputOrigin::BottomLeft;
+	else if (_commandLine.Has("origin"))
+	{
+		LOG_ERROR("Unknown origin " << _commandLine.Get("origin", ""));
+		THROW_ERROR("Unknown origin");
+	}
 
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
-#endif // USE_LOG_TIME
+	//lives as long as main, the jobs only point at it
+	std::unique_ptr<ResultCache> _cache;
+	if (!_commandLine.Get("cache", "").empty())
+	{
+		_cache.reset(new ResultCache(_commandLine.Get("cache", ""), uint64_t(_commandLine.GetInt("cache-max-mb", DEFAULT_CACHE_MAX_MB)) * 1024 * 1024));
+		_options.m_Cache = _cache.get();
+	}
+
+	if (_commandLine.Has("bench-kernels"))
+	{
+		KernelBenchmark _benchmark(4096, 1000);
+		_benchmark.Run();
+
+		WAIT_INPUT;
+		return 0;
+	}
+
+	//a daemon, nothing to wait for once it's stopped
+	if (_commandLine.Has("serve"))
+	{
+		ResizeServer _server(_commandLine.Get("serve", ""), _options);
+		bool _served = _server.Run();
+		WriteProfile(_commandLine);
+		return _served ? 0 : 1;
+	}
 
-		if (_fileFormat == IMG_FORMAT_BMP)
+	if (_commandLine.Has("client"))
+	{
+		ResizeClient _client;
+		if (!_client.Connect(_commandLine.Get("client", "")))
 		{
-			BMP_Format _formatLoaded;
-			BMP_Format _formatGenerated;
-			_formatLoaded.OnImageRead(argv[1]);
+			LOG_ERROR("Can't connect to " << _commandLine.Get("client", ""));
+			return 1;
 		}
-		else if (_fileFormat == IMG_FORMAT_JPG)
-		{
 
+		std::string _text;
+		if (_commandLine.Has("stats") || _commandLine.Has("stop"))
+		{
+			if (!_client.Call(_commandLine.Has("stop") ? EResizeRequest::ServerStop : EResizeRequest::ServerStats, _text))
+				return 1;
+			LOG_FLUSH();
+			std::cout << "Server: " << _text << std::endl;
+			return 0;
 		}
-		else if (_fileFormat == IMG_FORMAT_PNG)
+
+		std::vector<std::string> _inputs = _arguments;
+		if (_commandLine.Has("batch"))
+			BatchJob::Collect(_commandLine.Get("batch", ""), _inputs);
+		if (_inputs.empty())
 		{
+			LOG_ERROR("No image to send");
+			return 1;
+		}
 
+		_options.m_ResizeMultiplier = _commandLine.GetFloat("scale", DEFAULT_RESIZE_MULTIPLIER);
+		_client.m_OutputDirectory = _commandLine.Get("out", "");
+		if (_commandLine.Has("format"))
+			_client.m_OutputExtension = "." + _commandLine.Get("format", "");
+		_client.m_Pipeline = std::max(1, _commandLine.GetInt("pipeline", _client.m_Pipeline));
+		if (!_client.m_OutputDirectory.empty())
+			std::experimental::filesystem::create_directories(_client.m_OutputDirectory);
+		_client.Run(_inputs, _options, _commandLine.Has("inline"), _commandLine.GetInt("repeat", 1));
+		return _client.m_Failed > 0 ? 1 : 0;
+	}
+
+	if (_commandLine.Has("probe"))
+	{
+		std::vector<std::string> _inputs;
+		BatchJob::Collect(_commandLine.Get("probe", ""), _inputs);
+
+		std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
+		ImageIndex _index;
+		_index.Probe(_inputs, _commandLine.GetFloat("scale", DEFAULT_RESIZE_MULTIPLIER));
+		std::chrono::duration<double> _duration = std::chrono::high_resolution_clock::now() - _startTime;
+
+		if (_commandLine.Get("index", "").empty())
+		{
+			_index.WriteJSONLines(std::cout);
 		}
-		else if (_fileFormat == IMG_FORMAT_TGA)
+		else
 		{
-			//A TGA to load in, and another one to fill (scale up or down)
-			TGA_Format _formatLoaded;
-			TGA_Format _formatGenerated;
-			//Read the TGA passed by arguments (drag'n'drop, commandline or debugger)
-			_formatLoaded.OnImageRead(argv[1]);
-			//Resize the TGA into a new empty one
-			_formatLoaded.OnImageResize(_formatGenerated, _resizeMultiplier);
-			//Write the new TGA to disk
-			_formatGenerated.OnImageWrite((_path.string()).c_str());
+			if (!_index.Write(_commandLine.Get("index", "")))
+			{
+				LOG_ERROR("Can't write the index " << _commandLine.Get("index", ""));
+				THROW_ERROR("Can't write the index");
+			}
+			_index.PrintSummary(_duration.count());
 		}
+		WriteProfile(_commandLine);
+
+		WAIT_INPUT;
+		return 0;
+	}
+
+	if (_commandLine.Has("batch"))
+	{
+		_options.m_ResizeMultiplier = _commandLine.GetFloat("scale", DEFAULT_RESIZE_MULTIPLIER);
+		BatchJob _batch(
+			_options,
+			uint64_t(_commandLine.GetInt("max-memory", DEFAULT_BATCH_MAX_MEMORY_MB)) * 1024 * 1024);
+		_batch.m_OutputDirectory = _commandLine.Get("out", "");
+		if (_commandLine.Has("format"))
+			_batch.m_OutputExtension = "." + _commandLine.Get("format", "");
+		_batch.CollectInputs(_commandLine.Get("batch", ""));
+		if (_commandLine.Has("incremental"))
+			_batch.m_ManifestPath = _commandLine.Get("incremental", "").empty() ? _batch.DefaultManifestPath(_commandLine.Get("batch", "")) : _commandLine.Get("incremental", "");
+		if (_commandLine.Has("index") && !_batch.LoadIndex(_commandLine.Get("index", "")))
+			LOG_WARNING("Can't read the index " << _commandLine.Get("index", "") << ", the batch runs without it");
+		_batch.Run();
+		WriteProfile(_commandLine);
+
+		WAIT_INPUT;
+		return _batch.m_Failed > 0 ? 1 : 0;
+	}
 
-		
+	if (_arguments.size() < 1 || _arguments.size() > 3)
+	{
+		LOG_ERROR("Few or many arguments been passed to the app, make sure to pass params correctly");
+		THROW_ERROR("Few or many arguments been passed to the app, make sure to pass params correctly");
+	}
+	else
+	{
+		/*Prepare a path and filename for the new generated image
+		either way, a param passed for new image name, or not, then one
+		will be generated from the original file name in case there
+		isn't a name been apssed through arguments using the same original
+		source image file format)*/
+		std::experimental::filesystem::path _path = ImageJob::ResizedPath(_arguments[0]);
 
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _endTime = std::chrono::high_resolution_clock::now();
-		std::chrono::duration<float> _duration = _endTime - _startTime;
-		LOG("Time Spent - Total: " << _duration.count()* 1000.f << "ms");
-#endif // USE_LOG_TIME	
+		//Check if user input a new file name, or we use the generated value above
+		if (_arguments.size() > 1)
+			_path.replace_filename(_arguments[1]);
+
+		//Check if user input a resize multiplier, or we use the defualt value
+		if (_arguments.size() > 2)
+			_options.m_ResizeMultiplier = (float)atof(_arguments[2].c_str());
 
+		//Read, resize & write the image passed by arguments (drag'n'drop, commandline or debugger)
+		{
+			PROFILE_SCOPE("total");
+			ImageJob::Run(_arguments[0], _path.string(), _options);
+		}
+		if (_cache)
+		{
+			_cache->Trim();
+			LOG("Cache: " << _cache->m_Hits << " hits, " << _cache->m_Misses << " misses, " << _cache->m_Evictions << " evicted");
+		}
+		WriteProfile(_commandLine);
 
 		WAIT_INPUT;
 
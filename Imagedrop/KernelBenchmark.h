@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include "Macros.h"
+#include "ImageBuffer.h"
+#include "ResampleKernels.h"
+#include "Resampler.h"
+
+/*
+The kernels benchmark, --bench-kernels
+Times the horizontal pass of a synthetic row, the generic loop (channels known at runtime only) against
+the kernels specialized for the pixel format, scalar & the best SIMD one the CPU has, for 8, 24 & 32bit.
+Every kernel is checked against the generic one first, a faster kernel giving other bytes is worth nothing.
+*/
+class KernelBenchmark
+{
+public:
+	int m_SourceWidth;
+	int m_Iterations;
+
+	KernelBenchmark(int sourceWidth, int iterations) : m_SourceWidth(sourceWidth), m_Iterations(iterations) {}
+
+	//The best time of a few rounds, the first rounds warm the caches up
+	template<typename Function>
+	double MeasureNanoseconds(int pixels, Function function)
+	{
+		double _best = 1e30;
+		for (int _round = 0; _round < 5; _round++)
+		{
+			std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < m_Iterations; i++)
+				function();
+			std::chrono::duration<double> _duration = std::chrono::high_resolution_clock::now() - _startTime;
+
+			double _perPixel = _duration.count() * 1e9 / (double(m_Iterations) * pixels);
+			if (_perPixel < _best)
+				_best = _perPixel;
+		}
+		return _best;
+	}
+
+	template<EPixelFormat Format>
+	void RunFormat(float resizeMultiplier, EResampleKernel best)
+	{
+		const int _channels = PixelTraits<Format>::Channels;
+		const int _dstWidth = int(m_SourceWidth * resizeMultiplier);
+
+		std::vector<uint8_t> _row(size_t(m_SourceWidth) * _channels);
+		for (size_t i = 0; i < _row.size(); i++)
+			_row[i] = uint8_t(rand());
+
+		//same taps the resampler builds
+		Resampler _resampler(best);
+		_resampler.Prepare(m_SourceWidth, 1, _dstWidth, 1, Format);
+		const FixedTap *_taps = _resampler.m_FixedColumnTaps.data();
+		const int _simd = _resampler.m_SimdColumns;
+
+		ResampleKernels _scalar(EResampleKernel::Scalar, Format);
+		ResampleKernels _fast(best, Format);
+
+		std::vector<int16_t> _expected(size_t(_dstWidth) * _channels + 4);
+		std::vector<int16_t> _out(_expected.size());
+		const uint8_t *_source = _row.data();
+		int16_t *_result = _out.data();
+
+		HorizontalGeneric(_source, _taps, _dstWidth, _channels, _expected.data());
+		_fast.m_Horizontal(_source, _taps, _simd, _result);
+		_fast.m_HorizontalScalar(_source, _taps + _simd, _dstWidth - _simd, _result + _simd * _channels);
+		bool _same = memcmp(_expected.data(), _result, size_t(_dstWidth) * _channels * sizeof(int16_t)) == 0;
+
+		double _generic = MeasureNanoseconds(_dstWidth, [&]()
+		{
+			HorizontalGeneric(_source, _taps, _dstWidth, _channels, _result);
+		});
+		double _specialized = MeasureNanoseconds(_dstWidth, [&]()
+		{
+			_scalar.m_Horizontal(_source, _taps, _dstWidth, _result);
+		});
+		double _vectorized = MeasureNanoseconds(_dstWidth, [&]()
+		{
+			_fast.m_Horizontal(_source, _taps, _simd, _result);
+			_fast.m_HorizontalScalar(_source, _taps + _simd, _dstWidth - _simd, _result + _simd * _channels);
+		});
+
+		std::cout << std::setw(6) << _channels * 8 << "bit" << std::setw(8) << resizeMultiplier
+			<< std::setw(12) << _generic << std::setw(12) << _specialized << std::setw(12) << _vectorized
+			<< std::setw(10) << _generic / _specialized << "x" << std::setw(10) << _generic / _vectorized << "x"
+			<< (_same ? "" : "   MISMATCH") << "\n";
+	}
+
+	void Run()
+	{
+		EResampleKernel _best = ResampleKernels::Detect();
+		const char *_names[] = { "Reference", "Scalar", "SSE2", "AVX2" };
+
+		LOG_FLUSH();
+		std::cout << "=================K=E=R=N=E=L=S=================" << "\n";
+		std::cout << "Source row: " << m_SourceWidth << " pixels, best kernel: " << _names[_best] << "\n";
+		std::cout << "ns per output pixel, horizontal pass" << "\n";
+		std::cout << std::setw(9) << "format" << std::setw(8) << "scale" << std::setw(12) << "generic" << std::setw(12) << "templated"
+			<< std::setw(12) << _names[_best] << std::setw(11) << "gain" << std::setw(11) << "gain" << "\n";
+		std::cout << std::fixed << std::setprecision(2);
+
+		const float _multipliers[] = { 0.5f, 1.5f };
+		for (int i = 0; i < 2; i++)
+		{
+			RunFormat<EPixelFormat::Gray8>(_multipliers[i], _best);
+			RunFormat<EPixelFormat::BGR24>(_multipliers[i], _best);
+			RunFormat<EPixelFormat::BGRA32>(_multipliers[i], _best);
+		}
+		std::cout << "================================================" << std::endl;
+	}
+};
\ No newline at end of file
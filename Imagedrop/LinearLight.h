@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+/*
+The sRGB <-> linear light tables of the gamma correct resampling (--linear)
+- An 8bit sRGB value is light on a curve, averaging two of them straight away gives a darker result than
+	the light they stand for (the edges & fine details darken when scaling down). The filters have to run
+	on the linear light values instead, and the result goes back to sRGB at the end.
+- Decoding is a 256 entries table, to 12bit linear [0, 4095], kept in int16 lanes so the working rows are
+	no wider than the plain convolution ones.
+- Encoding is a 4096 entries table indexed by the 12bit linear value, so no pow() per channel anywhere.
+	12bits is enough for every one of the 256 sRGB values to come back as itself.
+- Alpha isn't gamma encoded, it gets its own straight tables, the 32bit kernels pick the table per channel.
+	The premultiplied path (--premultiply) runs the colors through the same straight tables when it's not linear.
+- Expanding is a bit replication (v << 4 | v >> 4), so the SIMD decode gives the exact same values as the table.
+	Narrowing back, (v * 255 + 2047) / 4095, is exactly (mulhi(v, 8162) + 1) >> 1 over the 12bit range, the SIMD kernels
+	do that instead of a lookup per byte.
+- The AVX2 kernels gather from the tables, a lane picks the straight table by an offset from the sRGB one, so those two
+	pairs stay back to back (a gather reads 4 bytes, the last entries read a little into the next table, never past the object).
+- Un-premultiplying is a 4096 entries float reciprocal table indexed by the 12bit alpha, no divides per pixel.
+*/
+#define LINEAR_LIGHT_BITS								12
+#define LINEAR_LIGHT_MAX								((1 << LINEAR_LIGHT_BITS) - 1)
+
+class LinearLight
+{
+public:
+	int16_t m_ToLinear[256];
+	int16_t m_Expand[256];						//right after m_ToLinear
+	uint8_t m_ToSRGB[LINEAR_LIGHT_MAX + 1];
+	uint8_t m_Narrow[LINEAR_LIGHT_MAX + 1];		//right after m_ToSRGB
+	float m_Unpremultiply[LINEAR_LIGHT_MAX + 1];
+
+	LinearLight()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			double _srgb = i / 255.0;
+			double _linear = _srgb <= 0.04045 ? _srgb / 12.92 : pow((_srgb + 0.055) / 1.055, 2.4);
+			m_ToLinear[i] = int16_t(floor(_linear * LINEAR_LIGHT_MAX + 0.5));
+			m_Expand[i] = int16_t((i << 4) | (i >> 4));
+		}
+
+		for (int i = 0; i <= LINEAR_LIGHT_MAX; i++)
+		{
+			double _linear = double(i) / LINEAR_LIGHT_MAX;
+			double _srgb = _linear <= 0.0031308 ? _linear * 12.92 : 1.055 * pow(_linear, 1.0 / 2.4) - 0.055;
+			m_ToSRGB[i] = uint8_t(floor(_srgb * 255.0 + 0.5));
+			m_Narrow[i] = uint8_t((i * 255 + LINEAR_LIGHT_MAX / 2) / LINEAR_LIGHT_MAX);
+			m_Unpremultiply[i] = i ? float(LINEAR_LIGHT_MAX) / i : 0.0f;
+		}
+	}
+
+	//Built once on the first use, read only after that so every thread can share it
+	static const LinearLight& Get()
+	{
+		static const LinearLight _tables;
+		return _tables;
+	}
+};
\ No newline at end of file
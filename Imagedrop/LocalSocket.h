@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "ByteOrder.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/*
+A stream socket over a local (Unix domain) path, the transport of the server mode
+- Windows 10 (1803 on) has AF_UNIX too through afunix.h, so it's the same code on both sides but the handle type.
+- Nothing throws here, every call reports & the caller decides, same as MappedFile.
+- SendAll & ReceiveAll loop until the whole block went through, a short send or receive is not an error.
+*/
+class LocalSocket
+{
+public:
+#if defined(_WIN32)
+	typedef SOCKET Handle;
+	static Handle InvalidHandle() { return INVALID_SOCKET; }
+#else
+	typedef int Handle;
+	static Handle InvalidHandle() { return -1; }
+#endif
+
+	Handle m_Handle;
+
+	LocalSocket() : m_Handle(InvalidHandle()) {}
+	~LocalSocket()
+	{
+		Close();
+	}
+
+	//a socket can't be shared between two owners
+	LocalSocket(const LocalSocket&) = delete;
+	LocalSocket& operator=(const LocalSocket&) = delete;
+
+	bool IsOpen() const
+	{
+		return m_Handle != InvalidHandle();
+	}
+
+	//Winsock wants a start before the first socket, once per process
+	static bool Startup()
+	{
+#if defined(_WIN32)
+		static bool _started = []()
+		{
+			WSADATA _data;
+			return WSAStartup(MAKEWORD(2, 2), &_data) == 0;
+		}();
+		return _started;
+#else
+		return true;
+#endif
+	}
+
+	static bool Address(const std::string &path, sockaddr_un &address)
+	{
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+			return false;
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		return true;
+	}
+
+	//Binds path & listens, a stale socket file left by a killed server is removed first
+	bool Listen(const std::string &path)
+	{
+		sockaddr_un _address;
+		if (!Startup() || !Address(path, _address))
+			return false;
+
+		m_Handle = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (!IsOpen())
+			return false;
+
+		remove(path.c_str());
+		if (bind(m_Handle, reinterpret_cast<const sockaddr*>(&_address), sizeof(_address)) != 0 || listen(m_Handle, SOMAXCONN) != 0)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	//Blocks until a client connects, false once the listening socket is closed
+	bool Accept(LocalSocket &client)
+	{
+		client.Close();
+		client.m_Handle = accept(m_Handle, NULL, NULL);
+		return client.IsOpen();
+	}
+
+	bool Connect(const std::string &path)
+	{
+		sockaddr_un _address;
+		if (!Startup() || !Address(path, _address))
+			return false;
+
+		m_Handle = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (!IsOpen())
+			return false;
+
+		if (connect(m_Handle, reinterpret_cast<const sockaddr*>(&_address), sizeof(_address)) != 0)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool SendAll(const void *data, size_t size)
+	{
+		const char *_data = static_cast<const char*>(data);
+		while (size > 0)
+		{
+			//a peer gone away is a failed send, not a SIGPIPE killing the whole server
+#if defined(_WIN32)
+			int _sent = send(m_Handle, _data, int(size < 0x40000000 ? size : 0x40000000), 0);
+#elif defined(MSG_NOSIGNAL)
+			ssize_t _sent = send(m_Handle, _data, size, MSG_NOSIGNAL);
+#else
+			ssize_t _sent = send(m_Handle, _data, size, 0);
+#endif
+			if (_sent <= 0)
+				return false;
+			_data += _sent;
+			size -= size_t(_sent);
+		}
+		return true;
+	}
+
+	//false on a closed connection or an error, a clean end between two messages included
+	bool ReceiveAll(void *data, size_t size)
+	{
+		char *_data = static_cast<char*>(data);
+		while (size > 0)
+		{
+#if defined(_WIN32)
+			int _received = recv(m_Handle, _data, int(size < 0x40000000 ? size : 0x40000000), 0);
+#else
+			ssize_t _received = recv(m_Handle, _data, size, 0);
+#endif
+			if (_received <= 0)
+				return false;
+			_data += _received;
+			size -= size_t(_received);
+		}
+		return true;
+	}
+
+	//A frame is its bytes count (u32, little endian) & the bytes, false once the connection is closed or the frame is over maxSize
+	bool ReceiveFrame(std::vector<uint8_t> &frame, size_t maxSize)
+	{
+		uint8_t _size[4];
+		if (!ReceiveAll(_size, sizeof(_size)))
+			return false;
+
+		uint32_t _frameSize = ByteOrder::Read32(_size);
+		if (_frameSize > maxSize)
+			return false;
+
+		frame.resize(_frameSize);
+		return _frameSize == 0 || ReceiveAll(frame.data(), _frameSize);
+	}
+
+	//Wakes up whoever is blocked receiving on it, the handle stays valid until Close()
+	void Shutdown()
+	{
+		if (!IsOpen())
+			return;
+#if defined(_WIN32)
+		shutdown(m_Handle, SD_BOTH);
+#else
+		shutdown(m_Handle, SHUT_RDWR);
+#endif
+	}
+
+	void Close()
+	{
+		if (!IsOpen())
+			return;
+#if defined(_WIN32)
+		closesocket(m_Handle);
+#else
+		close(m_Handle);
+#endif
+		m_Handle = InvalidHandle();
+	}
+};
\ No newline at end of file
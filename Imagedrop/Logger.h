@@ -0,0 +1,263 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include "Settings.h"
+
+/*
+The asynchronous log behind LOG, LOG_ERROR, LOG_WARNING & LOG_DEBUG
+- A line is formatted on the calling thread into its own reused stream, then copied into the ring buffer of
+	that thread. The ring has a single writer (its thread) & a single reader (the drain), so it's two atomics
+	& no locks, the workers of a batch never wait on the console nor on each other.
+- A background thread drains the rings into stdout every LOG_FLUSH_INTERVAL_MS, or sooner once a ring
+	gets half full. The lines of one thread keep their order, the lines of different threads come out per drain.
+- Errors are drained right away, they are mostly followed by a THROW_ERROR that may never get to the exit.
+- A full ring drains itself on its own thread, nothing is dropped, it only costs the old synchronous write.
+- Levels above LOG_MAX_LEVEL are compiled out, the rest cost a compare against the runtime level (--log=LEVEL)
+	before anything gets formatted.
+- Anything writing std::cout straight away (the summaries) calls Flush() first, so the order holds.
+*/
+
+//The levels, lower is more important
+enum ELogLevel
+{
+	LogError,
+	LogWarning,
+	LogInfo,
+	LogDebug
+};
+
+//The ring of one thread, bytes of [uint32 length][text] records
+struct LogRing
+{
+	std::vector<char> m_Data;
+	std::atomic<size_t> m_Head;						//written by the owner thread only
+	std::atomic<size_t> m_Tail;						//written by the drain only
+	std::ostringstream m_Stream;					//formatting, reused line after line
+
+	LogRing() : m_Data(size_t(LOG_THREAD_BUFFER_KB) * 1024), m_Head(0), m_Tail(0) {}
+
+	size_t Mask() const
+	{
+		return m_Data.size() - 1;
+	}
+
+	void Copy(size_t position, const void *source, size_t size)
+	{
+		const char *_source = static_cast<const char*>(source);
+		for (size_t i = 0; i < size; i++)
+			m_Data[(position + i) & Mask()] = _source[i];
+	}
+
+	//false when there's no room, the owner has to drain first
+	bool Push(const std::string &line)
+	{
+		uint32_t _length = uint32_t(line.size());
+		size_t _head = m_Head.load(std::memory_order_relaxed);
+		size_t _tail = m_Tail.load(std::memory_order_acquire);
+		if (_head - _tail + sizeof(_length) + _length > m_Data.size())
+			return false;
+
+		Copy(_head, &_length, sizeof(_length));
+		Copy(_head + sizeof(_length), line.data(), _length);
+		m_Head.store(_head + sizeof(_length) + _length, std::memory_order_release);
+		return true;
+	}
+
+	bool HalfFull() const
+	{
+		return m_Head.load(std::memory_order_relaxed) - m_Tail.load(std::memory_order_relaxed) > m_Data.size() / 2;
+	}
+
+	//Moves the pending records into the output text, the caller holds the drain lock
+	void Pop(std::string &output)
+	{
+		size_t _tail = m_Tail.load(std::memory_order_relaxed);
+		size_t _head = m_Head.load(std::memory_order_acquire);
+		while (_tail != _head)
+		{
+			uint32_t _length = 0;
+			for (size_t i = 0; i < sizeof(_length); i++)
+				reinterpret_cast<char*>(&_length)[i] = m_Data[(_tail + i) & Mask()];
+			_tail += sizeof(_length);
+
+			for (uint32_t i = 0; i < _length; i++)
+				output += m_Data[(_tail + i) & Mask()];
+			output += '\n';
+			_tail += _length;
+		}
+		m_Tail.store(_tail, std::memory_order_release);
+	}
+};
+
+class Logger
+{
+public:
+	std::mutex m_RingsLock;
+	std::vector<std::unique_ptr<LogRing>> m_Rings;
+
+	std::mutex m_DrainLock;
+	std::string m_Output;
+
+	std::mutex m_WakeLock;
+	std::condition_variable m_Wake;
+	bool m_Stop;
+	std::thread m_Writer;
+
+	Logger() : m_Stop(false)
+	{
+		m_Writer = std::thread(&Logger::WriterLoop, this);
+	}
+
+	~Logger()
+	{
+		{
+			std::lock_guard<std::mutex> _lock(m_WakeLock);
+			m_Stop = true;
+		}
+		m_Wake.notify_one();
+		m_Writer.join();
+		Flush();
+	}
+
+	static Logger& Get()
+	{
+		static Logger _logger;
+		return _logger;
+	}
+
+	//A constant initialized static like the profiler switch, set from the command line before any work starts
+	static int& Level()
+	{
+		static int _level = LOG_DEFAULT_LEVEL;
+		return _level;
+	}
+
+	static bool Enabled(ELogLevel level)
+	{
+		return level <= Level();
+	}
+
+	//error, warning, info or debug, false for anything else
+	static bool Parse(const std::string &name, int &level)
+	{
+		const char *_names[] = { "error", "warning", "info", "debug" };
+		for (int i = 0; i <= LogDebug; i++)
+		{
+			if (name == _names[i])
+			{
+				level = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static const char* Prefix(ELogLevel level)
+	{
+		const char *_prefixes[] = { "Err:", "Wrn:", "Log:", "Dbg:" };
+		return _prefixes[level];
+	}
+
+	//The ring of the calling thread, registered on its first use. The rings belong to the logger, they outlive their threads
+	LogRing& Ring()
+	{
+		thread_local LogRing *_ring = NULL;
+		if (_ring == NULL)
+		{
+			std::lock_guard<std::mutex> _lock(m_RingsLock);
+			m_Rings.emplace_back(new LogRing());
+			_ring = m_Rings.back().get();
+		}
+		return *_ring;
+	}
+
+	//The stream to format a line into, it comes back empty
+	std::ostringstream& Begin(ELogLevel level)
+	{
+		std::ostringstream &_stream = Ring().m_Stream;
+		_stream.str(std::string());
+		_stream << Prefix(level);
+		return _stream;
+	}
+
+	void End(ELogLevel level)
+	{
+		LogRing &_ring = Ring();
+		std::string _line = _ring.m_Stream.str();
+
+		//a line bigger than the whole ring can only go straight out
+		if (!_ring.Push(_line))
+		{
+			Flush();
+			if (!_ring.Push(_line))
+			{
+				std::lock_guard<std::mutex> _lock(m_DrainLock);
+				fwrite(_line.data(), 1, _line.size(), stdout);
+				fputc('\n', stdout);
+				fflush(stdout);
+			}
+		}
+
+		if (level == LogError)
+			Flush();
+		else if (_ring.HalfFull())
+			m_Wake.notify_one();
+	}
+
+	//Writes out everything pending, on the calling thread
+	void Flush()
+	{
+		std::lock_guard<std::mutex> _lock(m_DrainLock);
+		{
+			std::lock_guard<std::mutex> _ringsLock(m_RingsLock);
+			for (size_t i = 0; i < m_Rings.size(); i++)
+				m_Rings[i]->Pop(m_Output);
+		}
+
+		if (!m_Output.empty())
+		{
+			fwrite(m_Output.data(), 1, m_Output.size(), stdout);
+			fflush(stdout);
+			m_Output.clear();
+		}
+	}
+
+	void WriterLoop()
+	{
+		std::unique_lock<std::mutex> _lock(m_WakeLock);
+		while (!m_Stop)
+		{
+			m_Wake.wait_for(_lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+			_lock.unlock();
+			Flush();
+			_lock.lock();
+		}
+	}
+
+	//The first bytes of a pixel block as hex, to peek at the data without walking all of it
+	static std::string Hex(const uint8_t *data, size_t size, size_t count = 16)
+	{
+		const char *_digits = "0123456789abcdef";
+		std::string _hex;
+		for (size_t i = 0; i < size && i < count; i++)
+		{
+			if (i > 0)
+				_hex += ' ';
+			_hex += _digits[data[i] >> 4];
+			_hex += _digits[data[i] & 15];
+		}
+		if (size > count)
+			_hex += " ...";
+		return _hex;
+	}
+};
\ No newline at end of file
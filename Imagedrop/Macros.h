@@ -1,16 +1,23 @@
 #pragma once
 
 #include "Settings.h"
+#include "Logger.h"
 
 //------------------
 //Macro Functions //
 //------------------
-//Logging
+//Logging, async through the Logger, the levels above LOG_MAX_LEVEL compile to nothing
 #if USE_LOG == 1
-#define LOG(msg) std::cout<<"Log:"<<msg<<std::endl
+#define LOG_AT(level, msg) do { if (level <= LOG_MAX_LEVEL && Logger::Enabled(level)) { Logger::Get().Begin(level) << msg; Logger::Get().End(level); } } while (0)
+#define LOG_FLUSH() Logger::Get().Flush()
 #else
-#define LOG(msg)
+#define LOG_AT(level, msg)
+#define LOG_FLUSH()
 #endif
+#define LOG(msg) LOG_AT(ELogLevel::LogInfo, msg)
+#define LOG_ERROR(msg) LOG_AT(ELogLevel::LogError, msg)
+#define LOG_WARNING(msg) LOG_AT(ELogLevel::LogWarning, msg)
+#define LOG_DEBUG(msg) LOG_AT(ELogLevel::LogDebug, msg)
 
 //Throwing Runtime Errs
 #if USE_THROW_ERRORS == 1
@@ -21,7 +28,7 @@
 
 //Main waita for a cin
 #if USE_WAIT_FOR_INPUT == 1
-#define WAIT_INPUT std::cin.get(); LOG("Done!")
+#define WAIT_INPUT LOG_FLUSH(); std::cin.get(); LOG("Done!")
 #else
 #define WAIT_INPUT LOG("Done!")
 #endif
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+A read only memory mapping of a whole file
+- The pages come straight from the OS file cache, nothing gets copied into the heap, so an uncompressed
+	image can be resampled right where it sits in the file.
+- Open() only reports, it never throws, any failure (empty file, no mapping possible, ...) just means
+	the caller goes back to the buffered fread path.
+*/
+class MappedFile
+{
+public:
+	const uint8_t *m_Data;
+	size_t m_Size;
+
+#if defined(_WIN32)
+	HANDLE m_File;
+	HANDLE m_Mapping;
+#else
+	int m_File;
+#endif
+
+	MappedFile() : m_Data(NULL), m_Size(0)
+	{
+#if defined(_WIN32)
+		m_File = INVALID_HANDLE_VALUE;
+		m_Mapping = NULL;
+#else
+		m_File = -1;
+#endif
+	}
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	//a mapping can't be shared between two owners
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen() const
+	{
+		return m_Data != NULL;
+	}
+
+	bool Open(const char *path)
+	{
+		Close();
+
+#if defined(_WIN32)
+		m_File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (m_File == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER _size;
+		if (!GetFileSizeEx(m_File, &_size) || _size.QuadPart == 0 || uint64_t(_size.QuadPart) > uint64_t(SIZE_MAX))
+		{
+			Close();
+			return false;
+		}
+		m_Size = size_t(_size.QuadPart);
+
+		m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_Mapping == NULL)
+		{
+			Close();
+			return false;
+		}
+
+		m_Data = (const uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		m_File = open(path, O_RDONLY);
+		if (m_File < 0)
+			return false;
+
+		struct stat _stat;
+		if (fstat(m_File, &_stat) != 0 || _stat.st_size <= 0)
+		{
+			Close();
+			return false;
+		}
+		m_Size = size_t(_stat.st_size);
+
+		void *_data = mmap(NULL, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+		if (_data != MAP_FAILED)
+		{
+			//the rows are read front to back, let the kernel read ahead
+			madvise(_data, m_Size, MADV_SEQUENTIAL);
+			m_Data = (const uint8_t*)_data;
+		}
+#endif
+
+		if (m_Data == NULL)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+#if defined(_WIN32)
+		if (m_Data != NULL)
+			UnmapViewOfFile(m_Data);
+		if (m_Mapping != NULL)
+			CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE)
+			CloseHandle(m_File);
+		m_Mapping = NULL;
+		m_File = INVALID_HANDLE_VALUE;
+#else
+		if (m_Data != NULL)
+			munmap((void*)m_Data, m_Size);
+		if (m_File >= 0)
+			close(m_File);
+		m_File = -1;
+#endif
+		m_Data = NULL;
+		m_Size = 0;
+	}
+};
\ No newline at end of file
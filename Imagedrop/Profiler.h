@@ -0,0 +1,354 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include "Settings.h"
+#include "Macros.h"
+
+/*
+The runtime profiler, replaces the old compile time USE_LOG_TIME blocks
+- Turned on from the command line (--profile, --profile=PATH, --trace=PATH), off it costs a single branch
+	on a plain bool per scope or counter, so it can stay compiled in & be used on production batches.
+- Scoped timers (PROFILE_SCOPE) for the stages (read, resize, write, stream, image, ...) & counters for the
+	bytes read & written, the pixels produced & the pixel allocations (fresh or reused from the pool).
+- Every thread records into its own buffer, no locks nor atomics on the way, the buffers are only merged
+	when the report gets written at the end of the run (all the work is joined by then).
+- The report is a JSON of the stages & counters, in total & per thread, plus the slowest files. The trace
+	is the Chrome trace event format (chrome://tracing, Perfetto), a bar per scope on its thread.
+*/
+
+//What gets counted, the values add up per thread
+enum EProfileCounter
+{
+	BytesRead,									//pixel data bytes, read or mapped from the files
+	BytesWritten,								//pixel data bytes, raw or RLE packets
+	PixelsProduced,								//resampled output pixels
+	Allocations,								//fresh pixel blocks
+	AllocatedBytes,
+	PoolReuses,									//pixel blocks served from the pool instead
+	ProfileCountersCount
+};
+
+//The totals of one scope name
+struct ProfileStage
+{
+	uint64_t m_Count;
+	int64_t m_Total;							//ns
+	int64_t m_Max;								//ns
+
+	ProfileStage() : m_Count(0), m_Total(0), m_Max(0) {}
+
+	void Add(int64_t duration)
+	{
+		m_Count++;
+		m_Total += duration;
+		if (duration > m_Max)
+			m_Max = duration;
+	}
+
+	void Merge(const ProfileStage &other)
+	{
+		m_Count += other.m_Count;
+		m_Total += other.m_Total;
+		if (other.m_Max > m_Max)
+			m_Max = other.m_Max;
+	}
+};
+
+//A finished scope, kept for the trace & for the slowest files
+struct ProfileEvent
+{
+	const char *m_Name;
+	std::string m_Detail;						//the file of the scopes that have one
+	int64_t m_Start;							//ns from the start of the profiler
+	int64_t m_Duration;							//ns
+};
+
+//What a single thread recorded, only that thread writes into it
+struct ProfileThread
+{
+	int m_Id;
+	std::map<std::string, ProfileStage> m_Stages;
+	std::vector<ProfileEvent> m_Events;			//every scope when tracing, just the ones with a file otherwise
+	uint64_t m_Counters[ProfileCountersCount];
+
+	ProfileThread(int id) : m_Id(id)
+	{
+		for (int i = 0; i < ProfileCountersCount; i++)
+			m_Counters[i] = 0;
+	}
+};
+
+class Profiler
+{
+public:
+	bool m_Tracing;
+	std::chrono::steady_clock::time_point m_StartTime;
+	std::mutex m_ThreadsLock;
+	std::vector<std::unique_ptr<ProfileThread>> m_Threads;
+
+	Profiler() : m_Tracing(false), m_StartTime(std::chrono::steady_clock::now()) {}
+
+	static Profiler& Get()
+	{
+		static Profiler _profiler;
+		return _profiler;
+	}
+
+	//A constant initialized static, no guard, the check is a plain load. Set once before any work starts
+	static bool& Enabled()
+	{
+		static bool _enabled = false;
+		return _enabled;
+	}
+
+	void Enable(bool tracing)
+	{
+		m_Tracing = tracing;
+		m_StartTime = std::chrono::steady_clock::now();
+		Enabled() = true;
+	}
+
+	int64_t Now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_StartTime).count();
+	}
+
+	//The buffer of the calling thread, registered on its first use. The buffers belong to the profiler, they outlive their threads
+	ProfileThread& Thread()
+	{
+		thread_local ProfileThread *_thread = NULL;
+		if (_thread == NULL)
+		{
+			std::lock_guard<std::mutex> _lock(m_ThreadsLock);
+			m_Threads.emplace_back(new ProfileThread(int(m_Threads.size())));
+			_thread = m_Threads.back().get();
+		}
+		return *_thread;
+	}
+
+	void Record(const char *name, const std::string *detail, int64_t start, int64_t end)
+	{
+		ProfileThread &_thread = Thread();
+		_thread.m_Stages[name].Add(end - start);
+
+		if (m_Tracing || detail != NULL)
+		{
+			ProfileEvent _event;
+			_event.m_Name = name;
+			if (detail != NULL)
+				_event.m_Detail = *detail;
+			_event.m_Start = start;
+			_event.m_Duration = end - start;
+			_thread.m_Events.push_back(_event);
+		}
+	}
+
+	static void Count(EProfileCounter counter, uint64_t value)
+	{
+		if (!Enabled())
+			return;
+		Get().Thread().m_Counters[counter] += value;
+	}
+
+	static const char* CounterName(int counter)
+	{
+		const char *_names[] = { "bytes_read", "bytes_written", "pixels_produced", "allocations", "allocated_bytes", "pool_reuses" };
+		return _names[counter];
+	}
+
+	//Paths have backslashes on windows
+	static std::string Escape(const std::string &text)
+	{
+		std::string _escaped;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if (text[i] == '\\' || text[i] == '"')
+				_escaped += '\\';
+			_escaped += text[i];
+		}
+		return _escaped;
+	}
+
+	//The stages & counters of every thread added up
+	void Totals(std::map<std::string, ProfileStage> &stages, uint64_t *counters)
+	{
+		for (int c = 0; c < ProfileCountersCount; c++)
+			counters[c] = 0;
+
+		for (size_t i = 0; i < m_Threads.size(); i++)
+		{
+			for (auto _stage = m_Threads[i]->m_Stages.begin(); _stage != m_Threads[i]->m_Stages.end(); ++_stage)
+				stages[_stage->first].Merge(_stage->second);
+			for (int c = 0; c < ProfileCountersCount; c++)
+				counters[c] += m_Threads[i]->m_Counters[c];
+		}
+	}
+
+	//The scopes that carry a file, longest first
+	std::vector<const ProfileEvent*> SlowestFiles(size_t count)
+	{
+		std::vector<const ProfileEvent*> _files;
+		for (size_t i = 0; i < m_Threads.size(); i++)
+		{
+			for (size_t e = 0; e < m_Threads[i]->m_Events.size(); e++)
+			{
+				if (!m_Threads[i]->m_Events[e].m_Detail.empty())
+					_files.push_back(&m_Threads[i]->m_Events[e]);
+			}
+		}
+
+		std::sort(_files.begin(), _files.end(), [](const ProfileEvent *a, const ProfileEvent *b) { return a->m_Duration > b->m_Duration; });
+		if (_files.size() > count)
+			_files.resize(count);
+		return _files;
+	}
+
+	static void WriteStagesJSON(std::ostream &stream, const std::map<std::string, ProfileStage> &stages, const char *indent)
+	{
+		stream << "{";
+		for (auto _stage = stages.begin(); _stage != stages.end(); ++_stage)
+		{
+			const ProfileStage &_totals = _stage->second;
+			stream << (_stage == stages.begin() ? "\n" : ",\n") << indent << "\t\"" << _stage->first << "\": { \"count\": " << _totals.m_Count
+				<< ", \"total_ms\": " << _totals.m_Total * 1e-6 << ", \"mean_ms\": " << _totals.m_Total * 1e-6 / double(_totals.m_Count)
+				<< ", \"max_ms\": " << _totals.m_Max * 1e-6 << " }";
+		}
+		stream << "\n" << indent << "}";
+	}
+
+	static void WriteCountersJSON(std::ostream &stream, const uint64_t *counters)
+	{
+		stream << "{ ";
+		for (int c = 0; c < ProfileCountersCount; c++)
+			stream << (c == 0 ? "" : ", ") << "\"" << CounterName(c) << "\": " << counters[c];
+		stream << " }";
+	}
+
+	void WriteReport(const std::string &path)
+	{
+		std::lock_guard<std::mutex> _lock(m_ThreadsLock);
+		std::map<std::string, ProfileStage> _stages;
+		uint64_t _counters[ProfileCountersCount];
+		Totals(_stages, _counters);
+
+		std::ofstream _file(path);
+		_file << "{\n";
+		_file << "\t\"wall_ms\": " << Now() * 1e-6 << ",\n";
+		_file << "\t\"stages\": ";
+		WriteStagesJSON(_file, _stages, "\t");
+		_file << ",\n\t\"counters\": ";
+		WriteCountersJSON(_file, _counters);
+
+		_file << ",\n\t\"threads\": [";
+		for (size_t i = 0; i < m_Threads.size(); i++)
+		{
+			_file << (i == 0 ? "\n" : ",\n") << "\t\t{ \"id\": " << m_Threads[i]->m_Id << ", \"counters\": ";
+			WriteCountersJSON(_file, m_Threads[i]->m_Counters);
+			_file << ", \"stages\": ";
+			WriteStagesJSON(_file, m_Threads[i]->m_Stages, "\t\t");
+			_file << " }";
+		}
+
+		std::vector<const ProfileEvent*> _slowest = SlowestFiles(PROFILE_SLOWEST_FILES);
+		_file << "\n\t],\n\t\"slowest\": [";
+		for (size_t i = 0; i < _slowest.size(); i++)
+		{
+			_file << (i == 0 ? "\n" : ",\n") << "\t\t{ \"file\": \"" << Escape(_slowest[i]->m_Detail) << "\", \"stage\": \"" << _slowest[i]->m_Name
+				<< "\", \"ms\": " << _slowest[i]->m_Duration * 1e-6 << " }";
+		}
+		_file << "\n\t]\n}\n";
+	}
+
+	//Complete ("X") events in microseconds, a row per thread
+	void WriteTrace(const std::string &path)
+	{
+		std::lock_guard<std::mutex> _lock(m_ThreadsLock);
+		std::ofstream _file(path);
+		_file << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+		bool _first = true;
+		for (size_t i = 0; i < m_Threads.size(); i++)
+		{
+			const ProfileThread &_thread = *m_Threads[i];
+			_file << (_first ? "" : ",\n") << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << _thread.m_Id
+				<< ", \"args\": { \"name\": \"thread " << _thread.m_Id << "\" } }";
+			_first = false;
+
+			for (size_t e = 0; e < _thread.m_Events.size(); e++)
+			{
+				const ProfileEvent &_event = _thread.m_Events[e];
+				_file << ",\n{ \"name\": \"" << _event.m_Name << "\", \"cat\": \"imagedrop\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << _thread.m_Id
+					<< ", \"ts\": " << _event.m_Start * 1e-3 << ", \"dur\": " << _event.m_Duration * 1e-3;
+				if (!_event.m_Detail.empty())
+					_file << ", \"args\": { \"file\": \"" << Escape(_event.m_Detail) << "\" }";
+				_file << " }";
+			}
+		}
+		_file << "\n] }\n";
+	}
+
+	//Like the batch summary, it is what was asked for so it goes out even with the logs turned off
+	void PrintSummary()
+	{
+		std::lock_guard<std::mutex> _lock(m_ThreadsLock);
+		std::map<std::string, ProfileStage> _stages;
+		uint64_t _counters[ProfileCountersCount];
+		Totals(_stages, _counters);
+
+		LOG_FLUSH();
+		std::cout << "=================P=R=O=F=I=L=E=================" << "\n";
+		std::cout << "Wall: " << Now() * 1e-6 << "ms, threads: " << m_Threads.size() << "\n";
+		for (auto _stage = _stages.begin(); _stage != _stages.end(); ++_stage)
+		{
+			const ProfileStage &_totals = _stage->second;
+			std::cout << _stage->first << ": " << _totals.m_Count << "x, total " << _totals.m_Total * 1e-6 << "ms, mean "
+				<< _totals.m_Total * 1e-6 / double(_totals.m_Count) << "ms, max " << _totals.m_Max * 1e-6 << "ms" << "\n";
+		}
+		for (int c = 0; c < ProfileCountersCount; c++)
+			std::cout << CounterName(c) << ": " << _counters[c] << "\n";
+
+		std::vector<const ProfileEvent*> _slowest = SlowestFiles(PROFILE_SLOWEST_FILES);
+		for (size_t i = 0; i < _slowest.size(); i++)
+			std::cout << "Slow: " << _slowest[i]->m_Duration * 1e-6 << "ms " << _slowest[i]->m_Detail << "\n";
+		std::cout << "================================================" << std::endl;
+	}
+};
+
+//Times the scope it lives in, when the profiler is on. detail (a file path) has to outlive the scope
+class ProfileScope
+{
+public:
+	const char *m_Name;
+	const std::string *m_Detail;
+	int64_t m_Start;
+
+	ProfileScope(const char *name, const std::string *detail = NULL) : m_Name(name), m_Detail(detail), m_Start(-1)
+	{
+		if (Profiler::Enabled())
+			m_Start = Profiler::Get().Now();
+	}
+
+	~ProfileScope()
+	{
+		if (m_Start >= 0)
+			Profiler::Get().Record(m_Name, m_Detail, m_Start, Profiler::Get().Now());
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(name)
+#define PROFILE_SCOPE_FILE(name, path) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(name, &(path))
+#define PROFILE_COUNT(counter, value) Profiler::Count(EProfileCounter::counter, uint64_t(value))
\ No newline at end of file
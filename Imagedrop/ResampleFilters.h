@@ -0,0 +1,255 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <cmath>
+#include "Macros.h"
+#include "ResampleKernels.h"
+
+/*
+The convolution filters of the resampler (Catmull-Rom, Mitchell, Lanczos-2/3)
+- Separable, every axis gets a table of fixed point weights, per output index the first source index &
+	a fixed count of 14bit weights (padded with zeros), normalized so they always add up to exactly one.
+- Scaling down widens the filter by the scale, so every source pixel under the output one is taken in,
+	which is what keeps the high quality filters from aliasing.
+- The taps that fall outside the image are folded onto the edge pixel, the tables never point outside.
+- A table only depends on the filter & the two sizes of its axis, a batch of same sized images keeps
+	asking for the same ones, so they live in a small LRU cache instead of being rebuilt per image.
+*/
+#define RESAMPLE_PI										3.14159265358979323846
+
+//The weights of one axis, output i reads the source [m_First[i], m_First[i] + m_Taps)
+struct FilterWeights
+{
+	int m_Taps;
+	std::vector<int32_t> m_First;
+	std::vector<int16_t> m_Weights;				//m_Taps per output index
+
+	FilterWeights() : m_Taps(0) {}
+};
+
+class ResampleFilters
+{
+public:
+	//How far from its center a filter reaches, in source pixels at scale 1
+	static double Support(EResampleFilter filter)
+	{
+		switch (filter)
+		{
+		case EResampleFilter::Lanczos3:
+			return 3.0;
+		case EResampleFilter::CatmullRom:
+		case EResampleFilter::Mitchell:
+		case EResampleFilter::Lanczos2:
+			return 2.0;
+		case EResampleFilter::Box:
+			return 0.5;
+		default:
+			return 1.0;
+		}
+	}
+
+	//Keys cubic, B = 0 & C = 0.5 is Catmull-Rom, B = C = 1/3 is Mitchell-Netravali
+	static double Cubic(double x, double b, double c)
+	{
+		x = fabs(x);
+		if (x < 1.0)
+			return ((12.0 - 9.0 * b - 6.0 * c) * x * x * x + (-18.0 + 12.0 * b + 6.0 * c) * x * x + (6.0 - 2.0 * b)) / 6.0;
+		if (x < 2.0)
+			return ((-b - 6.0 * c) * x * x * x + (6.0 * b + 30.0 * c) * x * x + (-12.0 * b - 48.0 * c) * x + (8.0 * b + 24.0 * c)) / 6.0;
+		return 0.0;
+	}
+
+	static double Sinc(double x)
+	{
+		if (x == 0.0)
+			return 1.0;
+		x *= RESAMPLE_PI;
+		return sin(x) / x;
+	}
+
+	static double Lanczos(double x, double lobes)
+	{
+		return fabs(x) < lobes ? Sinc(x) * Sinc(x / lobes) : 0.0;
+	}
+
+	static double Evaluate(EResampleFilter filter, double x)
+	{
+		switch (filter)
+		{
+		case EResampleFilter::CatmullRom:
+			return Cubic(x, 0.0, 0.5);
+		case EResampleFilter::Mitchell:
+			return Cubic(x, 1.0 / 3.0, 1.0 / 3.0);
+		case EResampleFilter::Lanczos2:
+			return Lanczos(x, 2.0);
+		case EResampleFilter::Lanczos3:
+			return Lanczos(x, 3.0);
+		case EResampleFilter::Box:
+			return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+		default:
+			//the triangle, nothing builds tables of it, bilinear & the box have kernels of their own
+			return fabs(x) < 1.0 ? 1.0 - fabs(x) : 0.0;
+		}
+	}
+
+	//Bilinear & the box have their own kernels, the rest go through the convolution
+	static bool IsConvolution(EResampleFilter filter)
+	{
+		return filter == EResampleFilter::CatmullRom || filter == EResampleFilter::Mitchell ||
+			filter == EResampleFilter::Lanczos2 || filter == EResampleFilter::Lanczos3;
+	}
+
+	static bool Parse(const std::string &name, EResampleFilter &filter)
+	{
+		if (name == "nearest")
+			filter = EResampleFilter::Nearest;
+		else if (name == "bilinear")
+			filter = EResampleFilter::Bilinear;
+		else if (name == "box")
+			filter = EResampleFilter::Box;
+		else if (name == "bicubic" || name == "catmull-rom")
+			filter = EResampleFilter::CatmullRom;
+		else if (name == "mitchell")
+			filter = EResampleFilter::Mitchell;
+		else if (name == "lanczos2")
+			filter = EResampleFilter::Lanczos2;
+		else if (name == "lanczos3" || name == "lanczos")
+			filter = EResampleFilter::Lanczos3;
+		else
+			return false;
+		return true;
+	}
+
+	//The other way around, for the reports
+	static const char* Name(EResampleFilter filter)
+	{
+		const char *_names[] = { "nearest", "bilinear", "box", "bicubic", "mitchell", "lanczos2", "lanczos3" };
+		return _names[filter];
+	}
+
+	static void Build(FilterWeights &weights, EResampleFilter filter, int srcSize, int dstSize)
+	{
+		const double _scale = double(dstSize) / double(srcSize);
+		const double _filterScale = _scale < 1.0 ? 1.0 / _scale : 1.0;
+		const double _support = Support(filter) * _filterScale;
+
+		//the widest window any output has, the zero weights past it would only cost madds
+		weights.m_Taps = 1;
+		for (int i = 0; i < dstSize; i++)
+		{
+			double _center = (i + 0.5) / _scale - 0.5;
+			int _span = int(ceil(_center + _support)) - int(floor(_center - _support)) - 1;
+			if (_span > weights.m_Taps)
+				weights.m_Taps = _span;
+		}
+		if (weights.m_Taps > srcSize)
+			weights.m_Taps = srcSize;
+		weights.m_First.resize(dstSize);
+		weights.m_Weights.assign(size_t(dstSize) * weights.m_Taps, 0);
+
+		std::vector<double> _values(weights.m_Taps);
+		for (int i = 0; i < dstSize; i++)
+		{
+			//pixel centers on both sides line up
+			double _center = (i + 0.5) / _scale - 0.5;
+			int _left = int(floor(_center - _support)) + 1;
+			int _right = int(ceil(_center + _support)) - 1;
+
+			//the window slides back in when it hangs over an edge, the taps outside fold onto the edge pixel
+			int _first = _left;
+			CLAMP(_first, 0, srcSize - weights.m_Taps);
+			weights.m_First[i] = _first;
+
+			double _total = 0.0;
+			std::fill(_values.begin(), _values.end(), 0.0);
+			for (int j = _left; j <= _right; j++)
+			{
+				double _value = Evaluate(filter, (j - _center) / _filterScale);
+				int _index = j;
+				CLAMP(_index, 0, srcSize - 1);
+				int _tap = _index - _first;
+				CLAMP(_tap, 0, weights.m_Taps - 1);
+				_values[_tap] += _value;
+				_total += _value;
+			}
+
+			//normalized, then whatever the rounding lost goes to the biggest weight so the sum is exactly one
+			int16_t *_weights = weights.m_Weights.data() + size_t(i) * weights.m_Taps;
+			int _sum = 0;
+			int _biggest = 0;
+			for (int t = 0; t < weights.m_Taps; t++)
+			{
+				double _normalized = _total != 0.0 ? _values[t] / _total : 0.0;
+				_weights[t] = int16_t(floor(_normalized * RESAMPLE_WEIGHT_ONE + 0.5));
+				_sum += _weights[t];
+				if (_weights[t] > _weights[_biggest])
+					_biggest = t;
+			}
+			_weights[_biggest] = int16_t(_weights[_biggest] + RESAMPLE_WEIGHT_ONE - _sum);
+		}
+	}
+};
+
+/*
+The weight tables last asked for, by (filter, source size, destination size).
+Shared by every resampler & thread, a table is never changed once built, so handing out shared pointers is enough.
+*/
+class FilterWeightsCache
+{
+public:
+	typedef std::tuple<int, int, int> Key;
+	typedef std::pair<Key, std::shared_ptr<const FilterWeights>> Entry;
+
+	std::mutex m_Lock;
+	std::list<Entry> m_Entries;					//the most recently used at the front
+	std::map<Key, std::list<Entry>::iterator> m_Index;
+	size_t m_MaxEntries;
+
+	FilterWeightsCache(size_t maxEntries) : m_MaxEntries(maxEntries) {}
+
+	static FilterWeightsCache& Get()
+	{
+		static FilterWeightsCache _cache(FILTER_WEIGHTS_CACHE_SIZE);
+		return _cache;
+	}
+
+	std::shared_ptr<const FilterWeights> Acquire(EResampleFilter filter, int srcSize, int dstSize)
+	{
+		Key _key(int(filter), srcSize, dstSize);
+
+		{
+			std::lock_guard<std::mutex> _lock(m_Lock);
+			auto _found = m_Index.find(_key);
+			if (_found != m_Index.end())
+			{
+				m_Entries.splice(m_Entries.begin(), m_Entries, _found->second);
+				return _found->second->second;
+			}
+		}
+
+		//built outside the lock, two threads missing the same table at once just build it twice
+		std::shared_ptr<FilterWeights> _weights = std::make_shared<FilterWeights>();
+		ResampleFilters::Build(*_weights, filter, srcSize, dstSize);
+
+		std::lock_guard<std::mutex> _lock(m_Lock);
+		if (m_Index.find(_key) == m_Index.end())
+		{
+			m_Entries.push_front(Entry(_key, _weights));
+			m_Index[_key] = m_Entries.begin();
+
+			while (m_Entries.size() > m_MaxEntries)
+			{
+				m_Index.erase(m_Entries.back().first);
+				m_Entries.pop_back();
+			}
+		}
+		return _weights;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,1699 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "CpuFeatures.h"
+#include "ImageBuffer.h"
+#include "LinearLight.h"
+
+#if IMAGEDROP_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif // IMAGEDROP_X86
+
+/*
+The fixed point (integer) bilinear kernels of the resampler
+- Weights are 14bit fixed point [0, 16384], so a pair of them fits one madd (int16 x int16 -> int32)
+- The horizontal pass outputs int16 rows with 7 fractional bits [0, 255 << 7], which keeps enough
+	precision for the vertical pass & still fits the signed 16bit lanes
+- The vertical pass outputs the final 8bit value, truncated the same way the float path does
+- Scalar, SSE2 & AVX2 variants give the exact same bytes, so the SIMD ones can be checked against
+	the scalar ones, and the scalar ones against the float reference path (within 1 LSB)
+- The horizontal kernels are templates on the pixel format, the channels loop is unrolled at compile time &
+	the 8bit, 24bit & 32bit paths have no branches left in them. The set of kernels is picked once per image.
+- The box (area average) kernels of the integer downscales (1/2, 1/4, 1/8) are exact integer math too, the
+	k source rows get summed into uint16 lanes (64 * 255 still fits), then every k x k block is rounded
+	& shifted down to its 8bit average. Halving, the most common one, has its own kernel that does the 2x2
+	sums & the average of two source rows in a single go.
+- The convolution kernels (Catmull-Rom, Mitchell, Lanczos) have negative lobes, a row can go below 0 & above
+	255, so their int16 rows keep only 6 fractional bits (1.25 * 255 << 6 still fits). Their vertical pass
+	takes the taps two rows at a time through madd & the final packs clamp the overshoot into [0, 255].
+- The decoded convolution (linear light, premultiplied alpha) decodes every source row once into 12bit int16
+	pixels, convolves those with the same weights into rows that keep 2 more fractional bits (1.25 * 4095 << 2
+	still fits), and the vertical pass encodes its clamped 12bit result back to 8bit. Same madd kernels, just
+	a decode on the way in & an encode on the way out.
+	- Linear light decodes through the sRGB table & encodes through the 4096 entries one.
+	- Premultiplied alpha (32bit) weights the colors by their alpha right after the decode, in SIMD, and the
+		vertical pass divides them back through a table of reciprocals, in SIMD too, before the encode.
+		So a transparent pixel has no say in the color of its neighbours & the edges get no dark fringes.
+- Bilinear & the box decode the same way but keep their own passes. The bilinear rows keep 3 fractional bits (no
+	overshoot, 4095 << 3 still fits) & the vertical lerp encodes. The box sums the decoded rows into uint32 lanes
+	(64 * 4095 doesn't fit 16bit anymore), then every block is rounded, divided back if premultiplied & encoded.
+	32bit halving decodes, adds & encodes its 2x2 blocks in registers, like the plain one does.
+	Decoding is a table lookup (an AVX2 gather) per source byte & encoding one per output byte, that's the floor of
+	the linear light cost. The premultiplied mode decodes with shifts & multiplies instead, its floor is the
+	reciprocal fetched & multiplied in per output pixel.
+*/
+#define RESAMPLE_WEIGHT_BITS							14
+#define RESAMPLE_WEIGHT_ONE								(1 << RESAMPLE_WEIGHT_BITS)
+#define RESAMPLE_ROW_BITS								7
+#define RESAMPLE_ROW_ROUND								(1 << (RESAMPLE_ROW_BITS - 1))
+#define RESAMPLE_OUT_SHIFT								(RESAMPLE_WEIGHT_BITS + RESAMPLE_ROW_BITS)
+#define RESAMPLE_CONVOLUTION_ROW_BITS					6
+#define RESAMPLE_CONVOLUTION_OUT_SHIFT					(RESAMPLE_WEIGHT_BITS + RESAMPLE_CONVOLUTION_ROW_BITS)
+#define RESAMPLE_DECODED_ROW_BITS						2
+#define RESAMPLE_DECODED_OUT_SHIFT						(RESAMPLE_WEIGHT_BITS + RESAMPLE_DECODED_ROW_BITS)
+#define RESAMPLE_DECODED_BILINEAR_ROW_BITS				3
+#define RESAMPLE_DECODED_BILINEAR_SHIFT					(RESAMPLE_WEIGHT_BITS - RESAMPLE_DECODED_BILINEAR_ROW_BITS)
+#define RESAMPLE_DECODED_BILINEAR_OUT_SHIFT				(RESAMPLE_WEIGHT_BITS + RESAMPLE_DECODED_BILINEAR_ROW_BITS)
+
+//The filters the resampler knows, every one of them gets its own compiled tile loop
+enum EResampleFilter
+{
+	Nearest,
+	Bilinear,
+	Box,										//area average, integer downscale factors only
+	CatmullRom,									//bicubic, B = 0 & C = 0.5
+	Mitchell,									//bicubic, B = C = 1/3
+	Lanczos2,
+	Lanczos3
+};
+
+enum EResampleKernel
+{
+	Reference,									//the float path, matches the old per-pixel bilinear math
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+//A horizontal tap with the byte offsets of the two source pixels & the two packed int16 weights [low (1 - w), high w]
+struct FixedTap
+{
+	int32_t m_Offset0;
+	int32_t m_Offset1;
+	int32_t m_Weights;
+};
+
+//Packs a [0, 1] weight into the int16 pair that madd expects
+inline int32_t PackFixedWeights(float weight)
+{
+	int32_t _weight = int32_t(weight * RESAMPLE_WEIGHT_ONE + 0.5f);
+	if (_weight > RESAMPLE_WEIGHT_ONE)
+		_weight = RESAMPLE_WEIGHT_ONE;
+
+	return (_weight << 16) | (RESAMPLE_WEIGHT_ONE - _weight);
+}
+
+inline int32_t Load32(const uint8_t *ptr)
+{
+	int32_t _value;
+	memcpy(&_value, ptr, 4);
+	return _value;
+}
+
+typedef void(*HorizontalKernel)(const uint8_t *row, const FixedTap *taps, int count, int16_t *out);
+typedef void(*VerticalKernel)(const int16_t *top, const int16_t *bottom, int32_t weights, size_t length, uint8_t *out);
+typedef void(*BoxAccumulateKernel)(const uint8_t *row, size_t length, uint16_t *sums);
+typedef void(*BoxReduceKernel)(const uint16_t *sums, int count, int factor, int shift, uint8_t *out);
+typedef void(*BoxHalveKernel)(const uint8_t *top, const uint8_t *bottom, int count, uint8_t *out);
+typedef void(*ConvolveHorizontalKernel)(const uint8_t *row, const int32_t *first, const int16_t *weights, int taps, int count, int16_t *out);
+typedef void(*ConvolveVerticalKernel)(const int16_t *const *rows, const int16_t *weights, int taps, size_t length, uint8_t *out);
+typedef void(*DecodeKernel)(const uint8_t *row, int count, int16_t *out);
+typedef void(*PremultiplyKernel)(int16_t *row, int count);
+typedef void(*ConvolveDecodedHorizontalKernel)(const int16_t *row, int origin, const int32_t *first, const int16_t *weights, int taps, int count, int16_t *out);
+typedef void(*DecodedHorizontalKernel)(const int16_t *row, int origin, const FixedTap *taps, int count, int16_t *out);
+typedef void(*DecodedBoxAccumulateKernel)(const int16_t *row, size_t length, uint32_t *sums);
+typedef void(*DecodedBoxReduceKernel)(const uint32_t *sums, int count, int factor, int shift, uint8_t *out);
+
+//------------------
+//Scalar kernels //
+//------------------
+//The generic one, channels known at runtime only. Not used by the resampler anymore, it is the baseline of the kernels benchmark
+inline void HorizontalGeneric(const uint8_t *row, const FixedTap *taps, int count, int channels, int16_t *out)
+{
+	for (int x = 0; x < count; x++, taps++)
+	{
+		const uint8_t *_left = row + taps->m_Offset0;
+		const uint8_t *_right = row + taps->m_Offset1;
+		const int32_t _weight0 = taps->m_Weights & 0xFFFF;
+		const int32_t _weight1 = taps->m_Weights >> 16;
+
+		for (int i = 0; i < channels; i++)
+		{
+			out[i] = int16_t((_left[i] * _weight0 + _right[i] * _weight1 + RESAMPLE_ROW_ROUND) >> RESAMPLE_ROW_BITS);
+		}
+		out += channels;
+	}
+}
+
+template<EPixelFormat Format>
+inline void HorizontalScalar(const uint8_t *row, const FixedTap *taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+
+	for (int x = 0; x < count; x++, taps++)
+	{
+		const uint8_t *_left = row + taps->m_Offset0;
+		const uint8_t *_right = row + taps->m_Offset1;
+		const int32_t _weight0 = taps->m_Weights & 0xFFFF;
+		const int32_t _weight1 = taps->m_Weights >> 16;
+
+		for (int i = 0; i < _channels; i++)
+		{
+			out[i] = int16_t((_left[i] * _weight0 + _right[i] * _weight1 + RESAMPLE_ROW_ROUND) >> RESAMPLE_ROW_BITS);
+		}
+		out += _channels;
+	}
+}
+
+inline void VerticalScalar(const int16_t *top, const int16_t *bottom, int32_t weights, size_t length, uint8_t *out)
+{
+	const int32_t _weight0 = weights & 0xFFFF;
+	const int32_t _weight1 = weights >> 16;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		out[i] = uint8_t((top[i] * _weight0 + bottom[i] * _weight1) >> RESAMPLE_OUT_SHIFT);
+	}
+}
+
+//Adds a source row to the box sums, byte by byte
+inline void BoxAccumulateScalar(const uint8_t *row, size_t length, uint16_t *sums)
+{
+	for (size_t i = 0; i < length; i++)
+		sums[i] = uint16_t(sums[i] + row[i]);
+}
+
+//The average of every factor x factor block, sums holds the factor rows already added up, shift is log2(factor * factor)
+template<EPixelFormat Format>
+inline void BoxReduceScalar(const uint16_t *sums, int count, int factor, int shift, uint8_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const uint32_t _round = 1u << (shift - 1);
+
+	for (int x = 0; x < count; x++, out += _channels)
+	{
+		uint32_t _total[_channels] = {};
+		for (int i = 0; i < factor; i++, sums += _channels)
+		{
+			for (int c = 0; c < _channels; c++)
+				_total[c] += sums[c];
+		}
+
+		for (int c = 0; c < _channels; c++)
+			out[c] = uint8_t((_total[c] + _round) >> shift);
+	}
+}
+
+//The 2x2 average of two source rows, count output pixels
+template<EPixelFormat Format>
+inline void BoxHalveScalar(const uint8_t *top, const uint8_t *bottom, int count, uint8_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+
+	for (int x = 0; x < count; x++, top += _channels * 2, bottom += _channels * 2, out += _channels)
+	{
+		for (int c = 0; c < _channels; c++)
+			out[c] = uint8_t((top[c] + top[c + _channels] + bottom[c] + bottom[c + _channels] + 2) >> 2);
+	}
+}
+
+//The horizontal convolution, output x reads taps pixels from first[x] on
+template<EPixelFormat Format>
+inline void ConvolveHorizontalScalar(const uint8_t *row, const int32_t *first, const int16_t *weights, int taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const int32_t _round = 1 << (RESAMPLE_WEIGHT_BITS - RESAMPLE_CONVOLUTION_ROW_BITS - 1);
+
+	for (int x = 0; x < count; x++, weights += taps, out += _channels)
+	{
+		const uint8_t *_pixel = row + first[x] * _channels;
+
+		int32_t _total[_channels] = {};
+		for (int t = 0; t < taps; t++, _pixel += _channels)
+		{
+			for (int c = 0; c < _channels; c++)
+				_total[c] += _pixel[c] * weights[t];
+		}
+
+		for (int c = 0; c < _channels; c++)
+			out[c] = int16_t((_total[c] + _round) >> (RESAMPLE_WEIGHT_BITS - RESAMPLE_CONVOLUTION_ROW_BITS));
+	}
+}
+
+//The vertical convolution of the lanes [begin, end), the tail of the SIMD ones too
+inline void ConvolveVerticalRange(const int16_t *const *rows, const int16_t *weights, int taps, size_t begin, size_t end, uint8_t *out)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		int32_t _total = 1 << (RESAMPLE_CONVOLUTION_OUT_SHIFT - 1);
+		for (int t = 0; t < taps; t++)
+			_total += rows[t][i] * weights[t];
+
+		_total >>= RESAMPLE_CONVOLUTION_OUT_SHIFT;
+		CLAMP(_total, 0, 255);
+		out[i] = uint8_t(_total);
+	}
+}
+
+inline void ConvolveVerticalScalar(const int16_t *const *rows, const int16_t *weights, int taps, size_t length, uint8_t *out)
+{
+	ConvolveVerticalRange(rows, weights, taps, 0, length, out);
+}
+
+//The linear light values of count source pixels, alpha goes through its own straight table
+//the channels are spelled out, the loop over them with the alpha test inside measured a third slower on 32bit
+template<EPixelFormat Format>
+inline void LinearDecodeScalar(const uint8_t *row, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const int16_t *_toLinear = LinearLight::Get().m_ToLinear;
+	const int16_t *_expand = LinearLight::Get().m_Expand;
+
+	if (_channels == 1)
+	{
+		for (int x = 0; x < count; x++)
+			out[x] = _toLinear[row[x]];
+		return;
+	}
+
+	for (int x = 0; x < count; x++, row += _channels, out += _channels)
+	{
+		const uint8_t _blue = row[0];
+		const uint8_t _green = row[1];
+		const uint8_t _red = row[2];
+		out[0] = _toLinear[_blue];
+		out[1] = _toLinear[_green];
+		out[2] = _toLinear[_red];
+		if (_channels == 4)
+			out[3] = _expand[row[3]];
+	}
+}
+
+//A 12bit color weighted by a 12bit alpha, the alpha widened to 16bit so the product keeps 4 bits to round with
+inline int16_t PremultiplyValue(int32_t color, int32_t alpha)
+{
+	uint32_t _alpha = uint32_t((alpha << 4) | (alpha >> 8));
+	return int16_t((((uint32_t(color) << 4) * _alpha >> 16) + 8) >> 4);
+}
+
+//Premultiplies count decoded 32bit pixels in place
+template<EPixelFormat Format>
+inline void PremultiplyScalar(int16_t *row, int count)
+{
+	const int _alpha = PixelTraits<Format>::AlphaIndex;
+
+	for (int x = 0; x < count; x++, row += 4)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			if (c != _alpha)
+				row[c] = PremultiplyValue(row[c], row[_alpha]);
+		}
+	}
+}
+
+//The straight (no sRGB curve) 12bit values of count 32bit pixels, premultiplied
+template<EPixelFormat Format>
+inline void PremultiplyDecodeScalar(const uint8_t *row, int count, int16_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+
+	for (int x = 0; x < count * 4; x++)
+		out[x] = _tables.m_Expand[row[x]];
+	PremultiplyScalar<Format>(out, count);
+}
+
+//Linear light & premultiplied, the table decode first, then the premultiply over the same (still cached) row
+template<DecodeKernel Decode, PremultiplyKernel Premultiply>
+inline void DecodePremultiplied(const uint8_t *row, int count, int16_t *out)
+{
+	Decode(row, count, out);
+	Premultiply(out, count);
+}
+
+//The horizontal convolution of a decoded row, row holds the source pixels from origin on
+template<EPixelFormat Format>
+inline void ConvolveDecodedHorizontalScalar(const int16_t *row, int origin, const int32_t *first, const int16_t *weights, int taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const int _shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_DECODED_ROW_BITS;
+
+	for (int x = 0; x < count; x++, weights += taps, out += _channels)
+	{
+		const int16_t *_pixel = row + (first[x] - origin) * _channels;
+
+		int32_t _total[_channels] = {};
+		for (int t = 0; t < taps; t++, _pixel += _channels)
+		{
+			for (int c = 0; c < _channels; c++)
+				_total[c] += _pixel[c] * weights[t];
+		}
+
+		for (int c = 0; c < _channels; c++)
+			out[c] = int16_t((_total[c] + (1 << (_shift - 1))) >> _shift);
+	}
+}
+
+//A clamped 12bit value back to 8bit, lane is the index in the row so the alpha of 32bit is told apart
+template<EPixelFormat Format, bool Linear>
+inline uint8_t EncodeDecoded(const LinearLight &tables, int32_t value, size_t lane)
+{
+	if (!Linear || (PixelTraits<Format>::HasAlpha && (lane & 3) == PixelTraits<Format>::AlphaIndex))
+		return tables.m_Narrow[value];
+	return tables.m_ToSRGB[value];
+}
+
+//The vertical convolution of a single lane, clamped to 12bit
+inline int32_t DecodedVerticalLane(const int16_t *const *rows, const int16_t *weights, int taps, size_t lane)
+{
+	int32_t _total = 1 << (RESAMPLE_DECODED_OUT_SHIFT - 1);
+	for (int t = 0; t < taps; t++)
+		_total += rows[t][lane] * weights[t];
+
+	_total >>= RESAMPLE_DECODED_OUT_SHIFT;
+	CLAMP(_total, 0, LINEAR_LIGHT_MAX);
+	return _total;
+}
+
+//A premultiplied color back to straight, it can't be more than its alpha (the overshoot of the negative lobes would blow up)
+inline int32_t UnpremultiplyValue(const LinearLight &tables, int32_t color, int32_t alpha)
+{
+	if (color > alpha)
+		color = alpha;
+	return int32_t(float(color) * tables.m_Unpremultiply[alpha] + 0.5f);
+}
+
+//The lanes [begin, end), premultiplied ones go a pixel at a time (begin is always on a pixel then), the alpha comes first
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+inline void ConvolveDecodedVerticalRange(const int16_t *const *rows, const int16_t *weights, int taps, size_t begin, size_t end, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+
+	if (Premultiplied)
+	{
+		const int _alphaIndex = PixelTraits<Format>::AlphaIndex;
+		for (size_t i = begin; i < end; i += 4)
+		{
+			int32_t _alpha = DecodedVerticalLane(rows, weights, taps, i + _alphaIndex);
+			for (int c = 0; c < 4; c++)
+			{
+				if (c != _alphaIndex)
+					out[i + c] = EncodeDecoded<Format, Linear>(_tables, UnpremultiplyValue(_tables, DecodedVerticalLane(rows, weights, taps, i + c), _alpha), c);
+			}
+			out[i + _alphaIndex] = _tables.m_Narrow[_alpha];
+		}
+		return;
+	}
+
+	for (size_t i = begin; i < end; i++)
+		out[i] = EncodeDecoded<Format, Linear>(_tables, DecodedVerticalLane(rows, weights, taps, i), i);
+}
+
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+inline void ConvolveDecodedVerticalScalar(const int16_t *const *rows, const int16_t *weights, int taps, size_t length, uint8_t *out)
+{
+	ConvolveDecodedVerticalRange<Format, Linear, Premultiplied>(rows, weights, taps, 0, length, out);
+}
+
+//A whole decoded pixel back to 8bit, premultiplied colors are divided by their alpha first
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+inline void EncodeDecodedPixel(const LinearLight &tables, const int32_t *values, uint8_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const int _alphaIndex = PixelTraits<Format>::AlphaIndex;
+
+	for (int c = 0; c < _channels; c++)
+	{
+		if (Premultiplied && c != _alphaIndex)
+			out[c] = EncodeDecoded<Format, Linear>(tables, UnpremultiplyValue(tables, values[c], values[_alphaIndex]), c);
+		else
+			out[c] = EncodeDecoded<Format, Linear>(tables, values[c], c);
+	}
+}
+
+//The decoded bilinear horizontal pass, row holds the decoded source from the int16 lane origin on, the byte offsets of the taps index it as they are
+template<EPixelFormat Format>
+inline void DecodedHorizontalScalar(const int16_t *row, int origin, const FixedTap *taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const int32_t _round = 1 << (RESAMPLE_DECODED_BILINEAR_SHIFT - 1);
+
+	for (int x = 0; x < count; x++, taps++, out += _channels)
+	{
+		const int16_t *_left = row + taps->m_Offset0 - origin;
+		const int16_t *_right = row + taps->m_Offset1 - origin;
+		const int32_t _weight0 = taps->m_Weights & 0xFFFF;
+		const int32_t _weight1 = taps->m_Weights >> 16;
+
+		for (int c = 0; c < _channels; c++)
+			out[c] = int16_t((_left[c] * _weight0 + _right[c] * _weight1 + _round) >> RESAMPLE_DECODED_BILINEAR_SHIFT);
+	}
+}
+
+//The decoded bilinear vertical lerp of the lanes [begin, end), premultiplied ones go a pixel at a time (begin is always on a pixel then)
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+inline void DecodedVerticalRange(const int16_t *top, const int16_t *bottom, int32_t weights, size_t begin, size_t end, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const int32_t _weight0 = weights & 0xFFFF;
+	const int32_t _weight1 = weights >> 16;
+	const int32_t _round = 1 << (RESAMPLE_DECODED_BILINEAR_OUT_SHIFT - 1);
+
+	if (Premultiplied)
+	{
+		for (size_t i = begin; i < end; i += 4)
+		{
+			int32_t _values[4];
+			for (int c = 0; c < 4; c++)
+				_values[c] = (top[i + c] * _weight0 + bottom[i + c] * _weight1 + _round) >> RESAMPLE_DECODED_BILINEAR_OUT_SHIFT;
+			EncodeDecodedPixel<Format, Linear, true>(_tables, _values, out + i);
+		}
+		return;
+	}
+
+	for (size_t i = begin; i < end; i++)
+		out[i] = EncodeDecoded<Format, Linear>(_tables, (top[i] * _weight0 + bottom[i] * _weight1 + _round) >> RESAMPLE_DECODED_BILINEAR_OUT_SHIFT, i);
+}
+
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+inline void DecodedVerticalScalar(const int16_t *top, const int16_t *bottom, int32_t weights, size_t length, uint8_t *out)
+{
+	DecodedVerticalRange<Format, Linear, Premultiplied>(top, bottom, weights, 0, length, out);
+}
+
+//Adds a decoded source row to the box sums
+inline void DecodedBoxAccumulateScalar(const int16_t *row, size_t length, uint32_t *sums)
+{
+	for (size_t i = 0; i < length; i++)
+		sums[i] += uint16_t(row[i]);
+}
+
+//Same as BoxReduceScalar on the decoded sums, the 12bit averages encoded back
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+inline void DecodedBoxReduceScalar(const uint32_t *sums, int count, int factor, int shift, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const int _channels = PixelTraits<Format>::Channels;
+	const uint32_t _round = 1u << (shift - 1);
+
+	for (int x = 0; x < count; x++, out += _channels)
+	{
+		uint32_t _total[_channels] = {};
+		for (int i = 0; i < factor; i++, sums += _channels)
+		{
+			for (int c = 0; c < _channels; c++)
+				_total[c] += sums[c];
+		}
+
+		int32_t _values[4] = {};	//a whole BGRA pixel whatever the format, EncodeDecodedPixel reads the alpha of the premultiplied ones
+		for (int c = 0; c < _channels; c++)
+			_values[c] = int32_t((_total[c] + _round) >> shift);
+		EncodeDecodedPixel<Format, Linear, Premultiplied>(_tables, _values, out);
+	}
+}
+
+//The decoded 2x2 box straight from the two source rows like BoxHalveScalar, no decoded rows & no sums in between
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+inline void DecodedHalveScalar(const uint8_t *top, const uint8_t *bottom, int count, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const int _channels = PixelTraits<Format>::Channels;
+
+	for (int x = 0; x < count; x++, top += _channels * 2, bottom += _channels * 2, out += _channels)
+	{
+		int16_t _top[8];
+		int16_t _bottom[8];
+		if (Linear)
+		{
+			LinearDecodeScalar<Format>(top, 2, _top);
+			LinearDecodeScalar<Format>(bottom, 2, _bottom);
+			if (Premultiplied)
+			{
+				PremultiplyScalar<Format>(_top, 2);
+				PremultiplyScalar<Format>(_bottom, 2);
+			}
+		}
+		else
+		{
+			PremultiplyDecodeScalar<Format>(top, 2, _top);
+			PremultiplyDecodeScalar<Format>(bottom, 2, _bottom);
+		}
+
+		int32_t _values[4] = {};
+		for (int c = 0; c < _channels; c++)
+			_values[c] = (_top[c] + _top[c + _channels] + _bottom[c] + _bottom[c + _channels] + 2) >> 2;
+		EncodeDecodedPixel<Format, Linear, Premultiplied>(_tables, _values, out);
+	}
+}
+
+#if IMAGEDROP_X86
+//------------------
+//SSE2 kernels //
+//------------------
+//Interleaves the two source pixels of a tap [c0 c1] per channel & widens them to int16
+TARGET_SSE2 inline __m128i LoadTapSSE2(const uint8_t *row, const FixedTap &tap, __m128i zero)
+{
+	__m128i _left = _mm_cvtsi32_si128(Load32(row + tap.m_Offset0));
+	__m128i _right = _mm_cvtsi32_si128(Load32(row + tap.m_Offset1));
+	return _mm_unpacklo_epi8(_mm_unpacklo_epi8(_left, _right), zero);
+}
+
+TARGET_SSE2 inline __m128i ResolveTapSSE2(const uint8_t *row, const FixedTap &tap, __m128i zero, __m128i round)
+{
+	__m128i _sum = _mm_madd_epi16(LoadTapSSE2(row, tap, zero), _mm_set1_epi32(tap.m_Weights));
+	return _mm_srai_epi32(_mm_add_epi32(_sum, round), RESAMPLE_ROW_BITS);
+}
+
+/*
+Every tap loads 4 bytes per pixel, for 24bit that is one byte of the next pixel, which gets computed & thrown away.
+The 3 channels stores are 4 lanes wide too, so the row buffer needs a few int16 of slack at its end, and the
+caller must keep the last source pixel of the row out of this kernel (the 4th byte would be past the row end).
+*/
+template<EPixelFormat Format>
+TARGET_SSE2 inline void HorizontalSSE2(const uint8_t *row, const FixedTap *taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const __m128i _zero = _mm_setzero_si128();
+	const __m128i _round = _mm_set1_epi32(RESAMPLE_ROW_ROUND);
+
+	int x = 0;
+	if (_channels == 4)
+	{
+		for (; x + 2 <= count; x += 2, taps += 2, out += 8)
+		{
+			__m128i _a = ResolveTapSSE2(row, taps[0], _zero, _round);
+			__m128i _b = ResolveTapSSE2(row, taps[1], _zero, _round);
+			_mm_storeu_si128((__m128i*)out, _mm_packs_epi32(_a, _b));
+		}
+	}
+	else
+	{
+		for (; x + 2 <= count; x += 2, taps += 2, out += 6)
+		{
+			__m128i _a = ResolveTapSSE2(row, taps[0], _zero, _round);
+			__m128i _b = ResolveTapSSE2(row, taps[1], _zero, _round);
+			__m128i _packed = _mm_packs_epi32(_a, _b);
+			_mm_storel_epi64((__m128i*)out, _packed);
+			_mm_storel_epi64((__m128i*)(out + 3), _mm_srli_si128(_packed, 8));
+		}
+	}
+
+	HorizontalScalar<Format>(row, taps, count - x, out);
+}
+
+TARGET_SSE2 inline __m128i VerticalLanesSSE2(__m128i top, __m128i bottom, __m128i weights)
+{
+	__m128i _low = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(top, bottom), weights), RESAMPLE_OUT_SHIFT);
+	__m128i _high = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(top, bottom), weights), RESAMPLE_OUT_SHIFT);
+	return _mm_packs_epi32(_low, _high);
+}
+
+TARGET_SSE2 inline void VerticalSSE2(const int16_t *top, const int16_t *bottom, int32_t weights, size_t length, uint8_t *out)
+{
+	const __m128i _weights = _mm_set1_epi32(weights);
+
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i _a = VerticalLanesSSE2(_mm_loadu_si128((const __m128i*)(top + i)), _mm_loadu_si128((const __m128i*)(bottom + i)), _weights);
+		__m128i _b = VerticalLanesSSE2(_mm_loadu_si128((const __m128i*)(top + i + 8)), _mm_loadu_si128((const __m128i*)(bottom + i + 8)), _weights);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_a, _b));
+	}
+
+	VerticalScalar(top + i, bottom + i, weights, length - i, out + i);
+}
+
+TARGET_SSE2 inline void BoxAccumulateSSE2(const uint8_t *row, size_t length, uint16_t *sums)
+{
+	const __m128i _zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i _bytes = _mm_loadu_si128((const __m128i*)(row + i));
+		__m128i _low = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(sums + i)), _mm_unpacklo_epi8(_bytes, _zero));
+		__m128i _high = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(sums + i + 8)), _mm_unpackhi_epi8(_bytes, _zero));
+		_mm_storeu_si128((__m128i*)(sums + i), _low);
+		_mm_storeu_si128((__m128i*)(sums + i + 8), _high);
+	}
+
+	BoxAccumulateScalar(row + i, length - i, sums + i);
+}
+
+//32bit, the 2 pixels of a pair are the two halves of a register once widened to int16
+TARGET_SSE2 inline __m128i BoxHalvePairsSSE2(const uint8_t *top, const uint8_t *bottom, __m128i zero, __m128i round)
+{
+	__m128i _top = _mm_loadu_si128((const __m128i*)top);
+	__m128i _bottom = _mm_loadu_si128((const __m128i*)bottom);
+	__m128i _low = _mm_add_epi16(_mm_unpacklo_epi8(_top, zero), _mm_unpacklo_epi8(_bottom, zero));
+	__m128i _high = _mm_add_epi16(_mm_unpackhi_epi8(_top, zero), _mm_unpackhi_epi8(_bottom, zero));
+	__m128i _sums = _mm_add_epi16(_mm_unpacklo_epi64(_low, _high), _mm_unpackhi_epi64(_low, _high));
+	return _mm_srli_epi16(_mm_add_epi16(_sums, round), 2);
+}
+
+//8bit, the 2 pixels of a pair are neighbour int16 lanes, a madd by 1 adds them up
+TARGET_SSE2 inline __m128i BoxHalveGraySSE2(const uint8_t *top, const uint8_t *bottom, __m128i zero, __m128i ones)
+{
+	__m128i _top = _mm_loadu_si128((const __m128i*)top);
+	__m128i _bottom = _mm_loadu_si128((const __m128i*)bottom);
+	__m128i _low = _mm_madd_epi16(_mm_add_epi16(_mm_unpacklo_epi8(_top, zero), _mm_unpacklo_epi8(_bottom, zero)), ones);
+	__m128i _high = _mm_madd_epi16(_mm_add_epi16(_mm_unpackhi_epi8(_top, zero), _mm_unpackhi_epi8(_bottom, zero)), ones);
+	return _mm_packs_epi32(_low, _high);
+}
+
+//32bit, two pixels of the block per register, then the halves folded together
+template<EPixelFormat Format>
+TARGET_SSE2 inline void BoxReduceSSE2(const uint16_t *sums, int count, int factor, int shift, uint8_t *out)
+{
+	const __m128i _round = _mm_set1_epi16(int16_t(1 << (shift - 1)));
+	const __m128i _shift = _mm_cvtsi32_si128(shift);
+
+	for (int x = 0; x < count; x++, out += 4)
+	{
+		__m128i _total = _mm_setzero_si128();
+		for (int i = 0; i < factor; i += 2, sums += 8)
+			_total = _mm_add_epi16(_total, _mm_loadu_si128((const __m128i*)sums));
+
+		_total = _mm_add_epi16(_total, _mm_srli_si128(_total, 8));
+		_total = _mm_srl_epi16(_mm_add_epi16(_total, _round), _shift);
+		int32_t _pixel = _mm_cvtsi128_si32(_mm_packus_epi16(_total, _total));
+		memcpy(out, &_pixel, 4);
+	}
+}
+
+//24bit pairs don't line up with the registers, that one stays on the scalar kernel
+template<EPixelFormat Format>
+TARGET_SSE2 inline void BoxHalveSSE2(const uint8_t *top, const uint8_t *bottom, int count, uint8_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const __m128i _zero = _mm_setzero_si128();
+	const __m128i _round = _mm_set1_epi16(2);
+
+	int x = 0;
+	if (_channels == 4)
+	{
+		for (; x + 4 <= count; x += 4, top += 32, bottom += 32, out += 16)
+		{
+			__m128i _a = BoxHalvePairsSSE2(top, bottom, _zero, _round);
+			__m128i _b = BoxHalvePairsSSE2(top + 16, bottom + 16, _zero, _round);
+			_mm_storeu_si128((__m128i*)out, _mm_packus_epi16(_a, _b));
+		}
+	}
+	else if (_channels == 1)
+	{
+		const __m128i _ones = _mm_set1_epi16(1);
+		for (; x + 16 <= count; x += 16, top += 32, bottom += 32, out += 16)
+		{
+			__m128i _a = _mm_srli_epi16(_mm_add_epi16(BoxHalveGraySSE2(top, bottom, _zero, _ones), _round), 2);
+			__m128i _b = _mm_srli_epi16(_mm_add_epi16(BoxHalveGraySSE2(top + 16, bottom + 16, _zero, _ones), _round), 2);
+			_mm_storeu_si128((__m128i*)out, _mm_packus_epi16(_a, _b));
+		}
+	}
+
+	BoxHalveScalar<Format>(top, bottom, count - x, out);
+}
+
+/*
+The horizontal convolution, a pixel per register, the taps two by two through madd.
+8bit instead takes 8 taps per register, the weights of a tap run straight from the table.
+24bit loads 4 bytes per pixel like the bilinear kernel, the caller keeps the windows that end on the last
+source pixel of the row out of it, & the row buffer needs an int16 of slack at its end.
+*/
+template<EPixelFormat Format>
+TARGET_SSE2 inline void ConvolveHorizontalSSE2(const uint8_t *row, const int32_t *first, const int16_t *weights, int taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const int _shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_CONVOLUTION_ROW_BITS;
+	const __m128i _zero = _mm_setzero_si128();
+	const __m128i _round = _mm_set1_epi32(1 << (_shift - 1));
+
+	for (int x = 0; x < count; x++, weights += taps, out += _channels)
+	{
+		const uint8_t *_pixel = row + first[x] * _channels;
+		__m128i _total = _channels == 1 ? _zero : _round;
+		int t = 0;
+
+		if (_channels == 1)
+		{
+			for (; t + 8 <= taps; t += 8)
+			{
+				__m128i _pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(_pixel + t)), _zero);
+				_total = _mm_add_epi32(_total, _mm_madd_epi16(_pixels, _mm_loadu_si128((const __m128i*)(weights + t))));
+			}
+
+			//the 4 partial sums folded into one
+			_total = _mm_add_epi32(_total, _mm_srli_si128(_total, 8));
+			_total = _mm_add_epi32(_total, _mm_srli_si128(_total, 4));
+			int32_t _sum = _mm_cvtsi128_si32(_total) + (1 << (_shift - 1));
+			for (; t < taps; t++)
+				_sum += _pixel[t] * weights[t];
+
+			out[0] = int16_t(_sum >> _shift);
+			continue;
+		}
+
+		for (; t + 2 <= taps; t += 2)
+		{
+			__m128i _pair = _mm_unpacklo_epi8(_mm_cvtsi32_si128(Load32(_pixel + t * _channels)), _mm_cvtsi32_si128(Load32(_pixel + (t + 1) * _channels)));
+			__m128i _weights = _mm_set1_epi32(int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) | uint16_t(weights[t]));
+			_total = _mm_add_epi32(_total, _mm_madd_epi16(_mm_unpacklo_epi8(_pair, _zero), _weights));
+		}
+		if (t < taps)
+		{
+			__m128i _single = _mm_unpacklo_epi8(_mm_cvtsi32_si128(Load32(_pixel + t * _channels)), _zero);
+			__m128i _weights = _mm_set1_epi32(uint16_t(weights[t]));
+			_total = _mm_add_epi32(_total, _mm_madd_epi16(_mm_unpacklo_epi8(_single, _zero), _weights));
+		}
+
+		_total = _mm_srai_epi32(_total, _shift);
+		_mm_storel_epi64((__m128i*)out, _mm_packs_epi32(_total, _total));
+	}
+}
+
+//8 lanes at a time, the taps two by two (an odd last tap pairs up with a zero weight)
+TARGET_SSE2 inline void ConvolveVerticalSSE2(const int16_t *const *rows, const int16_t *weights, int taps, size_t length, uint8_t *out)
+{
+	const __m128i _round = _mm_set1_epi32(1 << (RESAMPLE_CONVOLUTION_OUT_SHIFT - 1));
+
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i _low = _round;
+		__m128i _high = _round;
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m128i _a = _mm_loadu_si128((const __m128i*)(rows[t] + i));
+			__m128i _b = t + 1 < taps ? _mm_loadu_si128((const __m128i*)(rows[t + 1] + i)) : _mm_setzero_si128();
+			__m128i _weights = _mm_set1_epi32((t + 1 < taps ? int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) : 0) | uint16_t(weights[t]));
+			_low = _mm_add_epi32(_low, _mm_madd_epi16(_mm_unpacklo_epi16(_a, _b), _weights));
+			_high = _mm_add_epi32(_high, _mm_madd_epi16(_mm_unpackhi_epi16(_a, _b), _weights));
+		}
+
+		__m128i _packed = _mm_packs_epi32(_mm_srai_epi32(_low, RESAMPLE_CONVOLUTION_OUT_SHIFT), _mm_srai_epi32(_high, RESAMPLE_CONVOLUTION_OUT_SHIFT));
+		_mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(_packed, _packed));
+	}
+
+	ConvolveVerticalRange(rows, weights, taps, i, length, out);
+}
+
+//The decoded horizontal convolution, the pixels are int16 already so a pair of taps is just two 64bit loads interleaved.
+//24bit reads one int16 past its last pixel, the decoded row needs an int16 of slack at its end, so does the output
+template<EPixelFormat Format>
+TARGET_SSE2 inline void ConvolveDecodedHorizontalSSE2(const int16_t *row, int origin, const int32_t *first, const int16_t *weights, int taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const int _shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_DECODED_ROW_BITS;
+	const __m128i _zero = _mm_setzero_si128();
+	const __m128i _round = _mm_set1_epi32(1 << (_shift - 1));
+
+	for (int x = 0; x < count; x++, weights += taps, out += _channels)
+	{
+		const int16_t *_pixel = row + (first[x] - origin) * _channels;
+		int t = 0;
+
+		if (_channels == 1)
+		{
+			__m128i _total = _zero;
+			for (; t + 8 <= taps; t += 8)
+				_total = _mm_add_epi32(_total, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(_pixel + t)), _mm_loadu_si128((const __m128i*)(weights + t))));
+
+			_total = _mm_add_epi32(_total, _mm_srli_si128(_total, 8));
+			_total = _mm_add_epi32(_total, _mm_srli_si128(_total, 4));
+			int32_t _sum = _mm_cvtsi128_si32(_total) + (1 << (_shift - 1));
+			for (; t < taps; t++)
+				_sum += _pixel[t] * weights[t];
+
+			out[0] = int16_t(_sum >> _shift);
+			continue;
+		}
+
+		__m128i _total = _round;
+		for (; t + 2 <= taps; t += 2)
+		{
+			__m128i _pair = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(_pixel + t * _channels)), _mm_loadl_epi64((const __m128i*)(_pixel + (t + 1) * _channels)));
+			__m128i _weights = _mm_set1_epi32(int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) | uint16_t(weights[t]));
+			_total = _mm_add_epi32(_total, _mm_madd_epi16(_pair, _weights));
+		}
+		if (t < taps)
+		{
+			__m128i _single = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(_pixel + t * _channels)), _zero);
+			_total = _mm_add_epi32(_total, _mm_madd_epi16(_single, _mm_set1_epi32(uint16_t(weights[t]))));
+		}
+
+		_total = _mm_srai_epi32(_total, _shift);
+		_mm_storel_epi64((__m128i*)out, _mm_packs_epi32(_total, _total));
+	}
+}
+
+//The clamped 12bit lanes of a decoded vertical pass encoded back to 8bit, count is a multiple of 4 so the alpha lanes are fixed
+template<EPixelFormat Format, bool Linear>
+inline void EncodeDecodedLanes(const LinearLight &tables, const int16_t *values, int count, uint8_t *out)
+{
+	for (int j = 0; j < count; j += 4)
+	{
+		out[j] = EncodeDecoded<Format, Linear>(tables, values[j], 0);
+		out[j + 1] = EncodeDecoded<Format, Linear>(tables, values[j + 1], 1);
+		out[j + 2] = EncodeDecoded<Format, Linear>(tables, values[j + 2], 2);
+		out[j + 3] = EncodeDecoded<Format, Linear>(tables, values[j + 3], 3);
+	}
+}
+
+//2 decoded 32bit pixels, every color times the alpha of its pixel, same rounding as PremultiplyValue
+TARGET_SSE2 inline __m128i PremultiplyLanesSSE2(__m128i values, __m128i alphaMask, __m128i round)
+{
+	__m128i _alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(values, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	_alpha = _mm_or_si128(_mm_slli_epi16(_alpha, 4), _mm_srli_epi16(_alpha, 8));
+	__m128i _colors = _mm_srli_epi16(_mm_add_epi16(_mm_mulhi_epu16(_mm_slli_epi16(values, 4), _alpha), round), 4);
+	return _mm_or_si128(_mm_and_si128(alphaMask, values), _mm_andnot_si128(alphaMask, _colors));
+}
+
+template<EPixelFormat Format>
+TARGET_SSE2 inline void PremultiplySSE2(int16_t *row, int count)
+{
+	const __m128i _alphaMask = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+	const __m128i _round = _mm_set1_epi16(8);
+
+	int x = 0;
+	for (; x + 2 <= count; x += 2, row += 8)
+		_mm_storeu_si128((__m128i*)row, PremultiplyLanesSSE2(_mm_loadu_si128((const __m128i*)row), _alphaMask, _round));
+
+	PremultiplyScalar<Format>(row, count - x);
+}
+
+//4 pixels per load, widened to 12bit by repeating the top bits (the same values as the straight table) & premultiplied
+template<EPixelFormat Format>
+TARGET_SSE2 inline void PremultiplyDecodeSSE2(const uint8_t *row, int count, int16_t *out)
+{
+	const __m128i _zero = _mm_setzero_si128();
+	const __m128i _alphaMask = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+	const __m128i _round = _mm_set1_epi16(8);
+
+	int x = 0;
+	for (; x + 4 <= count; x += 4, row += 16, out += 16)
+	{
+		__m128i _bytes = _mm_loadu_si128((const __m128i*)row);
+		__m128i _low = _mm_unpacklo_epi8(_bytes, _zero);
+		__m128i _high = _mm_unpackhi_epi8(_bytes, _zero);
+		_low = _mm_or_si128(_mm_slli_epi16(_low, 4), _mm_srli_epi16(_low, 4));
+		_high = _mm_or_si128(_mm_slli_epi16(_high, 4), _mm_srli_epi16(_high, 4));
+		_mm_storeu_si128((__m128i*)out, PremultiplyLanesSSE2(_low, _alphaMask, _round));
+		_mm_storeu_si128((__m128i*)(out + 8), PremultiplyLanesSSE2(_high, _alphaMask, _round));
+	}
+
+	PremultiplyDecodeScalar<Format>(row, count - x, out);
+}
+
+//2 clamped premultiplied pixels back to straight, the reciprocal of every alpha comes from the table, no divide
+TARGET_SSE2 inline __m128i UnpremultiplyLanesSSE2(const LinearLight &tables, __m128i values)
+{
+	const __m128i _zero = _mm_setzero_si128();
+	const __m128 _half = _mm_set1_ps(0.5f);
+
+	__m128i _alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(values, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i _colors = _mm_min_epi16(values, _alpha);
+
+	const float _scale0 = tables.m_Unpremultiply[_mm_extract_epi16(values, 3)];
+	const float _scale1 = tables.m_Unpremultiply[_mm_extract_epi16(values, 7)];
+	__m128 _low = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_colors, _zero)), _mm_setr_ps(_scale0, _scale0, _scale0, 1.0f));
+	__m128 _high = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(_colors, _zero)), _mm_setr_ps(_scale1, _scale1, _scale1, 1.0f));
+	return _mm_packs_epi32(_mm_cvttps_epi32(_mm_add_ps(_low, _half)), _mm_cvttps_epi32(_mm_add_ps(_high, _half)));
+}
+
+//8 clamped 12bit lanes to 8bit, the straight ones through the m_Narrow formula of LinearLight.h, the linear ones through the table
+template<EPixelFormat Format, bool Linear>
+TARGET_SSE2 inline void EncodeLanesSSE2(const LinearLight &tables, __m128i values, uint8_t *out)
+{
+	if (Linear)
+	{
+		int16_t _values[8];
+		_mm_storeu_si128((__m128i*)_values, values);
+		EncodeDecodedLanes<Format, true>(tables, _values, 8, out);
+		return;
+	}
+
+	__m128i _narrow = _mm_srli_epi16(_mm_add_epi16(_mm_mulhi_epu16(values, _mm_set1_epi16(8162)), _mm_set1_epi16(1)), 1);
+	_mm_storel_epi64((__m128i*)out, _mm_packus_epi16(_narrow, _narrow));
+}
+
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_SSE2 inline void ConvolveDecodedVerticalSSE2(const int16_t *const *rows, const int16_t *weights, int taps, size_t length, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const __m128i _round = _mm_set1_epi32(1 << (RESAMPLE_DECODED_OUT_SHIFT - 1));
+	const __m128i _zero = _mm_setzero_si128();
+	const __m128i _max = _mm_set1_epi16(LINEAR_LIGHT_MAX);
+
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i _low = _round;
+		__m128i _high = _round;
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m128i _a = _mm_loadu_si128((const __m128i*)(rows[t] + i));
+			__m128i _b = t + 1 < taps ? _mm_loadu_si128((const __m128i*)(rows[t + 1] + i)) : _zero;
+			__m128i _weights = _mm_set1_epi32((t + 1 < taps ? int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) : 0) | uint16_t(weights[t]));
+			_low = _mm_add_epi32(_low, _mm_madd_epi16(_mm_unpacklo_epi16(_a, _b), _weights));
+			_high = _mm_add_epi32(_high, _mm_madd_epi16(_mm_unpackhi_epi16(_a, _b), _weights));
+		}
+
+		__m128i _packed = _mm_packs_epi32(_mm_srai_epi32(_low, RESAMPLE_DECODED_OUT_SHIFT), _mm_srai_epi32(_high, RESAMPLE_DECODED_OUT_SHIFT));
+		_packed = _mm_min_epi16(_mm_max_epi16(_packed, _zero), _max);
+		if (Premultiplied)
+			_packed = UnpremultiplyLanesSSE2(_tables, _packed);
+		EncodeLanesSSE2<Format, Linear>(_tables, _packed, out + i);
+	}
+
+	ConvolveDecodedVerticalRange<Format, Linear, Premultiplied>(rows, weights, taps, i, length, out);
+}
+
+//The two decoded pixels of a tap lerped, [c0 c1] pairs per channel through one madd
+TARGET_SSE2 inline __m128i DecodedTapSSE2(const int16_t *row, int origin, const FixedTap &tap, __m128i round)
+{
+	__m128i _pair = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(row + tap.m_Offset0 - origin)), _mm_loadl_epi64((const __m128i*)(row + tap.m_Offset1 - origin)));
+	return _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_pair, _mm_set1_epi32(tap.m_Weights)), round), RESAMPLE_DECODED_BILINEAR_SHIFT);
+}
+
+//Same layout as HorizontalSSE2, 24bit reads an int16 past its last pixel, the decoded row has that slack
+template<EPixelFormat Format>
+TARGET_SSE2 inline void DecodedHorizontalSSE2(const int16_t *row, int origin, const FixedTap *taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const __m128i _round = _mm_set1_epi32(1 << (RESAMPLE_DECODED_BILINEAR_SHIFT - 1));
+
+	int x = 0;
+	if (_channels != 1)
+	{
+		for (; x + 2 <= count; x += 2, taps += 2, out += 2 * _channels)
+		{
+			__m128i _packed = _mm_packs_epi32(DecodedTapSSE2(row, origin, taps[0], _round), DecodedTapSSE2(row, origin, taps[1], _round));
+			if (_channels == 4)
+				_mm_storeu_si128((__m128i*)out, _packed);
+			else
+			{
+				_mm_storel_epi64((__m128i*)out, _packed);
+				_mm_storel_epi64((__m128i*)(out + 3), _mm_srli_si128(_packed, 8));
+			}
+		}
+	}
+
+	DecodedHorizontalScalar<Format>(row, origin, taps, count - x, out);
+}
+
+//8 lanes of the two rows lerped back to 12bit
+TARGET_SSE2 inline __m128i DecodedLerpLanesSSE2(__m128i top, __m128i bottom, __m128i weights, __m128i round)
+{
+	__m128i _low = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(top, bottom), weights), round), RESAMPLE_DECODED_BILINEAR_OUT_SHIFT);
+	__m128i _high = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(top, bottom), weights), round), RESAMPLE_DECODED_BILINEAR_OUT_SHIFT);
+	return _mm_packs_epi32(_low, _high);
+}
+
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_SSE2 inline void DecodedVerticalSSE2(const int16_t *top, const int16_t *bottom, int32_t weights, size_t length, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const __m128i _weights = _mm_set1_epi32(weights);
+	const __m128i _round = _mm_set1_epi32(1 << (RESAMPLE_DECODED_BILINEAR_OUT_SHIFT - 1));
+
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i _values = DecodedLerpLanesSSE2(_mm_loadu_si128((const __m128i*)(top + i)), _mm_loadu_si128((const __m128i*)(bottom + i)), _weights, _round);
+		if (Premultiplied)
+			_values = UnpremultiplyLanesSSE2(_tables, _values);
+		EncodeLanesSSE2<Format, Linear>(_tables, _values, out + i);
+	}
+
+	DecodedVerticalRange<Format, Linear, Premultiplied>(top, bottom, weights, i, length, out);
+}
+
+TARGET_SSE2 inline void DecodedBoxAccumulateSSE2(const int16_t *row, size_t length, uint32_t *sums)
+{
+	const __m128i _zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i _values = _mm_loadu_si128((const __m128i*)(row + i));
+		_mm_storeu_si128((__m128i*)(sums + i), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(sums + i)), _mm_unpacklo_epi16(_values, _zero)));
+		_mm_storeu_si128((__m128i*)(sums + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(sums + i + 4)), _mm_unpackhi_epi16(_values, _zero)));
+	}
+
+	DecodedBoxAccumulateScalar(row + i, length - i, sums + i);
+}
+
+//16 bytes of 32bit pixels decoded into [0 1] & [2 3], the sRGB table stays scalar like the decode kernels
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_SSE2 inline void DecodeLanesSSE2(const uint8_t *bytes, __m128i &low, __m128i &high)
+{
+	if (Linear)
+	{
+		int16_t _values[16];
+		LinearDecodeScalar<Format>(bytes, 4, _values);
+		low = _mm_loadu_si128((const __m128i*)_values);
+		high = _mm_loadu_si128((const __m128i*)(_values + 8));
+	}
+	else
+	{
+		const __m128i _zero = _mm_setzero_si128();
+		__m128i _bytes = _mm_loadu_si128((const __m128i*)bytes);
+		low = _mm_unpacklo_epi8(_bytes, _zero);
+		high = _mm_unpackhi_epi8(_bytes, _zero);
+		low = _mm_or_si128(_mm_slli_epi16(low, 4), _mm_srli_epi16(low, 4));
+		high = _mm_or_si128(_mm_slli_epi16(high, 4), _mm_srli_epi16(high, 4));
+	}
+
+	if (Premultiplied)
+	{
+		const __m128i _alphaMask = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+		const __m128i _round = _mm_set1_epi16(8);
+		low = PremultiplyLanesSSE2(low, _alphaMask, _round);
+		high = PremultiplyLanesSSE2(high, _alphaMask, _round);
+	}
+}
+
+//The decoded 2x2 box of 32bit, 2 output pixels per iteration, the pixel pairs of the two rows added in the low half of a register
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_SSE2 inline void DecodedHalveSSE2(const uint8_t *top, const uint8_t *bottom, int count, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const __m128i _two = _mm_set1_epi16(2);
+
+	int x = 0;
+	for (; x + 2 <= count; x += 2, top += 16, bottom += 16, out += 8)
+	{
+		__m128i _topLow, _topHigh, _bottomLow, _bottomHigh;
+		DecodeLanesSSE2<Format, Linear, Premultiplied>(top, _topLow, _topHigh);
+		DecodeLanesSSE2<Format, Linear, Premultiplied>(bottom, _bottomLow, _bottomHigh);
+		__m128i _low = _mm_add_epi16(_topLow, _bottomLow);
+		__m128i _high = _mm_add_epi16(_topHigh, _bottomHigh);
+		_low = _mm_add_epi16(_low, _mm_srli_si128(_low, 8));
+		_high = _mm_add_epi16(_high, _mm_srli_si128(_high, 8));
+
+		__m128i _values = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(_low, _high), _two), 2);
+		if (Premultiplied)
+			_values = UnpremultiplyLanesSSE2(_tables, _values);
+		EncodeLanesSSE2<Format, Linear>(_tables, _values, out);
+	}
+
+	DecodedHalveScalar<Format, Linear, Premultiplied>(top, bottom, count - x, out);
+}
+
+//32bit, a pixel of the block per register, two output pixels encoded together. The other formats stay on the scalar kernel
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_SSE2 inline void DecodedBoxReduceSSE2(const uint32_t *sums, int count, int factor, int shift, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const __m128i _round = _mm_set1_epi32(1 << (shift - 1));
+	const __m128i _shift = _mm_cvtsi32_si128(shift);
+
+	int x = 0;
+	for (; x + 2 <= count; x += 2, out += 8)
+	{
+		__m128i _first = _round;
+		for (int i = 0; i < factor; i++, sums += 4)
+			_first = _mm_add_epi32(_first, _mm_loadu_si128((const __m128i*)sums));
+		__m128i _second = _round;
+		for (int i = 0; i < factor; i++, sums += 4)
+			_second = _mm_add_epi32(_second, _mm_loadu_si128((const __m128i*)sums));
+
+		__m128i _values = _mm_packs_epi32(_mm_srl_epi32(_first, _shift), _mm_srl_epi32(_second, _shift));
+		if (Premultiplied)
+			_values = UnpremultiplyLanesSSE2(_tables, _values);
+		EncodeLanesSSE2<Format, Linear>(_tables, _values, out);
+	}
+
+	DecodedBoxReduceScalar<Format, Linear, Premultiplied>(sums, count - x, factor, shift, out);
+}
+
+//------------------
+//AVX2 kernels //
+//------------------
+//Two taps per 256bit register, the first in the low lane & the second in the high lane
+TARGET_AVX2 inline __m256i ResolveTapsAVX2(const uint8_t *row, const FixedTap *taps, __m256i round)
+{
+	__m128i _pair = _mm_unpacklo_epi64(
+		_mm_unpacklo_epi8(_mm_cvtsi32_si128(Load32(row + taps[0].m_Offset0)), _mm_cvtsi32_si128(Load32(row + taps[0].m_Offset1))),
+		_mm_unpacklo_epi8(_mm_cvtsi32_si128(Load32(row + taps[1].m_Offset0)), _mm_cvtsi32_si128(Load32(row + taps[1].m_Offset1))));
+	__m256i _weights = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi32(taps[0].m_Weights)), _mm_set1_epi32(taps[1].m_Weights), 1);
+	__m256i _sum = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_pair), _weights);
+	return _mm256_srai_epi32(_mm256_add_epi32(_sum, round), RESAMPLE_ROW_BITS);
+}
+
+template<EPixelFormat Format>
+TARGET_AVX2 inline void HorizontalAVX2(const uint8_t *row, const FixedTap *taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const __m256i _round = _mm256_set1_epi32(RESAMPLE_ROW_ROUND);
+
+	int x = 0;
+	for (; x + 4 <= count; x += 4, taps += 4)
+	{
+		//packs works per lane, [0 2 | 1 3] -> [0 1 2 3]
+		__m256i _packed = _mm256_packs_epi32(ResolveTapsAVX2(row, taps, _round), ResolveTapsAVX2(row, taps + 2, _round));
+		_packed = _mm256_permute4x64_epi64(_packed, _MM_SHUFFLE(3, 1, 2, 0));
+
+		if (_channels == 4)
+		{
+			_mm256_storeu_si256((__m256i*)out, _packed);
+			out += 16;
+		}
+		else
+		{
+			__m128i _low = _mm256_castsi256_si128(_packed);
+			__m128i _high = _mm256_extracti128_si256(_packed, 1);
+			_mm_storel_epi64((__m128i*)out, _low);
+			_mm_storel_epi64((__m128i*)(out + 3), _mm_srli_si128(_low, 8));
+			_mm_storel_epi64((__m128i*)(out + 6), _high);
+			_mm_storel_epi64((__m128i*)(out + 9), _mm_srli_si128(_high, 8));
+			out += 12;
+		}
+	}
+
+	HorizontalSSE2<Format>(row, taps, count - x, out);
+}
+
+TARGET_AVX2 inline __m256i VerticalLanesAVX2(__m256i top, __m256i bottom, __m256i weights)
+{
+	__m256i _low = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(top, bottom), weights), RESAMPLE_OUT_SHIFT);
+	__m256i _high = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(top, bottom), weights), RESAMPLE_OUT_SHIFT);
+	return _mm256_packs_epi32(_low, _high);
+}
+
+TARGET_AVX2 inline void VerticalAVX2(const int16_t *top, const int16_t *bottom, int32_t weights, size_t length, uint8_t *out)
+{
+	const __m256i _weights = _mm256_set1_epi32(weights);
+
+	size_t i = 0;
+	for (; i + 32 <= length; i += 32)
+	{
+		__m256i _a = VerticalLanesAVX2(_mm256_loadu_si256((const __m256i*)(top + i)), _mm256_loadu_si256((const __m256i*)(bottom + i)), _weights);
+		__m256i _b = VerticalLanesAVX2(_mm256_loadu_si256((const __m256i*)(top + i + 16)), _mm256_loadu_si256((const __m256i*)(bottom + i + 16)), _weights);
+		//packus works per lane too, [0 2 | 1 3] -> [0 1 2 3]
+		__m256i _packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(_a, _b), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*)(out + i), _packed);
+	}
+
+	VerticalSSE2(top + i, bottom + i, weights, length - i, out + i);
+}
+TARGET_AVX2 inline void BoxAccumulateAVX2(const uint8_t *row, size_t length, uint16_t *sums)
+{
+	size_t i = 0;
+	for (; i + 32 <= length; i += 32)
+	{
+		__m256i _low = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(row + i)));
+		__m256i _high = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(row + i + 16)));
+		_mm256_storeu_si256((__m256i*)(sums + i), _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(sums + i)), _low));
+		_mm256_storeu_si256((__m256i*)(sums + i + 16), _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(sums + i + 16)), _high));
+	}
+
+	BoxAccumulateSSE2(row + i, length - i, sums + i);
+}
+//PremultiplyLanesSSE2 on 4 pixels, the shuffles & shifts all work per 128bit lane
+TARGET_AVX2 inline __m256i PremultiplyLanesAVX2(__m256i values, __m256i alphaMask, __m256i round)
+{
+	__m256i _alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(values, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	_alpha = _mm256_or_si256(_mm256_slli_epi16(_alpha, 4), _mm256_srli_epi16(_alpha, 8));
+	__m256i _colors = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mulhi_epu16(_mm256_slli_epi16(values, 4), _alpha), round), 4);
+	return _mm256_blendv_epi8(_colors, values, alphaMask);
+}
+
+template<EPixelFormat Format>
+TARGET_AVX2 inline void PremultiplyAVX2(int16_t *row, int count)
+{
+	const __m256i _alphaMask = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+	const __m256i _round = _mm256_set1_epi16(8);
+
+	int x = 0;
+	for (; x + 4 <= count; x += 4, row += 16)
+		_mm256_storeu_si256((__m256i*)row, PremultiplyLanesAVX2(_mm256_loadu_si256((const __m256i*)row), _alphaMask, _round));
+
+	PremultiplySSE2<Format>(row, count - x);
+}
+
+//16 bytes decoded to 12bit, the linear ones a gather each 8 (the alpha lanes read m_Expand right after m_ToLinear), the straight ones
+//widened by repeating their top bits like m_Expand. The premultiplied 32bit pixels get their colors weighted by their alpha too
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_AVX2 inline __m256i DecodeLanesAVX2(const LinearLight &tables, const uint8_t *bytes)
+{
+	__m256i _values;
+	if (Linear)
+	{
+		const __m256i _alpha = Format == EPixelFormat::BGRA32 ? _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256) : _mm256_setzero_si256();
+		const __m256i _mask = _mm256_set1_epi32(0xFFFF);
+		__m128i _bytes = _mm_loadu_si128((const __m128i*)bytes);
+		__m256i _low = _mm256_i32gather_epi32((const int*)tables.m_ToLinear, _mm256_add_epi32(_mm256_cvtepu8_epi32(_bytes), _alpha), 2);
+		__m256i _high = _mm256_i32gather_epi32((const int*)tables.m_ToLinear, _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(_bytes, 8)), _alpha), 2);
+		//packs works per lane, [0 2 | 1 3] -> [0 1 2 3]
+		_values = _mm256_packs_epi32(_mm256_and_si256(_low, _mask), _mm256_and_si256(_high, _mask));
+		_values = _mm256_permute4x64_epi64(_values, _MM_SHUFFLE(3, 1, 2, 0));
+	}
+	else
+	{
+		_values = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)bytes));
+		_values = _mm256_or_si256(_mm256_slli_epi16(_values, 4), _mm256_srli_epi16(_values, 4));
+	}
+
+	if (Premultiplied)
+		_values = PremultiplyLanesAVX2(_values, _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1), _mm256_set1_epi16(8));
+	return _values;
+}
+
+template<EPixelFormat Format>
+TARGET_AVX2 inline void PremultiplyDecodeAVX2(const uint8_t *row, int count, int16_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+
+	int x = 0;
+	for (; x + 4 <= count; x += 4, row += 16, out += 16)
+		_mm256_storeu_si256((__m256i*)out, DecodeLanesAVX2<Format, false, true>(_tables, row));
+
+	PremultiplyDecodeSSE2<Format>(row, count - x, out);
+}
+
+template<EPixelFormat Format>
+TARGET_AVX2 inline void LinearDecodeAVX2(const uint8_t *row, int count, int16_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const size_t _length = size_t(count) * PixelTraits<Format>::Channels;
+
+	size_t i = 0;
+	for (; i + 16 <= _length; i += 16)
+		_mm256_storeu_si256((__m256i*)(out + i), DecodeLanesAVX2<Format, true, false>(_tables, row + i));
+
+	for (; i < _length; i++)
+		out[i] = Format == EPixelFormat::BGRA32 && (i & 3) == 3 ? _tables.m_Expand[row[i]] : _tables.m_ToLinear[row[i]];
+}
+
+/*
+4 premultiplied pixels back to straight, the same math as UnpremultiplyLanesSSE2 with the reciprocals broadcast straight from
+the table (the alphas go through the stack, that keeps the shuffle port free). Clamping the result to 4095 is the same
+as clamping the color to its alpha first, a color past its alpha comes out >= 4095 either way
+*/
+TARGET_AVX2 inline __m256i UnpremultiplyLanesAVX2(const LinearLight &tables, __m256i values)
+{
+	const __m256 _one = _mm256_set1_ps(1.0f);
+	const __m256 _half = _mm256_set1_ps(0.5f);
+	const __m256i _max = _mm256_set1_epi32(LINEAR_LIGHT_MAX);
+
+	int16_t _values[16];
+	_mm256_storeu_si256((__m256i*)_values, values);
+	__m256 _low = _mm256_blend_ps(_mm256_broadcast_ss(tables.m_Unpremultiply + _values[3]), _mm256_broadcast_ss(tables.m_Unpremultiply + _values[7]), 0xF0);
+	__m256 _high = _mm256_blend_ps(_mm256_broadcast_ss(tables.m_Unpremultiply + _values[11]), _mm256_broadcast_ss(tables.m_Unpremultiply + _values[15]), 0xF0);
+	_low = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(values))), _mm256_blend_ps(_low, _one, 0x88));
+	_high = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(values, 1))), _mm256_blend_ps(_high, _one, 0x88));
+
+	//packus works per lane, [0 2 | 1 3] -> [0 1 2 3]
+	__m256i _packed = _mm256_packus_epi32(_mm256_min_epi32(_mm256_cvttps_epi32(_mm256_add_ps(_low, _half)), _max),
+		_mm256_min_epi32(_mm256_cvttps_epi32(_mm256_add_ps(_high, _half)), _max));
+	return _mm256_permute4x64_epi64(_packed, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+//16 12bit lanes to 8bit, un-premultiplied first if asked. The linear ones gather from m_ToSRGB, the alpha lanes read m_Narrow right after it
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_AVX2 inline void EncodeLanesAVX2(const LinearLight &tables, __m256i values, uint8_t *out)
+{
+	if (Premultiplied)
+		values = UnpremultiplyLanesAVX2(tables, values);
+
+	if (Linear)
+	{
+		const __m256i _alpha = Format == EPixelFormat::BGRA32 ? _mm256_setr_epi32(0, 0, 0, 4096, 0, 0, 0, 4096) : _mm256_setzero_si256();
+		const __m256i _mask = _mm256_set1_epi32(0xFF);
+		__m256i _a = _mm256_i32gather_epi32((const int*)tables.m_ToSRGB, _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(values)), _alpha), 1);
+		__m256i _b = _mm256_i32gather_epi32((const int*)tables.m_ToSRGB, _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(values, 1)), _alpha), 1);
+		//packus works per lane, [0 2 | 1 3] -> [0 1 2 3]
+		values = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_and_si256(_a, _mask), _mm256_and_si256(_b, _mask)), _MM_SHUFFLE(3, 1, 2, 0));
+	}
+	else
+		values = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mulhi_epu16(values, _mm256_set1_epi16(8162)), _mm256_set1_epi16(1)), 1);
+	_mm_storeu_si128((__m128i*)out, _mm_packus_epi16(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1)));
+}
+
+//Two taps per 256bit register like ResolveTapsAVX2, on the decoded pixels
+TARGET_AVX2 inline __m256i DecodedTapsAVX2(const int16_t *row, int origin, const FixedTap *taps, __m256i round)
+{
+	__m128i _first = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(row + taps[0].m_Offset0 - origin)), _mm_loadl_epi64((const __m128i*)(row + taps[0].m_Offset1 - origin)));
+	__m128i _second = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(row + taps[1].m_Offset0 - origin)), _mm_loadl_epi64((const __m128i*)(row + taps[1].m_Offset1 - origin)));
+	__m256i _weights = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi32(taps[0].m_Weights)), _mm_set1_epi32(taps[1].m_Weights), 1);
+	__m256i _sum = _mm256_madd_epi16(_mm256_inserti128_si256(_mm256_castsi128_si256(_first), _second, 1), _weights);
+	return _mm256_srai_epi32(_mm256_add_epi32(_sum, round), RESAMPLE_DECODED_BILINEAR_SHIFT);
+}
+
+TARGET_AVX2 inline void ConvolveVerticalAVX2(const int16_t *const *rows, const int16_t *weights, int taps, size_t length, uint8_t *out)
+{
+	const __m256i _round = _mm256_set1_epi32(1 << (RESAMPLE_CONVOLUTION_OUT_SHIFT - 1));
+
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		__m256i _low = _round;
+		__m256i _high = _round;
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m256i _a = _mm256_loadu_si256((const __m256i*)(rows[t] + i));
+			__m256i _b = t + 1 < taps ? _mm256_loadu_si256((const __m256i*)(rows[t + 1] + i)) : _mm256_setzero_si256();
+			__m256i _weights = _mm256_set1_epi32((t + 1 < taps ? int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) : 0) | uint16_t(weights[t]));
+			_low = _mm256_add_epi32(_low, _mm256_madd_epi16(_mm256_unpacklo_epi16(_a, _b), _weights));
+			_high = _mm256_add_epi32(_high, _mm256_madd_epi16(_mm256_unpackhi_epi16(_a, _b), _weights));
+		}
+
+		//packs & packus work per lane, [0 | 1] stays in order once the two 64bit halves are gathered
+		__m256i _packed = _mm256_packs_epi32(_mm256_srai_epi32(_low, RESAMPLE_CONVOLUTION_OUT_SHIFT), _mm256_srai_epi32(_high, RESAMPLE_CONVOLUTION_OUT_SHIFT));
+		_packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(_packed, _packed), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(_packed));
+	}
+
+	ConvolveVerticalRange(rows, weights, taps, i, length, out);
+}
+
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_AVX2 inline void ConvolveDecodedVerticalAVX2(const int16_t *const *rows, const int16_t *weights, int taps, size_t length, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const __m256i _round = _mm256_set1_epi32(1 << (RESAMPLE_DECODED_OUT_SHIFT - 1));
+	const __m256i _zero = _mm256_setzero_si256();
+	const __m256i _max = _mm256_set1_epi16(LINEAR_LIGHT_MAX);
+
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		__m256i _low = _round;
+		__m256i _high = _round;
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m256i _a = _mm256_loadu_si256((const __m256i*)(rows[t] + i));
+			__m256i _b = t + 1 < taps ? _mm256_loadu_si256((const __m256i*)(rows[t + 1] + i)) : _zero;
+			__m256i _weights = _mm256_set1_epi32((t + 1 < taps ? int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) : 0) | uint16_t(weights[t]));
+			_low = _mm256_add_epi32(_low, _mm256_madd_epi16(_mm256_unpacklo_epi16(_a, _b), _weights));
+			_high = _mm256_add_epi32(_high, _mm256_madd_epi16(_mm256_unpackhi_epi16(_a, _b), _weights));
+		}
+
+		//packs works per lane & undoes what the unpacks did, the lanes come back in order
+		__m256i _packed = _mm256_packs_epi32(_mm256_srai_epi32(_low, RESAMPLE_DECODED_OUT_SHIFT), _mm256_srai_epi32(_high, RESAMPLE_DECODED_OUT_SHIFT));
+		_packed = _mm256_min_epi16(_mm256_max_epi16(_packed, _zero), _max);
+		EncodeLanesAVX2<Format, Linear, Premultiplied>(_tables, _packed, out + i);
+	}
+
+	ConvolveDecodedVerticalRange<Format, Linear, Premultiplied>(rows, weights, taps, i, length, out);
+}
+
+template<EPixelFormat Format>
+TARGET_AVX2 inline void DecodedHorizontalAVX2(const int16_t *row, int origin, const FixedTap *taps, int count, int16_t *out)
+{
+	const int _channels = PixelTraits<Format>::Channels;
+	const __m256i _round = _mm256_set1_epi32(1 << (RESAMPLE_DECODED_BILINEAR_SHIFT - 1));
+
+	int x = 0;
+	if (_channels != 1)
+	{
+		for (; x + 4 <= count; x += 4, taps += 4)
+		{
+			//packs works per lane, [0 2 | 1 3] -> [0 1 2 3]
+			__m256i _packed = _mm256_packs_epi32(DecodedTapsAVX2(row, origin, taps, _round), DecodedTapsAVX2(row, origin, taps + 2, _round));
+			_packed = _mm256_permute4x64_epi64(_packed, _MM_SHUFFLE(3, 1, 2, 0));
+
+			if (_channels == 4)
+			{
+				_mm256_storeu_si256((__m256i*)out, _packed);
+				out += 16;
+			}
+			else
+			{
+				__m128i _low = _mm256_castsi256_si128(_packed);
+				__m128i _high = _mm256_extracti128_si256(_packed, 1);
+				_mm_storel_epi64((__m128i*)out, _low);
+				_mm_storel_epi64((__m128i*)(out + 3), _mm_srli_si128(_low, 8));
+				_mm_storel_epi64((__m128i*)(out + 6), _high);
+				_mm_storel_epi64((__m128i*)(out + 9), _mm_srli_si128(_high, 8));
+				out += 12;
+			}
+		}
+	}
+
+	DecodedHorizontalSSE2<Format>(row, origin, taps, count - x, out);
+}
+
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_AVX2 inline void DecodedVerticalAVX2(const int16_t *top, const int16_t *bottom, int32_t weights, size_t length, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const __m256i _weights = _mm256_set1_epi32(weights);
+	const __m256i _round = _mm256_set1_epi32(1 << (RESAMPLE_DECODED_BILINEAR_OUT_SHIFT - 1));
+
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		__m256i _top = _mm256_loadu_si256((const __m256i*)(top + i));
+		__m256i _bottom = _mm256_loadu_si256((const __m256i*)(bottom + i));
+		__m256i _low = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(_top, _bottom), _weights), _round), RESAMPLE_DECODED_BILINEAR_OUT_SHIFT);
+		__m256i _high = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(_top, _bottom), _weights), _round), RESAMPLE_DECODED_BILINEAR_OUT_SHIFT);
+		EncodeLanesAVX2<Format, Linear, Premultiplied>(_tables, _mm256_packs_epi32(_low, _high), out + i);
+	}
+
+	DecodedVerticalSSE2<Format, Linear, Premultiplied>(top + i, bottom + i, weights, length - i, out + i);
+}
+
+TARGET_AVX2 inline void DecodedBoxAccumulateAVX2(const int16_t *row, size_t length, uint32_t *sums)
+{
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		__m256i _low = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(row + i)));
+		__m256i _high = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(row + i + 8)));
+		_mm256_storeu_si256((__m256i*)(sums + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(sums + i)), _low));
+		_mm256_storeu_si256((__m256i*)(sums + i + 8), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(sums + i + 8)), _high));
+	}
+
+	DecodedBoxAccumulateSSE2(row + i, length - i, sums + i);
+}
+
+//32bit, 4 output pixels per iteration so the encode gathers 16 lanes at once
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_AVX2 inline void DecodedBoxReduceAVX2(const uint32_t *sums, int count, int factor, int shift, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const __m256i _round = _mm256_set1_epi32(1 << (shift - 1));
+	const __m128i _shift = _mm_cvtsi32_si128(shift);
+
+	int x = 0;
+	for (; x + 4 <= count; x += 4, out += 16)
+	{
+		//pixels [0 1] & [2 3] side by side, the high lane gets the pixel after the low one
+		__m256i _a = _round;
+		__m256i _b = _round;
+		for (int i = 0; i < factor; i++, sums += 4)
+		{
+			_a = _mm256_add_epi32(_a, _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)sums)), _mm_loadu_si128((const __m128i*)(sums + factor * 4)), 1));
+			_b = _mm256_add_epi32(_b, _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(sums + factor * 8))), _mm_loadu_si128((const __m128i*)(sums + factor * 12)), 1));
+		}
+		sums += factor * 12;
+
+		//packs works per lane, [0 2 | 1 3] -> [0 1 2 3]
+		__m256i _values = _mm256_packs_epi32(_mm256_srl_epi32(_a, _shift), _mm256_srl_epi32(_b, _shift));
+		EncodeLanesAVX2<Format, Linear, Premultiplied>(_tables, _mm256_permute4x64_epi64(_values, _MM_SHUFFLE(3, 1, 2, 0)), out);
+	}
+
+	DecodedBoxReduceSSE2<Format, Linear, Premultiplied>(sums, count - x, factor, shift, out);
+}
+
+//DecodedHalveSSE2 on 4 output pixels per iteration
+template<EPixelFormat Format, bool Linear, bool Premultiplied>
+TARGET_AVX2 inline void DecodedHalveAVX2(const uint8_t *top, const uint8_t *bottom, int count, uint8_t *out)
+{
+	const LinearLight &_tables = LinearLight::Get();
+	const __m256i _two = _mm256_set1_epi16(2);
+
+	int x = 0;
+	for (; x + 4 <= count; x += 4, top += 32, bottom += 32, out += 16)
+	{
+		//[0 1 | 2 3] & [4 5 | 6 7], the pairs added in the low half of every lane
+		__m256i _low = _mm256_add_epi16(DecodeLanesAVX2<Format, Linear, Premultiplied>(_tables, top), DecodeLanesAVX2<Format, Linear, Premultiplied>(_tables, bottom));
+		__m256i _high = _mm256_add_epi16(DecodeLanesAVX2<Format, Linear, Premultiplied>(_tables, top + 16), DecodeLanesAVX2<Format, Linear, Premultiplied>(_tables, bottom + 16));
+		_low = _mm256_add_epi16(_low, _mm256_srli_si256(_low, 8));
+		_high = _mm256_add_epi16(_high, _mm256_srli_si256(_high, 8));
+
+		//[01 45 | 23 67] -> [01 23 45 67]
+		__m256i _values = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(_low, _high), _MM_SHUFFLE(3, 1, 2, 0));
+		EncodeLanesAVX2<Format, Linear, Premultiplied>(_tables, _mm256_srli_epi16(_mm256_add_epi16(_values, _two), 2), out);
+	}
+
+	DecodedHalveSSE2<Format, Linear, Premultiplied>(top, bottom, count - x, out);
+}
+#endif // IMAGEDROP_X86
+
+//The set of kernels for one instruction set & one pixel format
+class ResampleKernels
+{
+public:
+	EResampleKernel m_Type;
+	EPixelFormat m_Format;
+	HorizontalKernel m_Horizontal;
+	HorizontalKernel m_HorizontalScalar;		//for the columns the SIMD one can't take (the end of a 24bit row)
+	VerticalKernel m_Vertical;
+	BoxAccumulateKernel m_BoxAccumulate;
+	BoxReduceKernel m_BoxReduce;
+	BoxHalveKernel m_BoxHalve;
+	ConvolveHorizontalKernel m_ConvolveHorizontal;
+	ConvolveHorizontalKernel m_ConvolveHorizontalScalar;	//for the 24bit windows the SIMD one can't take
+	ConvolveVerticalKernel m_ConvolveVertical;
+	DecodeKernel m_Decode;						//the decoded rows, linear light and/or premultiplied alpha
+	ConvolveDecodedHorizontalKernel m_ConvolveDecodedHorizontal;
+	ConvolveVerticalKernel m_ConvolveDecodedVertical;
+	DecodedHorizontalKernel m_DecodedHorizontal;
+	VerticalKernel m_DecodedVertical;
+	DecodedBoxAccumulateKernel m_DecodedBoxAccumulate;
+	DecodedBoxReduceKernel m_DecodedBoxReduce;
+	BoxHalveKernel m_DecodedHalve;
+
+	ResampleKernels(EResampleKernel type, EPixelFormat format = EPixelFormat::BGR24)
+	{
+		m_Type = type;
+		Select(format);
+	}
+
+	//linear & premultiplied only pick the decoded kernels, premultiplied means nothing without an alpha
+	void Select(EPixelFormat format, bool linear = false, bool premultiplied = false)
+	{
+		m_Format = format;
+		if (format == EPixelFormat::Gray8)
+		{
+			Select<EPixelFormat::Gray8>();
+			SelectDecoded<EPixelFormat::Gray8>(linear, false);
+		}
+		else if (format == EPixelFormat::BGRA32)
+		{
+			Select<EPixelFormat::BGRA32>();
+			SelectDecoded<EPixelFormat::BGRA32>(linear, premultiplied);
+		}
+		else
+		{
+			Select<EPixelFormat::BGR24>();
+			SelectDecoded<EPixelFormat::BGR24>(linear, false);
+		}
+	}
+
+	template<EPixelFormat Format>
+	void SelectDecoded(bool linear, bool premultiplied)
+	{
+		if (premultiplied)
+		{
+			if (linear)
+				SelectDecoded<Format, true, true>();
+			else
+				SelectDecoded<Format, false, true>();
+		}
+		else
+		{
+			if (linear)
+				SelectDecoded<Format, true, false>();
+			else
+				SelectDecoded<Format, false, false>();
+		}
+	}
+
+	template<EPixelFormat Format, bool Linear, bool Premultiplied>
+	void SelectDecoded()
+	{
+		if (!Premultiplied)
+			m_Decode = LinearDecodeScalar<Format>;
+		else if (Linear)
+			m_Decode = DecodePremultiplied<LinearDecodeScalar<Format>, PremultiplyScalar<Format>>;
+		else
+			m_Decode = PremultiplyDecodeScalar<Format>;
+		m_ConvolveDecodedHorizontal = ConvolveDecodedHorizontalScalar<Format>;
+		m_ConvolveDecodedVertical = ConvolveDecodedVerticalScalar<Format, Linear, Premultiplied>;
+		m_DecodedHorizontal = DecodedHorizontalScalar<Format>;
+		m_DecodedVertical = DecodedVerticalScalar<Format, Linear, Premultiplied>;
+		m_DecodedBoxAccumulate = DecodedBoxAccumulateScalar;
+		m_DecodedBoxReduce = DecodedBoxReduceScalar<Format, Linear, Premultiplied>;
+		m_DecodedHalve = DecodedHalveScalar<Format, Linear, Premultiplied>;
+
+#if IMAGEDROP_X86
+		if (m_Type == EResampleKernel::SSE2 || m_Type == EResampleKernel::AVX2)
+		{
+			//the sRGB table stays scalar, only the premultiply is done in SIMD after it
+			if (Premultiplied && Linear)
+				m_Decode = DecodePremultiplied<LinearDecodeScalar<Format>, PremultiplySSE2<Format>>;
+			else if (Premultiplied)
+				m_Decode = PremultiplyDecodeSSE2<Format>;
+			m_ConvolveDecodedHorizontal = ConvolveDecodedHorizontalSSE2<Format>;
+			m_ConvolveDecodedVertical = ConvolveDecodedVerticalSSE2<Format, Linear, Premultiplied>;
+			m_DecodedHorizontal = DecodedHorizontalSSE2<Format>;
+			m_DecodedVertical = DecodedVerticalSSE2<Format, Linear, Premultiplied>;
+			m_DecodedBoxAccumulate = DecodedBoxAccumulateSSE2;
+			if (PixelTraits<Format>::Channels == 4)
+			{
+				m_DecodedBoxReduce = DecodedBoxReduceSSE2<Format, Linear, Premultiplied>;
+				m_DecodedHalve = DecodedHalveSSE2<Format, Linear, Premultiplied>;
+			}
+		}
+
+		if (m_Type == EResampleKernel::AVX2)
+		{
+			//AVX2 gathers the sRGB table, 16 bytes at a time
+			if (Premultiplied && Linear)
+				m_Decode = DecodePremultiplied<LinearDecodeAVX2<Format>, PremultiplyAVX2<Format>>;
+			else if (Premultiplied)
+				m_Decode = PremultiplyDecodeAVX2<Format>;
+			else
+				m_Decode = LinearDecodeAVX2<Format>;
+			m_ConvolveDecodedVertical = ConvolveDecodedVerticalAVX2<Format, Linear, Premultiplied>;
+			m_DecodedHorizontal = DecodedHorizontalAVX2<Format>;
+			m_DecodedVertical = DecodedVerticalAVX2<Format, Linear, Premultiplied>;
+			m_DecodedBoxAccumulate = DecodedBoxAccumulateAVX2;
+			if (PixelTraits<Format>::Channels == 4)
+			{
+				m_DecodedBoxReduce = DecodedBoxReduceAVX2<Format, Linear, Premultiplied>;
+				m_DecodedHalve = DecodedHalveAVX2<Format, Linear, Premultiplied>;
+			}
+		}
+#endif // IMAGEDROP_X86
+	}
+
+	template<EPixelFormat Format>
+	void Select()
+	{
+		m_Horizontal = HorizontalScalar<Format>;
+		m_HorizontalScalar = HorizontalScalar<Format>;
+		m_Vertical = VerticalScalar;
+		m_BoxAccumulate = BoxAccumulateScalar;
+		m_BoxReduce = BoxReduceScalar<Format>;
+		m_BoxHalve = BoxHalveScalar<Format>;
+		m_ConvolveHorizontal = ConvolveHorizontalScalar<Format>;
+		m_ConvolveHorizontalScalar = ConvolveHorizontalScalar<Format>;
+		m_ConvolveVertical = ConvolveVerticalScalar;
+
+#if IMAGEDROP_X86
+		//8bit stays on the scalar horizontal pass, its taps are gathered a byte at a time & the SIMD version of that
+		//measured slower than the unrolled scalar loop (--bench-kernels). Its vertical pass is as wide as any other
+		const bool _simdHorizontal = PixelTraits<Format>::Channels != 1;
+		if (m_Type == EResampleKernel::SSE2 || m_Type == EResampleKernel::AVX2)
+		{
+			if (_simdHorizontal)
+				m_Horizontal = HorizontalSSE2<Format>;
+			m_Vertical = VerticalSSE2;
+			m_BoxAccumulate = BoxAccumulateSSE2;
+			m_ConvolveHorizontal = ConvolveHorizontalSSE2<Format>;
+			m_ConvolveVertical = ConvolveVerticalSSE2;
+			if (PixelTraits<Format>::Channels == 4)
+				m_BoxReduce = BoxReduceSSE2<Format>;
+			//halving is bound by the memory long before the SSE2 kernel runs out, AVX2 takes the same one
+			if (PixelTraits<Format>::Channels != 3)
+				m_BoxHalve = BoxHalveSSE2<Format>;
+		}
+
+		if (m_Type == EResampleKernel::AVX2)
+		{
+			if (_simdHorizontal)
+				m_Horizontal = HorizontalAVX2<Format>;
+			m_Vertical = VerticalAVX2;
+			m_BoxAccumulate = BoxAccumulateAVX2;
+			m_ConvolveVertical = ConvolveVerticalAVX2;
+		}
+#endif // IMAGEDROP_X86
+	}
+
+	//The best kernel the running CPU supports, picked once at startup
+	static EResampleKernel Detect()
+	{
+		static const EResampleKernel _best =
+			CpuFeatures::Get().m_HasAVX2 ? EResampleKernel::AVX2 :
+			CpuFeatures::Get().m_HasSSE2 ? EResampleKernel::SSE2 :
+			EResampleKernel::Scalar;
+
+		return _best;
+	}
+};
\ No newline at end of file
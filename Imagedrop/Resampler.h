@@ -0,0 +1,900 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include "Macros.h"
+#include "ResampleKernels.h"
+#include "ResampleFilters.h"
+#include "ThreadPool.h"
+#include "ImageBuffer.h"
+#include "Profiler.h"
+
+/*
+The separable (two-pass) resampler
+- Bilinear is separable, so instead of fetching 4 neighbours & lerping per output pixel, we do
+	a horizontal pass over whole source rows, then a vertical pass between two of those rows.
+- All the per-pixel math (_w, _h, floor() and the clamps) is resolved ONCE per resize into
+	the column & row tap tables, the inner loops are just table lookups and lerps.
+- The horizontally resampled rows are cached (2 slots), so scaling up reuses the same source
+	rows for several output rows without redoing the horizontal pass.
+- It knows nothing about TGA or BMP, it works on raw interleaved 8bit pixels + a row stride,
+	so any format can plug it behind its own OnImageResize.
+- The passes run either in float (the Reference, same math as the old per-pixel bilinear) or in
+	fixed point through the Scalar/SSE2/AVX2 kernels picked at startup from CPUID.
+- The output is cut into tiles (row bands, plus column splits for very wide images) that run on the
+	work-stealing pool, each tile has its own row cache & writes its own pixels, so the bytes are the
+	same whatever the threads count is.
+- Resize() does the whole image at once, Prepare() + Run() do it a block of output rows at a time
+	from a window of source rows, for the streaming mode that never holds the whole image.
+- The tile loop is a template on the pixel format, the filter & float/fixed point. Prepare() picks the
+	one instance for the image, so nothing inside the loops branches on the channels or the kernel anymore.
+- Halving (the default) & the other integer downscales (1/4, 1/8) don't go through bilinear at all, every
+	output pixel is the exact average of its k x k source block. Bilinear only ever reads 2 x 2 neighbours,
+	so shrinking more than 2x with it skips source pixels & aliases, the box reads every one of them.
+- Nearest just picks pixels, Catmull-Rom, Mitchell & Lanczos-2/3 are separable convolutions over the cached
+	weight tables of ResampleFilters.h, horizontally into int16 rows (a ring of the rows the vertical taps
+	need), then vertically into the output.
+- The linear light mode (gamma correct) keeps every filter on its own tile loop, a source row is decoded once through
+	the sRGB table into 12bit int16 pixels before the horizontal pass (or the box sums) reads it, and the vertical pass
+	(or the box reduce) encodes its result back through the 4096 entries one. Nearest never blends, it skips all that.
+- The premultiplied alpha mode (32bit only) decodes the same way, the colors get multiplied by their alpha while the
+	row is decoded & divided back (a reciprocal table) while the output is encoded, so the fully transparent pixels,
+	whatever color they hold, don't bleed into their neighbours.
+- The layout of the result can differ from the source, it is done by the store step rather than by passes of its own.
+	The rows order is just a negative destination stride. The depth (24 <-> 32, to 8bit gray), the red & blue swap and
+	the mirrored columns are a kernel writing its tile row into the cache, then that row going to the destination
+	converted, so the pixels are touched once, while they are still hot.
+*/
+
+//Where the first pixel of a result is, by default wherever the source has it
+enum EOutputOrigin
+{
+	KeepOrigin,
+	BottomLeft,
+	TopLeft
+};
+
+//How a resize filters, picked from the command line & handed down to whichever format does the resize
+struct ResampleSettings
+{
+	EResampleFilter m_Filter;					//bilinear by default, which is the box for 1/2, 1/4 & 1/8
+	bool m_Linear;								//gamma correct, the filter runs on the linear light values
+	bool m_Premultiplied;						//the colors are weighted by their alpha while filtering (32bit only)
+	int m_OutputDepth;							//8, 24 or 32 bits for the result pixels, 0 keeps the source depth
+	EOutputOrigin m_Origin;						//the formats turn it into the flips of the store step, raw pixels are taken as top-left
+	bool m_SwapRedBlue;							//RGB(A) instead of BGR(A), for the raw pixels only, the files are always BGR
+
+	ResampleSettings() : m_Filter(EResampleFilter::Bilinear), m_Linear(false), m_Premultiplied(false), m_OutputDepth(0), m_Origin(EOutputOrigin::KeepOrigin), m_SwapRedBlue(false) {}
+
+	//The pixel format of the result of a source in format
+	EPixelFormat OutputFormat(EPixelFormat format) const
+	{
+		return m_OutputDepth == 0 ? format : ImageBuffer::FromDepth(m_OutputDepth);
+	}
+};
+
+//A tap along one axis, the output takes (1 - m_Weight) from m_Index0 and m_Weight from m_Index1
+//For the box & the convolutions it is the first & last source index the output reads, no weight
+struct ResampleTap
+{
+	int m_Index0;
+	int m_Index1;
+	float m_Weight;
+};
+
+//The horizontally resampled source rows [tileWidth * channels] one tile works with & which source row each slot holds
+struct ResampleRowCache
+{
+	std::vector<float> m_Rows[2];
+	std::vector<int16_t> m_FixedRows[2];
+	std::vector<uint16_t> m_BoxSums;			//the box filter keeps no rows, just the sums of the block rows
+	std::vector<uint32_t> m_DecodedBoxSums;		//the same for the decoded box, 12bit values overflow 16bit sums past a 4 x 4 block
+	int m_CachedRow[2];
+
+	//the convolutions, a ring of horizontally filtered rows, source row r in slot r % ring size
+	std::vector<std::vector<int16_t>> m_ConvolutionRows;
+	std::vector<int> m_ConvolutionRowIds;
+	std::vector<const int16_t*> m_ConvolutionRowPointers;	//the rows of the current output, in taps order
+	std::vector<int16_t> m_DecodedRow;			//the decoded (linear and/or premultiplied) source pixels the columns of the tile read
+	std::vector<uint8_t> m_StoreRow;			//an output row in the source format, before the store step converts it into the destination
+};
+
+//A block of output rows [m_Y0, m_Y1) & columns [m_X0, m_X1), the unit of work the pool runs
+struct ResampleTile
+{
+	int m_X0;
+	int m_X1;
+	int m_Y0;
+	int m_Y1;
+};
+
+class Resampler;
+typedef void(Resampler::*ResampleTileFunction)(const ResampleTile &tile, ResampleRowCache &cache);
+
+//The store step of a converting resize, count pixels to out, which moves by step bytes a pixel (negative for mirrored columns)
+typedef void(*ResampleStoreFunction)(const uint8_t *pixels, int count, uint8_t *out, int step, bool swapRedBlue);
+
+class Resampler
+{
+public:
+	std::vector<ResampleTap> m_ColumnTaps;
+	std::vector<ResampleTap> m_RowTaps;
+
+	//the fixed point version of the column taps & how many of them are safe for the SIMD kernels
+	std::vector<FixedTap> m_FixedColumnTaps;
+	int m_SimdColumns;
+
+	//the source & destination can be windows of the whole images, starting at these rows
+	const uint8_t *m_Source;
+	long m_SourceStride;
+	int m_SourceFirstRow;
+	uint8_t *m_Destination;
+	long m_DestinationStride;
+	int m_DestinationFirstRow;
+	EPixelFormat m_Format;
+	int m_Channels;
+
+	//the layout of the output, the store step gets the kernels output there
+	EPixelFormat m_OutputFormat;
+	int m_OutputChannels;
+	bool m_FlipRows;							//the last output row is stored first
+	bool m_MirrorColumns;						//the last output column is stored first
+	bool m_SwapRedBlue;
+	ResampleStoreFunction m_Store;				//NULL when the kernels write straight into the destination
+
+	EResampleKernel m_Kernel;
+	EResampleFilter m_Filter;
+	int m_BoxFactor;							//the k of a k x k box, 0 when the filter isn't the box
+	bool m_Linear;								//filter the linear light values instead of the sRGB ones
+	bool m_Premultiplied;						//filter the colors premultiplied by their alpha
+	std::shared_ptr<const FilterWeights> m_ColumnWeights;
+	std::shared_ptr<const FilterWeights> m_RowWeights;
+	ResampleKernels m_Kernels;
+	ResampleTileFunction m_ResizeTile;				//the tile loop compiled for the format & filter of the image
+
+	//threads to split a single image on, 0 means the whole pool
+	unsigned int m_Threads;
+
+	Resampler() : Resampler(USE_SIMD_KERNELS == 1 ? ResampleKernels::Detect() : EResampleKernel::Reference) {}
+	Resampler(EResampleKernel kernel) : m_FlipRows(false), m_MirrorColumns(false), m_SwapRedBlue(false), m_Store(NULL),
+		m_Kernel(kernel), m_Filter(EResampleFilter::Bilinear), m_BoxFactor(0), m_Linear(false), m_Premultiplied(false), m_Kernels(kernel), m_ResizeTile(NULL), m_Threads(0) {}
+	~Resampler() {}
+
+	/*
+	Builds the taps of one axis, it has to match the old per-pixel math exactly:
+		_horizontal = x / (dst - 1)
+		_w = _horizontal * src
+		index = int(_w) & weight = _w - floor(_w)
+	and the neighbours clamped into [0, src - 1]
+	*/
+	static void BuildTaps(std::vector<ResampleTap> &taps, int srcSize, int dstSize)
+	{
+		taps.resize(dstSize);
+
+		for (int i = 0; i < dstSize; i++)
+		{
+			//a single pixel output would divide by zero, so it just takes the first pixel
+			float _normalized = dstSize > 1 ? float(i) / float(dstSize - 1) : 0.0f;
+			float _position = _normalized * srcSize;
+
+			int _index = int(_position);
+			int _index0 = _index;
+			int _index1 = _index + 1;
+			CLAMP(_index0, 0, srcSize - 1);
+			CLAMP(_index1, 0, srcSize - 1);
+
+			taps[i].m_Index0 = _index0;
+			taps[i].m_Index1 = _index1;
+			taps[i].m_Weight = _position - floor(_position);
+		}
+	}
+
+	//The box taps, output i averages the source [i * factor, i * factor + factor - 1]
+	static void BuildBoxTaps(std::vector<ResampleTap> &taps, int dstSize, int factor)
+	{
+		taps.resize(dstSize);
+
+		for (int i = 0; i < dstSize; i++)
+		{
+			taps[i].m_Index0 = i * factor;
+			taps[i].m_Index1 = i * factor + factor - 1;
+			taps[i].m_Weight = 0.0f;
+		}
+	}
+
+	//The k of a resize multiplier that is exactly 1/2, 1/4 or 1/8, 0 for anything else
+	static int BoxFactor(float resizeMultiplier)
+	{
+		if (resizeMultiplier == 0.5f)
+			return 2;
+		if (resizeMultiplier == 0.25f)
+			return 4;
+		if (resizeMultiplier == 0.125f)
+			return 8;
+		return 0;
+	}
+
+	//The filter for a resize, bilinear turns into the box for the integer downscales, the others are taken as they are
+	//(the box itself only exists for the integer downscales, anything else asking for it gets bilinear)
+	void SelectFilter(float resizeMultiplier, EResampleFilter filter = EResampleFilter::Bilinear)
+	{
+		bool _box = filter == EResampleFilter::Box || (filter == EResampleFilter::Bilinear && USE_BOX_DOWNSCALE == 1);
+		m_BoxFactor = _box ? BoxFactor(resizeMultiplier) : 0;
+		if (m_BoxFactor != 0)
+			m_Filter = EResampleFilter::Box;
+		else
+			m_Filter = filter == EResampleFilter::Box ? EResampleFilter::Bilinear : filter;
+	}
+
+	//The filter & the modes of a resize, before Prepare()
+	void Configure(float resizeMultiplier, const ResampleSettings &settings)
+	{
+		SelectFilter(resizeMultiplier, settings.m_Filter);
+		m_Linear = settings.m_Linear;
+		m_Premultiplied = settings.m_Premultiplied;
+	}
+
+	//The rows & columns order of the output & its channels order, before Prepare(). The formats work out the flips from their headers
+	void Orient(bool flipRows, bool mirrorColumns, bool swapRedBlue)
+	{
+		m_FlipRows = flipRows;
+		m_MirrorColumns = mirrorColumns;
+		m_SwapRedBlue = swapRedBlue;
+	}
+
+	//Linear light and/or premultiplied alpha, the filters run on decoded rows (nearest never blends, it has no use for it)
+	bool IsDecoded() const
+	{
+		if (m_Filter == EResampleFilter::Nearest)
+			return false;
+		return m_Linear || (m_Premultiplied && m_Format == EPixelFormat::BGRA32);
+	}
+
+	//Pixel centers lined up, output i takes the source pixel its center falls in
+	static void BuildNearestTaps(std::vector<ResampleTap> &taps, int srcSize, int dstSize)
+	{
+		taps.resize(dstSize);
+
+		for (int i = 0; i < dstSize; i++)
+		{
+			int _index = int((i + 0.5) * srcSize / dstSize);
+			CLAMP(_index, 0, srcSize - 1);
+			taps[i].m_Index0 = _index;
+			taps[i].m_Index1 = _index;
+			taps[i].m_Weight = 0.0f;
+		}
+	}
+
+	//The window every output reads, so the tiles & the streaming windows work the same for the convolutions
+	static void BuildWindowTaps(std::vector<ResampleTap> &taps, const FilterWeights &weights)
+	{
+		taps.resize(weights.m_First.size());
+
+		for (size_t i = 0; i < taps.size(); i++)
+		{
+			taps[i].m_Index0 = weights.m_First[i];
+			taps[i].m_Index1 = weights.m_First[i] + weights.m_Taps - 1;
+			taps[i].m_Weight = 0.0f;
+		}
+	}
+
+	void BuildFixedTaps(int srcWidth)
+	{
+		m_FixedColumnTaps.resize(m_ColumnTaps.size());
+		m_SimdColumns = 0;
+
+		for (size_t i = 0; i < m_ColumnTaps.size(); i++)
+		{
+			m_FixedColumnTaps[i].m_Offset0 = m_ColumnTaps[i].m_Index0 * m_Channels;
+			m_FixedColumnTaps[i].m_Offset1 = m_ColumnTaps[i].m_Index1 * m_Channels;
+			m_FixedColumnTaps[i].m_Weights = PackFixedWeights(m_ColumnTaps[i].m_Weight);
+
+			//the 24bit SIMD kernels load 4 bytes per pixel, the last pixel of the row would read past its end
+			//taps are sorted, so the safe ones are all at the start
+			if (m_Channels != 3 || m_ColumnTaps[i].m_Index1 < srcWidth - 1)
+				m_SimdColumns = int(i) + 1;
+		}
+	}
+
+	/*
+	Splits the output into row bands, and very wide images into 2D tiles too, so there is enough
+	work to balance across the pool without every band paying for a full width horizontal pass.
+	*/
+	static void BuildTiles(std::vector<ResampleTile> &tiles, int dstWidth, int y0, int y1, unsigned int threads)
+	{
+		tiles.clear();
+
+		int _tileWidth = dstWidth;
+		if (dstWidth > RESIZE_TILE_MAX_WIDTH)
+			_tileWidth = RESIZE_TILE_MAX_WIDTH / 2;
+
+		//a few bands per thread keeps the stealing useful, but a band is never less rows than it is worth
+		int _bands = int(threads) * RESIZE_BANDS_PER_THREAD;
+		int _bandHeight = (y1 - y0 + _bands - 1) / _bands;
+		if (_bandHeight < RESIZE_MIN_BAND_ROWS)
+			_bandHeight = RESIZE_MIN_BAND_ROWS;
+
+		for (int y = y0; y < y1; y += _bandHeight)
+		{
+			for (int x = 0; x < dstWidth; x += _tileWidth)
+			{
+				ResampleTile _tile;
+				_tile.m_X0 = x;
+				_tile.m_X1 = (dstWidth - x > _tileWidth) ? x + _tileWidth : dstWidth;
+				_tile.m_Y0 = y;
+				_tile.m_Y1 = (y1 - y > _bandHeight) ? y + _bandHeight : y1;
+				tiles.push_back(_tile);
+			}
+		}
+	}
+
+	//The horizontal pass of a single source row, for the output columns [x0, x1)
+	template<EPixelFormat Format>
+	void ResampleRow(int sourceRow, int x0, int x1, float *out)
+	{
+		const uint8_t *_row = m_Source + (sourceRow - m_SourceFirstRow) * m_SourceStride;
+		const ResampleTap *_tap = m_ColumnTaps.data() + x0;
+
+		const int _channels = PixelTraits<Format>::Channels;
+
+		for (int x = x0; x < x1; x++, _tap++)
+		{
+			const uint8_t *_left = _row + _tap->m_Index0 * _channels;
+			const uint8_t *_right = _row + _tap->m_Index1 * _channels;
+			const float _weight = _tap->m_Weight;
+
+			for (int i = 0; i < _channels; i++)
+			{
+				LERP(_left[i], _right[i], out[i], _weight);
+			}
+			out += _channels;
+		}
+	}
+
+	//The fixed point horizontal pass, the SIMD kernel takes the safe columns & the scalar one finishes the row
+	void ResampleFixedRow(int sourceRow, int x0, int x1, int16_t *out)
+	{
+		const uint8_t *_row = m_Source + (sourceRow - m_SourceFirstRow) * m_SourceStride;
+
+		int _simd = m_SimdColumns - x0;
+		CLAMP(_simd, 0, x1 - x0);
+
+		m_Kernels.m_Horizontal(_row, m_FixedColumnTaps.data() + x0, _simd, out);
+		m_Kernels.m_HorizontalScalar(_row, m_FixedColumnTaps.data() + x0 + _simd, x1 - x0 - _simd, out + _simd * m_Channels);
+	}
+
+	//The decoded bilinear horizontal pass, the source pixels the columns read get decoded once, then lerped from there
+	void ResampleDecodedRow(int sourceRow, int x0, int x1, ResampleRowCache &cache, int16_t *out)
+	{
+		const uint8_t *_row = m_Source + (sourceRow - m_SourceFirstRow) * m_SourceStride;
+		const int _origin = m_ColumnTaps[x0].m_Index0;
+		const int _count = m_ColumnTaps[x1 - 1].m_Index1 - _origin + 1;
+
+		//the 24bit SIMD kernel reads an int16 past the last pixel
+		cache.m_DecodedRow.resize(size_t(_count) * m_Channels + 1);
+		m_Kernels.m_Decode(_row + size_t(_origin) * m_Channels, _count, cache.m_DecodedRow.data());
+		m_Kernels.m_DecodedHorizontal(cache.m_DecodedRow.data(), _origin * m_Channels, m_FixedColumnTaps.data() + x0, x1 - x0, out);
+	}
+
+	//Returns the cache slot holding the horizontally resampled sourceRow, without evicting the slot that holds keepRow
+	template<EPixelFormat Format, bool Fixed, bool Decoded>
+	int FetchRow(ResampleRowCache &cache, const ResampleTile &tile, int sourceRow, int keepRow)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			if (cache.m_CachedRow[i] == sourceRow)
+				return i;
+		}
+
+		int _slot = (cache.m_CachedRow[0] == keepRow) ? 1 : 0;
+		if (Decoded)
+			ResampleDecodedRow(sourceRow, tile.m_X0, tile.m_X1, cache, cache.m_FixedRows[_slot].data());
+		else if (Fixed)
+			ResampleFixedRow(sourceRow, tile.m_X0, tile.m_X1, cache.m_FixedRows[_slot].data());
+		else
+			ResampleRow<Format>(sourceRow, tile.m_X0, tile.m_X1, cache.m_Rows[_slot].data());
+		cache.m_CachedRow[_slot] = sourceRow;
+
+		return _slot;
+	}
+
+	//Where the first pixel of a tile goes, a mirrored tile lands at the other end of the row
+	uint8_t* TileDestination(const ResampleTile &tile) const
+	{
+		const int _column = m_MirrorColumns ? int(m_ColumnTaps.size()) - tile.m_X1 : tile.m_X0;
+		return m_Destination + (tile.m_Y0 - m_DestinationFirstRow) * m_DestinationStride + size_t(_column) * m_OutputChannels;
+	}
+
+	//The row a kernel writes its output into, the destination itself unless the store step has a conversion to do
+	uint8_t* StoreTarget(ResampleRowCache &cache, const ResampleTile &tile, uint8_t *destination)
+	{
+		if (m_Store == NULL)
+			return destination;
+		cache.m_StoreRow.resize(size_t(tile.m_X1 - tile.m_X0) * m_Channels);
+		return cache.m_StoreRow.data();
+	}
+
+	//The store step, the row the kernel just wrote (a tile wide, still in the cache) converted into the destination
+	void Store(const ResampleTile &tile, const uint8_t *row, uint8_t *destination)
+	{
+		if (m_Store == NULL)
+			return;
+		const int _count = tile.m_X1 - tile.m_X0;
+		if (m_MirrorColumns)
+			m_Store(row, _count, destination + (_count - 1) * m_OutputChannels, -m_OutputChannels, m_SwapRedBlue);
+		else
+			m_Store(row, _count, destination, m_OutputChannels, m_SwapRedBlue);
+	}
+
+	/*
+	A pixel from In to Out, the channels reordered, the alpha dropped or made opaque & the colors to gray by their luma
+	(BT.601, 0.114 B + 0.587 G + 0.299 R in 8bit fixed point), the format checks are all compile time.
+	*/
+	template<EPixelFormat In, EPixelFormat Out>
+	static void StorePixels(const uint8_t *pixels, int count, uint8_t *out, int step, bool swapRedBlue)
+	{
+		const int _channels = PixelTraits<In>::Channels;
+		const int _blue = swapRedBlue ? 2 : 0;
+		const int _red = swapRedBlue ? 0 : 2;
+
+		for (int x = 0; x < count; x++, pixels += _channels, out += step)
+		{
+			if (Out == EPixelFormat::Gray8)
+			{
+				out[0] = In == EPixelFormat::Gray8 ? pixels[0] : uint8_t((pixels[0] * 29 + pixels[1] * 150 + pixels[2] * 77 + 128) >> 8);
+				continue;
+			}
+
+			if (In == EPixelFormat::Gray8)
+			{
+				out[0] = pixels[0];
+				out[1] = pixels[0];
+				out[2] = pixels[0];
+			}
+			else
+			{
+				out[_blue] = pixels[0];
+				out[1] = pixels[1];
+				out[_red] = pixels[2];
+			}
+			if (Out == EPixelFormat::BGRA32)
+				out[3] = PixelTraits<In>::HasAlpha ? pixels[PixelTraits<In>::AlphaIndex] : 255;
+		}
+	}
+
+	template<EPixelFormat In>
+	static ResampleStoreFunction SelectStore(EPixelFormat output)
+	{
+		if (output == EPixelFormat::Gray8)
+			return &Resampler::StorePixels<In, EPixelFormat::Gray8>;
+		if (output == EPixelFormat::BGRA32)
+			return &Resampler::StorePixels<In, EPixelFormat::BGRA32>;
+		return &Resampler::StorePixels<In, EPixelFormat::BGR24>;
+	}
+
+	//Every output row only depends on the source, so tiles can run in any order & on any thread
+	template<EPixelFormat Format, EResampleFilter Filter, bool Fixed, bool Decoded>
+	void ResizeTile(const ResampleTile &tile, ResampleRowCache &cache)
+	{
+		const int _channels = PixelTraits<Format>::Channels;
+		const size_t _rowLength = size_t(tile.m_X1 - tile.m_X0) * _channels;
+		for (int i = 0; i < 2; i++)
+		{
+			cache.m_CachedRow[i] = -1;
+			if (Fixed)
+				cache.m_FixedRows[i].resize(_rowLength + 4); //the 24bit SIMD stores write one int16 past the pixel
+			else
+				cache.m_Rows[i].resize(_rowLength);
+		}
+
+		uint8_t *_currentRow = TileDestination(tile);
+		for (int y = tile.m_Y0; y < tile.m_Y1; y++)
+		{
+			const ResampleTap &_tap = m_RowTaps[y];
+
+			//the vertical pass, between the two horizontally resampled rows
+			int _top = FetchRow<Format, Fixed, Decoded>(cache, tile, _tap.m_Index0, _tap.m_Index1);
+			int _bottom = FetchRow<Format, Fixed, Decoded>(cache, tile, _tap.m_Index1, _tap.m_Index0);
+
+			uint8_t *_out = StoreTarget(cache, tile, _currentRow);
+			if (Decoded)
+				m_Kernels.m_DecodedVertical(cache.m_FixedRows[_top].data(), cache.m_FixedRows[_bottom].data(), PackFixedWeights(_tap.m_Weight), _rowLength, _out);
+			else if (Fixed)
+				m_Kernels.m_Vertical(cache.m_FixedRows[_top].data(), cache.m_FixedRows[_bottom].data(), PackFixedWeights(_tap.m_Weight), _rowLength, _out);
+			else
+				VerticalReference(cache.m_Rows[_top].data(), cache.m_Rows[_bottom].data(), _tap.m_Weight, _rowLength, _out);
+			Store(tile, _out, _currentRow);
+
+			_currentRow += m_DestinationStride;
+		}
+	}
+
+	//The box tile, every output row is the sum of its factor source rows, reduced factor pixels at a time
+	template<EPixelFormat Format, bool Decoded>
+	void ResizeBoxTile(const ResampleTile &tile, ResampleRowCache &cache)
+	{
+		if (Decoded)
+		{
+			ResizeDecodedBoxTile<Format>(tile, cache);
+			return;
+		}
+
+		const int _channels = PixelTraits<Format>::Channels;
+		const int _factor = m_BoxFactor;
+		const int _shift = _factor == 2 ? 2 : _factor == 4 ? 4 : 6;
+		const size_t _sumsLength = size_t(tile.m_X1 - tile.m_X0) * _factor * _channels;
+		cache.m_BoxSums.resize(_sumsLength);
+
+		uint8_t *_currentRow = TileDestination(tile);
+		for (int y = tile.m_Y0; y < tile.m_Y1; y++)
+		{
+			memset(cache.m_BoxSums.data(), 0, _sumsLength * sizeof(uint16_t));
+
+			const ResampleTap &_tap = m_RowTaps[y];
+			for (int _sourceRow = _tap.m_Index0; _sourceRow <= _tap.m_Index1; _sourceRow++)
+			{
+				const uint8_t *_row = m_Source + (_sourceRow - m_SourceFirstRow) * m_SourceStride + size_t(tile.m_X0) * _factor * _channels;
+				m_Kernels.m_BoxAccumulate(_row, _sumsLength, cache.m_BoxSums.data());
+			}
+
+			uint8_t *_out = StoreTarget(cache, tile, _currentRow);
+			m_Kernels.m_BoxReduce(cache.m_BoxSums.data(), tile.m_X1 - tile.m_X0, _factor, _shift, _out);
+			Store(tile, _out, _currentRow);
+			_currentRow += m_DestinationStride;
+		}
+	}
+
+	//The same on the decoded rows, each source row is decoded once into the cache & summed in uint32
+	template<EPixelFormat Format>
+	void ResizeDecodedBoxTile(const ResampleTile &tile, ResampleRowCache &cache)
+	{
+		const int _channels = PixelTraits<Format>::Channels;
+		const int _factor = m_BoxFactor;
+		const int _shift = _factor == 2 ? 2 : _factor == 4 ? 4 : 6;
+		const int _pixels = (tile.m_X1 - tile.m_X0) * _factor;
+		const size_t _sumsLength = size_t(_pixels) * _channels;
+		cache.m_DecodedBoxSums.resize(_sumsLength);
+		cache.m_DecodedRow.resize(_sumsLength);
+
+		uint8_t *_currentRow = TileDestination(tile);
+		for (int y = tile.m_Y0; y < tile.m_Y1; y++)
+		{
+			memset(cache.m_DecodedBoxSums.data(), 0, _sumsLength * sizeof(uint32_t));
+
+			const ResampleTap &_tap = m_RowTaps[y];
+			for (int _sourceRow = _tap.m_Index0; _sourceRow <= _tap.m_Index1; _sourceRow++)
+			{
+				const uint8_t *_row = m_Source + (_sourceRow - m_SourceFirstRow) * m_SourceStride + size_t(tile.m_X0) * _factor * _channels;
+				m_Kernels.m_Decode(_row, _pixels, cache.m_DecodedRow.data());
+				m_Kernels.m_DecodedBoxAccumulate(cache.m_DecodedRow.data(), _sumsLength, cache.m_DecodedBoxSums.data());
+			}
+
+			uint8_t *_out = StoreTarget(cache, tile, _currentRow);
+			m_Kernels.m_DecodedBoxReduce(cache.m_DecodedBoxSums.data(), tile.m_X1 - tile.m_X0, _factor, _shift, _out);
+			Store(tile, _out, _currentRow);
+			_currentRow += m_DestinationStride;
+		}
+	}
+
+	//The 2x2 box, the two source rows go straight to the output, no sums in between
+	template<EPixelFormat Format, bool Decoded>
+	void ResizeHalfTile(const ResampleTile &tile, ResampleRowCache &cache)
+	{
+		const int _channels = PixelTraits<Format>::Channels;
+		const size_t _sourceOffset = size_t(tile.m_X0) * 2 * _channels;
+
+		uint8_t *_currentRow = TileDestination(tile);
+		for (int y = tile.m_Y0; y < tile.m_Y1; y++)
+		{
+			const uint8_t *_top = m_Source + (m_RowTaps[y].m_Index0 - m_SourceFirstRow) * m_SourceStride + _sourceOffset;
+			uint8_t *_out = StoreTarget(cache, tile, _currentRow);
+			if (Decoded)
+				m_Kernels.m_DecodedHalve(_top, _top + m_SourceStride, tile.m_X1 - tile.m_X0, _out);
+			else
+				m_Kernels.m_BoxHalve(_top, _top + m_SourceStride, tile.m_X1 - tile.m_X0, _out);
+			Store(tile, _out, _currentRow);
+			_currentRow += m_DestinationStride;
+		}
+	}
+
+	template<EPixelFormat Format>
+	void ResizeNearestTile(const ResampleTile &tile, ResampleRowCache &cache)
+	{
+		const int _channels = PixelTraits<Format>::Channels;
+		const ResampleTap *_columns = m_ColumnTaps.data();
+
+		uint8_t *_currentRow = TileDestination(tile);
+		for (int y = tile.m_Y0; y < tile.m_Y1; y++)
+		{
+			const uint8_t *_row = m_Source + (m_RowTaps[y].m_Index0 - m_SourceFirstRow) * m_SourceStride;
+			uint8_t *_target = StoreTarget(cache, tile, _currentRow);
+			uint8_t *_out = _target;
+			for (int x = tile.m_X0; x < tile.m_X1; x++, _out += _channels)
+			{
+				const uint8_t *_pixel = _row + _columns[x].m_Index0 * _channels;
+				for (int c = 0; c < _channels; c++)
+					_out[c] = _pixel[c];
+			}
+			Store(tile, _target, _currentRow);
+			_currentRow += m_DestinationStride;
+		}
+	}
+
+	//The horizontal convolution of the columns [x0, x1), the SIMD kernel takes the safe columns & the scalar one finishes the row
+	void ConvolveRow(const uint8_t *row, int x0, int x1, int16_t *out)
+	{
+		const FilterWeights &_columns = *m_ColumnWeights;
+
+		int _simd = m_SimdColumns - x0;
+		CLAMP(_simd, 0, x1 - x0);
+
+		m_Kernels.m_ConvolveHorizontal(row, _columns.m_First.data() + x0, _columns.m_Weights.data() + size_t(x0) * _columns.m_Taps, _columns.m_Taps, _simd, out);
+		m_Kernels.m_ConvolveHorizontalScalar(row, _columns.m_First.data() + x0 + _simd, _columns.m_Weights.data() + size_t(x0 + _simd) * _columns.m_Taps,
+			_columns.m_Taps, x1 - x0 - _simd, out + _simd * m_Channels);
+	}
+
+	//The linear light & premultiplied version, the source pixels the columns read get decoded once, then convolved from there
+	void ConvolveDecodedRow(const uint8_t *row, int x0, int x1, ResampleRowCache &cache, int16_t *out)
+	{
+		const FilterWeights &_columns = *m_ColumnWeights;
+		const int _origin = _columns.m_First[x0];
+		const int _count = _columns.m_First[x1 - 1] + _columns.m_Taps - _origin;
+
+		//the 24bit SIMD kernel reads an int16 past the last pixel
+		cache.m_DecodedRow.resize(size_t(_count) * m_Channels + 1);
+		m_Kernels.m_Decode(row + size_t(_origin) * m_Channels, _count, cache.m_DecodedRow.data());
+		m_Kernels.m_ConvolveDecodedHorizontal(cache.m_DecodedRow.data(), _origin, _columns.m_First.data() + x0,
+			_columns.m_Weights.data() + size_t(x0) * _columns.m_Taps, _columns.m_Taps, x1 - x0, out);
+	}
+
+	template<EPixelFormat Format, bool Decoded>
+	void ResizeConvolutionTile(const ResampleTile &tile, ResampleRowCache &cache)
+	{
+		const int _channels = PixelTraits<Format>::Channels;
+		const FilterWeights &_rows = *m_RowWeights;
+		const int _ring = _rows.m_Taps;
+		const size_t _rowLength = size_t(tile.m_X1 - tile.m_X0) * _channels;
+
+		cache.m_ConvolutionRows.resize(_ring);
+		cache.m_ConvolutionRowIds.assign(_ring, -1);
+		cache.m_ConvolutionRowPointers.resize(_ring);
+		for (int i = 0; i < _ring; i++)
+			cache.m_ConvolutionRows[i].resize(_rowLength + 1); //the 24bit SIMD stores write one int16 past the pixel
+
+		uint8_t *_currentRow = TileDestination(tile);
+		for (int y = tile.m_Y0; y < tile.m_Y1; y++)
+		{
+			const int _first = _rows.m_First[y];
+			for (int t = 0; t < _ring; t++)
+			{
+				//the windows of neighbour outputs overlap, only the rows new to the ring get filtered
+				const int _sourceRow = _first + t;
+				const int _slot = _sourceRow % _ring;
+				if (cache.m_ConvolutionRowIds[_slot] != _sourceRow)
+				{
+					const uint8_t *_row = m_Source + (_sourceRow - m_SourceFirstRow) * m_SourceStride;
+					if (Decoded)
+						ConvolveDecodedRow(_row, tile.m_X0, tile.m_X1, cache, cache.m_ConvolutionRows[_slot].data());
+					else
+						ConvolveRow(_row, tile.m_X0, tile.m_X1, cache.m_ConvolutionRows[_slot].data());
+					cache.m_ConvolutionRowIds[_slot] = _sourceRow;
+				}
+				cache.m_ConvolutionRowPointers[t] = cache.m_ConvolutionRows[_slot].data();
+			}
+
+			const int16_t *_weights = _rows.m_Weights.data() + size_t(y) * _ring;
+			uint8_t *_out = StoreTarget(cache, tile, _currentRow);
+			if (Decoded)
+				m_Kernels.m_ConvolveDecodedVertical(cache.m_ConvolutionRowPointers.data(), _weights, _ring, _rowLength, _out);
+			else
+				m_Kernels.m_ConvolveVertical(cache.m_ConvolutionRowPointers.data(), _weights, _ring, _rowLength, _out);
+			Store(tile, _out, _currentRow);
+			_currentRow += m_DestinationStride;
+		}
+	}
+
+	template<EPixelFormat Format>
+	ResampleTileFunction SelectTile() const
+	{
+		switch (m_Filter)
+		{
+		case EResampleFilter::Nearest:
+			return &Resampler::ResizeNearestTile<Format>;
+
+		case EResampleFilter::CatmullRom:
+		case EResampleFilter::Mitchell:
+		case EResampleFilter::Lanczos2:
+		case EResampleFilter::Lanczos3:
+			if (IsDecoded())
+				return &Resampler::ResizeConvolutionTile<Format, true>;
+			return &Resampler::ResizeConvolutionTile<Format, false>;
+
+		case EResampleFilter::Box:
+			//exact integer math, same bytes whatever the kernel is. Decoded, only 32bit halves in registers,
+			//the 24bit & 8bit rows keep their SIMD decode through the sums
+			if (IsDecoded())
+			{
+				if (m_BoxFactor == 2 && PixelTraits<Format>::Channels == 4)
+					return &Resampler::ResizeHalfTile<Format, true>;
+				return &Resampler::ResizeBoxTile<Format, true>;
+			}
+			if (m_BoxFactor == 2)
+				return &Resampler::ResizeHalfTile<Format, false>;
+			return &Resampler::ResizeBoxTile<Format, false>;
+
+		case EResampleFilter::Bilinear:
+		default:
+			//decoded is always fixed point, the reference has no float version of it
+			if (IsDecoded())
+				return &Resampler::ResizeTile<Format, EResampleFilter::Bilinear, true, true>;
+			if (m_Kernel == EResampleKernel::Reference)
+				return &Resampler::ResizeTile<Format, EResampleFilter::Bilinear, false, false>;
+			return &Resampler::ResizeTile<Format, EResampleFilter::Bilinear, true, false>;
+		}
+	}
+
+	//The tile loop, the kernels & the store step of a pixel format, once per image
+	void SelectFormat(EPixelFormat format, EPixelFormat outputFormat)
+	{
+		m_Format = format;
+		m_Channels = ImageBuffer::BytesPerPixel(format);
+		m_OutputFormat = outputFormat;
+		m_OutputChannels = ImageBuffer::BytesPerPixel(outputFormat);
+		m_Kernels.Select(format, m_Linear, m_Premultiplied);
+
+		//the same layout but the rows order needs no store step at all, the kernels write the destination
+		bool _converts = outputFormat != format || m_MirrorColumns || (m_SwapRedBlue && outputFormat != EPixelFormat::Gray8);
+		if (format == EPixelFormat::Gray8)
+		{
+			m_ResizeTile = SelectTile<EPixelFormat::Gray8>();
+			m_Store = _converts ? SelectStore<EPixelFormat::Gray8>(outputFormat) : NULL;
+		}
+		else if (format == EPixelFormat::BGRA32)
+		{
+			m_ResizeTile = SelectTile<EPixelFormat::BGRA32>();
+			m_Store = _converts ? SelectStore<EPixelFormat::BGRA32>(outputFormat) : NULL;
+		}
+		else
+		{
+			m_ResizeTile = SelectTile<EPixelFormat::BGR24>();
+			m_Store = _converts ? SelectStore<EPixelFormat::BGR24>(outputFormat) : NULL;
+		}
+	}
+
+	void Prepare(int srcWidth, int srcHeight, int dstWidth, int dstHeight, EPixelFormat format)
+	{
+		Prepare(srcWidth, srcHeight, dstWidth, dstHeight, format, format);
+	}
+
+	//Builds the tap tables once for a source -> destination size, before any Run(). The output can be in a pixel format of its own
+	void Prepare(int srcWidth, int srcHeight, int dstWidth, int dstHeight, EPixelFormat format, EPixelFormat outputFormat)
+	{
+		//the box blocks have to fit in the source, sizes that don't come from 1/k of it go bilinear
+		if (m_Filter == EResampleFilter::Box && (dstWidth * m_BoxFactor > srcWidth || dstHeight * m_BoxFactor > srcHeight))
+		{
+			m_Filter = EResampleFilter::Bilinear;
+			m_BoxFactor = 0;
+		}
+
+		SelectFormat(format, outputFormat);
+
+		if (m_Filter == EResampleFilter::Box)
+		{
+			BuildBoxTaps(m_ColumnTaps, dstWidth, m_BoxFactor);
+			BuildBoxTaps(m_RowTaps, dstHeight, m_BoxFactor);
+			return;
+		}
+
+		//nearest never blends, it is the same in linear light & premultiplied
+		if (m_Filter == EResampleFilter::Nearest)
+		{
+			BuildNearestTaps(m_ColumnTaps, srcWidth, dstWidth);
+			BuildNearestTaps(m_RowTaps, srcHeight, dstHeight);
+			return;
+		}
+
+		if (ResampleFilters::IsConvolution(m_Filter))
+		{
+			m_ColumnWeights = FilterWeightsCache::Get().Acquire(m_Filter, srcWidth, dstWidth);
+			m_RowWeights = FilterWeightsCache::Get().Acquire(m_Filter, srcHeight, dstHeight);
+			BuildWindowTaps(m_ColumnTaps, *m_ColumnWeights);
+			BuildWindowTaps(m_RowTaps, *m_RowWeights);
+
+			//same as the bilinear taps, a 24bit window ending on the last pixel of the row stays out of the SIMD kernel
+			m_SimdColumns = 0;
+			for (size_t i = 0; i < m_ColumnTaps.size(); i++)
+			{
+				if (m_Channels != 3 || m_ColumnTaps[i].m_Index1 < srcWidth - 1)
+					m_SimdColumns = int(i) + 1;
+			}
+			return;
+		}
+
+		BuildTaps(m_ColumnTaps, srcWidth, dstWidth);
+		BuildTaps(m_RowTaps, srcHeight, dstHeight);
+
+		if (m_Kernel != EResampleKernel::Reference || IsDecoded())
+			BuildFixedTaps(srcWidth);
+	}
+
+	//The first & last source rows the output rows [y0, y1) read, the window Run() needs loaded
+	void SourceRows(int y0, int y1, int &first, int &last) const
+	{
+		first = m_RowTaps[y0].m_Index0;
+		last = m_RowTaps[y1 - 1].m_Index1;
+	}
+
+	/*
+	Resamples the output rows [y0, y1). src holds the source rows from srcFirstRow on (at least the
+	SourceRows() window) & dst is where output row y0 goes, dstStride is negative for flipped rows.
+	*/
+	void Run(const uint8_t *src, long srcStride, int srcFirstRow, uint8_t *dst, long dstStride, int y0, int y1)
+	{
+		m_Source = src;
+		m_SourceStride = srcStride;
+		m_SourceFirstRow = srcFirstRow;
+		m_Destination = dst;
+		m_DestinationStride = dstStride;
+		m_DestinationFirstRow = y0;
+		PROFILE_COUNT(PixelsProduced, size_t(y1 - y0) * m_ColumnTaps.size());
+
+		ThreadPool &_pool = ThreadPool::Get();
+		unsigned int _threads = (m_Threads == 0 || m_Threads > _pool.ThreadsCount()) ? _pool.ThreadsCount() : m_Threads;
+
+		std::vector<ResampleTile> _tiles;
+		BuildTiles(_tiles, int(m_ColumnTaps.size()), y0, y1, _threads);
+
+		if (_threads == 1 || _tiles.size() == 1)
+		{
+			ResampleRowCache _cache;
+			for (size_t i = 0; i < _tiles.size(); i++)
+				(this->*m_ResizeTile)(_tiles[i], _cache);
+			return;
+		}
+
+		_pool.ParallelFor(int(_tiles.size()), [this, &_tiles](int i)
+		{
+			ResampleRowCache _cache;
+			(this->*m_ResizeTile)(_tiles[i], _cache);
+		});
+	}
+
+	/*
+	Resize the source pixels into the destination pixels, both are interleaved in the same pixel format.
+	Strides are in bytes, the destination is expected to be allocated already.
+	*/
+	void Resize(const uint8_t *src, int srcWidth, int srcHeight, long srcStride,
+		uint8_t *dst, int dstWidth, int dstHeight, long dstStride, EPixelFormat format)
+	{
+		Resize(src, srcWidth, srcHeight, srcStride, dst, dstWidth, dstHeight, dstStride, format, format);
+	}
+
+	//Same as above, the destination in a pixel format of its own
+	void Resize(const uint8_t *src, int srcWidth, int srcHeight, long srcStride,
+		uint8_t *dst, int dstWidth, int dstHeight, long dstStride, EPixelFormat format, EPixelFormat outputFormat)
+	{
+		Prepare(srcWidth, srcHeight, dstWidth, dstHeight, format, outputFormat);
+		if (m_FlipRows && dstHeight > 0)
+			Run(src, srcStride, 0, dst + size_t(dstHeight - 1) * dstStride, -dstStride, 0, dstHeight);
+		else
+			Run(src, srcStride, 0, dst, dstStride, 0, dstHeight);
+	}
+
+	//Same as above, the sizes, strides & formats come with the buffers
+	void Resize(const ImageBuffer &src, ImageBuffer &dst)
+	{
+		Resize(src.m_Data, src.m_Width, src.m_Height, src.m_Stride,
+			dst.m_Data, dst.m_Width, dst.m_Height, dst.m_Stride, src.m_Format, dst.m_Format);
+	}
+
+	static void VerticalReference(const float *top, const float *bottom, float weight, size_t length, uint8_t *out)
+	{
+		for (size_t i = 0; i < length; i++)
+		{
+			float _color;
+			LERP(top[i], bottom[i], _color, weight);
+			out[i] = uint8_t(_color);
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include "Macros.h"
+#include "ResizeServer.h"
+
+/*
+The client of the server mode (--client=SOCKET), to try a server out & to load it
+- Sends every input, as paths or inline bytes, up to m_Pipeline requests in flight at once.
+- The responses are read on a thread of their own, so a socket full in both directions (big inline images)
+	can't leave the two sides waiting on each other.
+- The summary has the round trip latencies seen from here, next to the server time the responses carry.
+*/
+class ResizeClient
+{
+public:
+	LocalSocket m_Socket;
+	std::string m_OutputDirectory;				//where the inline results go, empty drops them
+	std::string m_OutputExtension;				//.tga or .bmp to convert the results, empty keeps the source one
+	int m_Pipeline;
+
+	std::mutex m_InFlightLock;
+	std::condition_variable m_InFlightDone;
+	int m_InFlight;
+	bool m_Broken;								//the server went away, nothing more is sent
+
+	std::vector<std::chrono::high_resolution_clock::time_point> m_SentTimes;	//by request id
+	std::vector<std::string> m_Names;											//by request id, the inline result names
+	LatencyStats m_RoundTrip;
+	LatencyStats m_ServerTime;
+	int m_Succeeded;
+	int m_Failed;
+	uint64_t m_BytesReceived;
+
+	ResizeClient() : m_Pipeline(16), m_InFlight(0), m_Broken(false), m_Succeeded(0), m_Failed(0), m_BytesReceived(0) {}
+
+	bool Connect(const std::string &path)
+	{
+		return m_Socket.Connect(path);
+	}
+
+	bool Send(const ResizeRequest &request, const uint8_t *data, size_t size)
+	{
+		std::vector<uint8_t> _header;
+		request.PackHeader(_header, size);
+		return m_Socket.SendAll(_header.data(), _header.size()) && m_Socket.SendAll(data, size);
+	}
+
+	bool Receive(ResizeResponse &response)
+	{
+		std::vector<uint8_t> _frame;
+		return m_Socket.ReceiveFrame(_frame, size_t(SERVER_MAX_REQUEST_MB) * 1024 * 1024) && response.Parse(_frame);
+	}
+
+	//A single request & its response, for the stats & stop requests
+	bool Call(EResizeRequest kind, std::string &text)
+	{
+		ResizeRequest _request;
+		_request.m_Kind = kind;
+		ResizeResponse _response;
+		if (!Send(_request, NULL, 0) || !Receive(_response))
+			return false;
+		text = _response.Text();
+		return true;
+	}
+
+	static bool ReadFile(const std::string &path, std::vector<uint8_t> &bytes)
+	{
+		std::ifstream _file(path, std::ios::binary);
+		if (!_file)
+			return false;
+		bytes.assign(std::istreambuf_iterator<char>(_file), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	//Every input repeat times, inline ones are read once up front so only the server gets timed
+	void Run(const std::vector<std::string> &inputs, const ImageJobOptions &options, bool sendInline, int repeat)
+	{
+		namespace fs = std::experimental::filesystem;
+		std::vector<std::vector<uint8_t>> _files(sendInline ? inputs.size() : 0);
+		for (size_t i = 0; i < _files.size(); i++)
+		{
+			if (!ReadFile(inputs[i], _files[i]))
+				LOG_WARNING("Can't read " << inputs[i] << ", it goes as an empty image");
+		}
+
+		size_t _total = inputs.size() * size_t(repeat > 0 ? repeat : 1);
+		m_SentTimes.resize(_total);
+		m_Names.resize(_total);
+
+		std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
+		std::thread _receiver(&ResizeClient::ReceiveLoop, this, _total);
+
+		size_t _sent = 0;
+		for (size_t _id = 0; _id < _total; _id++)
+		{
+			const std::string &_input = inputs[_id % inputs.size()];
+			ResizeRequest _request;
+			_request.m_Id = uint32_t(_id);
+			_request.m_Kind = sendInline ? EResizeRequest::ResizeInline : EResizeRequest::ResizePath;
+			_request.SetOptions(options);
+			fs::path _output = m_OutputDirectory.empty() ? fs::path(ImageJob::ResizedPath(fs::absolute(_input).string())) : fs::absolute(fs::path(m_OutputDirectory) / fs::path(_input).filename());
+			if (!m_OutputExtension.empty())
+				_output.replace_extension(m_OutputExtension);
+			if (!sendInline)
+			{
+				_request.m_InputPath = fs::absolute(_input).string();
+				_request.m_OutputPath = _output.string();
+			}
+			else
+			{
+				const std::vector<uint8_t> &_bytes = _files[_id % inputs.size()];
+				_request.m_OutputFormat = ImageJob::FormatOf(_output.string(), ImageJob::DetectFormat(_bytes.data(), _bytes.size()));
+				if (!m_OutputDirectory.empty())
+					m_Names[_id] = _output.string();
+			}
+
+			{
+				std::unique_lock<std::mutex> _lock(m_InFlightLock);
+				m_InFlightDone.wait(_lock, [this]() { return m_InFlight < m_Pipeline || m_Broken; });
+				if (m_Broken)
+					break;
+				m_InFlight++;
+				m_SentTimes[_id] = std::chrono::high_resolution_clock::now();
+			}
+
+			const std::vector<uint8_t> *_file = sendInline ? &_files[_id % inputs.size()] : NULL;
+			if (!Send(_request, _file != NULL ? _file->data() : NULL, _file != NULL ? _file->size() : 0))
+			{
+				LOG_ERROR("The server closed the connection");
+				break;
+			}
+			_sent++;
+		}
+
+		//the responses of what never got sent won't come, the receiver is woken instead of waiting for them
+		if (_sent < _total)
+			m_Socket.Shutdown();
+		_receiver.join();
+
+		std::chrono::duration<double> _duration = std::chrono::high_resolution_clock::now() - _startTime;
+		PrintSummary(_duration.count());
+	}
+
+	void ReceiveLoop(size_t total)
+	{
+		for (size_t i = 0; i < total; i++)
+		{
+			ResizeResponse _response;
+			if (!Receive(_response) || _response.m_Id >= total)
+			{
+				std::lock_guard<std::mutex> _lock(m_InFlightLock);
+				m_Broken = true;
+				m_InFlightDone.notify_one();
+				return;
+			}
+
+			std::chrono::duration<double> _roundTrip = std::chrono::high_resolution_clock::now() - m_SentTimes[_response.m_Id];
+			m_RoundTrip.Add(uint32_t(_roundTrip.count() * 1e6));
+			m_ServerTime.Add(_response.m_Microseconds);
+
+			if (_response.m_Status != EResizeStatus::ResizeSucceeded)
+			{
+				m_Failed++;
+				LOG_ERROR("Request " << _response.m_Id << " failed: " << _response.Text());
+			}
+			else
+			{
+				m_Succeeded++;
+				m_BytesReceived += _response.m_Data.size();
+				if (!m_Names[_response.m_Id].empty())
+				{
+					std::ofstream _file(m_Names[_response.m_Id], std::ios::binary);
+					_file.write(reinterpret_cast<const char*>(_response.m_Data.data()), _response.m_Data.size());
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> _lock(m_InFlightLock);
+				m_InFlight--;
+			}
+			m_InFlightDone.notify_one();
+		}
+	}
+
+	void PrintSummary(double seconds)
+	{
+		double _seconds = seconds > 0.0 ? seconds : 1e-9;
+		LOG_FLUSH();
+		std::cout << "=================C=L=I=E=N=T===================" << "\n";
+		std::cout << "Requests: " << m_Succeeded + m_Failed << " (" << m_Succeeded << " done, " << m_Failed << " failed)" << "\n";
+		std::cout << "Time: " << seconds * 1000.0 << "ms (" << (m_Succeeded + m_Failed) / _seconds << " requests/s)" << "\n";
+		std::cout << "Round trip: " << m_RoundTrip.Summary() << "\n";
+		std::cout << "Server time: " << m_ServerTime.Summary() << "\n";
+		std::cout << "Received: " << m_BytesReceived / 1024 << "KB" << "\n";
+		std::cout << "================================================" << std::endl;
+	}
+};
\ No newline at end of file
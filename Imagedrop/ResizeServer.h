@@ -0,0 +1,468 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <functional>
+#include "Macros.h"
+#include "ByteOrder.h"
+#include "LocalSocket.h"
+#include "ThreadPool.h"
+#include "ImageJob.h"
+
+/*
+The server mode (--serve=SOCKET), a long running process resizing on request over a local socket
+- No process start per image, the pool threads, the pixel blocks pool & the filter weight tables all stay warm
+	between requests, the first request pays for them & the rest reuse them.
+- A request is either two paths (the file job, through the result cache when the server has one) or a whole
+	image inline (the in-memory job of ImageJob::Resize), the inline result comes back in the response.
+- Requests are pipelined, a client can send many before reading any response. Each connection has a reader
+	thread handing the requests to the shared pool, up to SERVER_MAX_PIPELINE in flight per connection, past
+	that the reader stops reading & the socket pushes back on the client. Responses go out as they finish,
+	matched to their request by its id, not by order.
+- Every response carries its server time (queued + run), the server keeps them all for the latency percentiles
+	(a stats request, and the summary once stopped).
+
+The frames, little endian, every one starts with the bytes count of the rest:
+	request		[u32 size][u32 id][u8 kind][u8 filter][u8 flags][u8 compression][u8 format][u8 depth][u8 origin][f32 multiplier]
+				+ path:		[u32 length][input path][u32 length][output path]
+				+ inline:	the whole image file, the result comes back as format (EImageFormat, TGA or BMP)
+	response	[u32 size][u32 id][u8 status][u32 server microseconds] + the inline result, the stats text or the error
+*/
+
+enum EResizeRequest
+{
+	ResizePath,
+	ResizeInline,
+	ServerStats,
+	ServerStop
+};
+
+enum EResizeStatus
+{
+	ResizeSucceeded,
+	ResizeFailed
+};
+
+//request flags
+#define RESIZE_FLAG_LINEAR							1
+#define RESIZE_FLAG_PREMULTIPLIED					2
+
+static const size_t resizeRequestHeaderSize = 15;
+static const size_t resizeResponseHeaderSize = 9;
+
+struct ResizeRequest
+{
+	uint32_t m_Id;
+	EResizeRequest m_Kind;
+	float m_ResizeMultiplier;
+	ResampleSettings m_Resample;
+	EOutputCompression m_Compression;
+	EImageFormat m_OutputFormat;				//inline only, a path result is in the format of its extension
+	std::string m_InputPath;
+	std::string m_OutputPath;
+
+	//the received frame, an inline image is resized right from it
+	std::vector<uint8_t> m_Frame;
+	size_t m_DataOffset;
+
+	ResizeRequest() : m_Id(0), m_Kind(EResizeRequest::ResizePath), m_ResizeMultiplier(DEFAULT_RESIZE_MULTIPLIER), m_Compression(EOutputCompression::SameAsSource), m_OutputFormat(EImageFormat::TGA), m_DataOffset(0) {}
+
+	void SetOptions(const ImageJobOptions &options)
+	{
+		m_ResizeMultiplier = options.m_ResizeMultiplier;
+		m_Resample = options.m_Resample;
+		m_Compression = options.m_Compression;
+	}
+
+	//The server side options, everything else (cache, streaming, mips) is the server's own
+	void ApplyTo(ImageJobOptions &options) const
+	{
+		options.m_ResizeMultiplier = m_ResizeMultiplier;
+		options.m_Resample = m_Resample;
+		options.m_Compression = m_Compression;
+	}
+
+	const uint8_t* Data() const
+	{
+		return m_Frame.data() + m_DataOffset;
+	}
+
+	size_t DataSize() const
+	{
+		return m_Frame.size() - m_DataOffset;
+	}
+
+	//The frame without the inline image, which goes out right after it as it is
+	void PackHeader(std::vector<uint8_t> &frame, size_t dataSize) const
+	{
+		size_t _pathsSize = m_Kind == EResizeRequest::ResizePath ? 8 + m_InputPath.size() + m_OutputPath.size() : 0;
+		frame.resize(4 + resizeRequestHeaderSize + _pathsSize);
+		uint8_t *_data = frame.data();
+
+		uint32_t _multiplier;
+		memcpy(&_multiplier, &m_ResizeMultiplier, sizeof(_multiplier));
+
+		ByteOrder::Write32(_data, uint32_t(resizeRequestHeaderSize + _pathsSize + dataSize));
+		ByteOrder::Write32(_data + 4, m_Id);
+		_data[8] = uint8_t(m_Kind);
+		_data[9] = uint8_t(m_Resample.m_Filter);
+		_data[10] = uint8_t((m_Resample.m_Linear ? RESIZE_FLAG_LINEAR : 0) | (m_Resample.m_Premultiplied ? RESIZE_FLAG_PREMULTIPLIED : 0));
+		_data[11] = uint8_t(m_Compression);
+		_data[12] = uint8_t(m_OutputFormat);
+		_data[13] = uint8_t(m_Resample.m_OutputDepth);
+		_data[14] = uint8_t(m_Resample.m_Origin);
+		ByteOrder::Write32(_data + 15, _multiplier);
+
+		if (m_Kind == EResizeRequest::ResizePath)
+		{
+			uint8_t *_paths = _data + 4 + resizeRequestHeaderSize;
+			ByteOrder::Write32(_paths, uint32_t(m_InputPath.size()));
+			memcpy(_paths + 4, m_InputPath.data(), m_InputPath.size());
+			_paths += 4 + m_InputPath.size();
+			ByteOrder::Write32(_paths, uint32_t(m_OutputPath.size()));
+			memcpy(_paths + 4, m_OutputPath.data(), m_OutputPath.size());
+		}
+	}
+
+	//Takes the frame over, false for anything malformed
+	bool Parse(std::vector<uint8_t> &frame)
+	{
+		m_Frame.swap(frame);
+		if (m_Frame.size() < resizeRequestHeaderSize)
+			return false;
+
+		const uint8_t *_data = m_Frame.data();
+		if (_data[4] > EResizeRequest::ServerStop || _data[5] > EResampleFilter::Lanczos3 || _data[7] > EOutputCompression::RLE ||
+			(_data[8] != EImageFormat::TGA && _data[8] != EImageFormat::BMP) ||
+			(_data[9] != 0 && _data[9] != 8 && _data[9] != 24 && _data[9] != 32) || _data[10] > EOutputOrigin::TopLeft)
+			return false;
+
+		uint32_t _multiplier = ByteOrder::Read32(_data + 11);
+		m_Id = ByteOrder::Read32(_data);
+		m_Kind = EResizeRequest(_data[4]);
+		m_Resample.m_Filter = EResampleFilter(_data[5]);
+		m_Resample.m_Linear = (_data[6] & RESIZE_FLAG_LINEAR) != 0;
+		m_Resample.m_Premultiplied = (_data[6] & RESIZE_FLAG_PREMULTIPLIED) != 0;
+		m_Compression = EOutputCompression(_data[7]);
+		m_OutputFormat = EImageFormat(_data[8]);
+		m_Resample.m_OutputDepth = _data[9];
+		m_Resample.m_Origin = EOutputOrigin(_data[10]);
+		memcpy(&m_ResizeMultiplier, &_multiplier, sizeof(m_ResizeMultiplier));
+		m_DataOffset = resizeRequestHeaderSize;
+
+		if (!(m_ResizeMultiplier > 0.0f))
+			return false;
+
+		if (m_Kind != EResizeRequest::ResizePath)
+			return true;
+
+		return ParsePath(m_InputPath) && ParsePath(m_OutputPath);
+	}
+
+	bool ParsePath(std::string &path)
+	{
+		if (DataSize() < 4)
+			return false;
+		uint32_t _length = ByteOrder::Read32(Data());
+		if (DataSize() - 4 < _length)
+			return false;
+		path.assign(reinterpret_cast<const char*>(Data()) + 4, _length);
+		m_DataOffset += 4 + _length;
+		return true;
+	}
+};
+
+struct ResizeResponse
+{
+	uint32_t m_Id;
+	EResizeStatus m_Status;
+	uint32_t m_Microseconds;					//server time, from the request received to its response sent
+	std::vector<uint8_t> m_Data;				//the inline result, the stats text or the error
+
+	ResizeResponse() : m_Id(0), m_Status(EResizeStatus::ResizeSucceeded), m_Microseconds(0) {}
+
+	void PackHeader(uint8_t *data) const
+	{
+		ByteOrder::Write32(data, uint32_t(resizeResponseHeaderSize + m_Data.size()));
+		ByteOrder::Write32(data + 4, m_Id);
+		data[8] = uint8_t(m_Status);
+		ByteOrder::Write32(data + 9, m_Microseconds);
+	}
+
+	bool Parse(std::vector<uint8_t> &frame)
+	{
+		if (frame.size() < resizeResponseHeaderSize)
+			return false;
+
+		m_Id = ByteOrder::Read32(frame.data());
+		m_Status = EResizeStatus(frame[4]);
+		m_Microseconds = ByteOrder::Read32(frame.data() + 5);
+		m_Data.assign(frame.begin() + resizeResponseHeaderSize, frame.end());
+		return true;
+	}
+
+	std::string Text() const
+	{
+		return std::string(m_Data.begin(), m_Data.end());
+	}
+};
+
+//Every latency of a run, the percentiles are sorted out of them when asked for
+class LatencyStats
+{
+public:
+	std::mutex m_Lock;
+	std::vector<uint32_t> m_Microseconds;
+
+	void Add(uint32_t microseconds)
+	{
+		std::lock_guard<std::mutex> _lock(m_Lock);
+		m_Microseconds.push_back(microseconds);
+	}
+
+	//"N requests, p50 Xms, p90 Xms, p99 Xms, max Xms"
+	std::string Summary()
+	{
+		std::vector<uint32_t> _sorted;
+		{
+			std::lock_guard<std::mutex> _lock(m_Lock);
+			_sorted = m_Microseconds;
+		}
+
+		std::ostringstream _summary;
+		_summary << _sorted.size() << " requests";
+		if (_sorted.empty())
+			return _summary.str();
+
+		std::sort(_sorted.begin(), _sorted.end());
+		const double _percentiles[] = { 0.5, 0.9, 0.99 };
+		const char *_names[] = { "p50", "p90", "p99" };
+		for (int i = 0; i < 3; i++)
+			_summary << ", " << _names[i] << " " << _sorted[size_t(_percentiles[i] * (_sorted.size() - 1) + 0.5)] / 1000.0 << "ms";
+		_summary << ", max " << _sorted.back() / 1000.0 << "ms";
+		return _summary.str();
+	}
+};
+
+class ResizeServer
+{
+public:
+	struct Connection
+	{
+		LocalSocket m_Socket;
+		std::mutex m_SendLock;					//one response at a time, whole
+		std::mutex m_InFlightLock;
+		std::condition_variable m_InFlightDone;
+		int m_InFlight;
+
+		Connection() : m_InFlight(0) {}
+	};
+
+	std::string m_Path;
+	ImageJobOptions m_Options;					//the server's own, the requests only set the resize settings
+	LocalSocket m_Listener;
+	std::atomic<bool> m_Stop;
+
+	std::mutex m_ConnectionsLock;
+	std::vector<std::shared_ptr<Connection>> m_Connections;
+
+	//readers & requests still running, Run() doesn't return before they are all done
+	std::mutex m_BusyLock;
+	std::condition_variable m_BusyDone;
+	int m_Busy;
+
+	LatencyStats m_Latency;
+	std::atomic<uint64_t> m_Requests;
+	std::atomic<uint64_t> m_Failed;
+
+	ResizeServer(const std::string &path, const ImageJobOptions &options)
+	{
+		m_Path = path;
+		m_Options = options;
+		m_Stop = false;
+		m_Busy = 0;
+		m_Requests = 0;
+		m_Failed = 0;
+	}
+
+	//Serves until a stop request, false if the socket can't be listened on
+	bool Run()
+	{
+		if (!m_Listener.Listen(m_Path))
+		{
+			LOG_ERROR("Can't listen on " << m_Path);
+			return false;
+		}
+		LOG("Serving on " << m_Path << " with " << ThreadPool::Get().ThreadsCount() << " threads");
+
+		while (!m_Stop)
+		{
+			std::shared_ptr<Connection> _connection(new Connection());
+			if (!m_Listener.Accept(_connection->m_Socket) || m_Stop)
+				break;
+
+			{
+				std::lock_guard<std::mutex> _lock(m_ConnectionsLock);
+				m_Connections.push_back(_connection);
+			}
+			BeginBusy();
+			std::thread(&ResizeServer::ReadLoop, this, _connection).detach();
+		}
+
+		//the readers are blocked on their sockets, waking them ends their loops
+		{
+			std::lock_guard<std::mutex> _lock(m_ConnectionsLock);
+			for (size_t i = 0; i < m_Connections.size(); i++)
+				m_Connections[i]->m_Socket.Shutdown();
+		}
+		{
+			std::unique_lock<std::mutex> _lock(m_BusyLock);
+			m_BusyDone.wait(_lock, [this]() { return m_Busy == 0; });
+		}
+
+		m_Listener.Close();
+		remove(m_Path.c_str());
+		PrintSummary();
+		return true;
+	}
+
+	//The accept is woken by a connection of our own, it's the one blocking call closing can't portably break
+	void Stop()
+	{
+		m_Stop = true;
+		LocalSocket _wake;
+		_wake.Connect(m_Path);
+	}
+
+	void BeginBusy()
+	{
+		std::lock_guard<std::mutex> _lock(m_BusyLock);
+		m_Busy++;
+	}
+
+	void EndBusy()
+	{
+		std::lock_guard<std::mutex> _lock(m_BusyLock);
+		if (--m_Busy == 0)
+			m_BusyDone.notify_all();
+	}
+
+	void ReadLoop(std::shared_ptr<Connection> connection)
+	{
+		std::vector<uint8_t> _frame;
+		while (connection->m_Socket.ReceiveFrame(_frame, size_t(SERVER_MAX_REQUEST_MB) * 1024 * 1024))
+		{
+			std::chrono::high_resolution_clock::time_point _received = std::chrono::high_resolution_clock::now();
+			std::shared_ptr<ResizeRequest> _request(new ResizeRequest());
+			if (!_request->Parse(_frame))
+			{
+				//the stream can't be trusted past a broken frame
+				LOG_WARNING("Malformed request, closing the connection");
+				break;
+			}
+
+			if (_request->m_Kind == EResizeRequest::ServerStats || _request->m_Kind == EResizeRequest::ServerStop)
+			{
+				ResizeResponse _response;
+				_response.m_Id = _request->m_Id;
+				std::string _text = m_Latency.Summary() + ", " + std::to_string(uint64_t(m_Failed)) + " failed";
+				_response.m_Data.assign(_text.begin(), _text.end());
+				Send(*connection, _response);
+				if (_request->m_Kind == EResizeRequest::ServerStop)
+				{
+					Stop();
+					break;
+				}
+				continue;
+			}
+
+			//past the pipeline depth the reader waits, the socket fills up & the client slows down
+			{
+				std::unique_lock<std::mutex> _lock(connection->m_InFlightLock);
+				connection->m_InFlightDone.wait(_lock, [&connection]() { return connection->m_InFlight < SERVER_MAX_PIPELINE; });
+				connection->m_InFlight++;
+			}
+
+			BeginBusy();
+			std::function<void()> _task = [this, connection, _request, _received]()
+			{
+				Handle(*connection, *_request, _received);
+				{
+					std::lock_guard<std::mutex> _lock(connection->m_InFlightLock);
+					connection->m_InFlight--;
+				}
+				connection->m_InFlightDone.notify_one();
+				EndBusy();
+			};
+
+			//a pool of 1 thread has no workers to pick the task up
+			if (ThreadPool::Get().ThreadsCount() > 1)
+				ThreadPool::Get().Submit(_task);
+			else
+				_task();
+		}
+
+		{
+			std::lock_guard<std::mutex> _lock(m_ConnectionsLock);
+			m_Connections.erase(std::remove(m_Connections.begin(), m_Connections.end(), connection), m_Connections.end());
+		}
+		EndBusy();
+	}
+
+	void Handle(Connection &connection, const ResizeRequest &request, std::chrono::high_resolution_clock::time_point received)
+	{
+		ImageJobOptions _options = m_Options;
+		request.ApplyTo(_options);
+
+		ResizeResponse _response;
+		_response.m_Id = request.m_Id;
+		try
+		{
+			if (request.m_Kind == EResizeRequest::ResizeInline)
+				ImageJob::Resize(request.Data(), request.DataSize(), request.m_OutputFormat, _response.m_Data, _options);
+			else
+				ImageJob::Run(request.m_InputPath, request.m_OutputPath, _options);
+		}
+		catch (const std::exception &_exception)
+		{
+			m_Failed++;
+			std::string _error = _exception.what();
+			_response.m_Status = EResizeStatus::ResizeFailed;
+			_response.m_Data.assign(_error.begin(), _error.end());
+		}
+
+		std::chrono::duration<double> _duration = std::chrono::high_resolution_clock::now() - received;
+		_response.m_Microseconds = uint32_t(_duration.count() * 1e6);
+		m_Requests++;
+		m_Latency.Add(_response.m_Microseconds);
+		Send(connection, _response);
+	}
+
+	//A client gone away only loses its responses, the server carries on
+	void Send(Connection &connection, const ResizeResponse &response)
+	{
+		uint8_t _header[4 + resizeResponseHeaderSize];
+		response.PackHeader(_header);
+
+		std::lock_guard<std::mutex> _lock(connection.m_SendLock);
+		if (connection.m_Socket.SendAll(_header, sizeof(_header)))
+			connection.m_Socket.SendAll(response.m_Data.data(), response.m_Data.size());
+	}
+
+	void PrintSummary()
+	{
+		LOG_FLUSH();
+		std::cout << "=================S=E=R=V=E=R===================" << "\n";
+		std::cout << "Requests: " << m_Requests << " (" << m_Failed << " failed)" << "\n";
+		std::cout << "Latency: " << m_Latency.Summary() << "\n";
+		std::cout << "================================================" << std::endl;
+	}
+};
\ No newline at end of file
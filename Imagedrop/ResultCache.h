@@ -0,0 +1,196 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include "Macros.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+/*
+The on-disk result cache (--cache=DIR), the same input resized the same way is never resized twice
+- The key is the XXH64 of the input bytes, seeded again with the resize parameters (multiplier, filter, linear,
+	premultiplied, compression & the output format), so a changed pixel or a changed setting is a miss.
+- A hit hard-links the cached result to the output path (a copy where links aren't possible, another drive, ...),
+	no decode nor resample at all. A miss runs the job & copies its result into the cache.
+- The output path is removed before anything gets written to it, so a linked result is never written through.
+- The cache is bounded (--cache-max-mb), least recently used first out. A hit touches the mtime of its entry,
+	so the recency survives between runs, Trim() deletes the oldest entries once the run is over.
+- The entries are written under a temp name & renamed, two jobs storing the same key can't leave half a file.
+*/
+
+//Goes into every key, a change to the resampling output bumps it & the old entries just stop hitting
+#define RESULT_CACHE_VERSION						1
+
+class ResultCache
+{
+public:
+	std::string m_Directory;
+	uint64_t m_MaxBytes;
+
+	std::atomic<int> m_Hits;
+	std::atomic<int> m_Misses;
+	std::atomic<int> m_Evictions;
+	std::atomic<uint64_t> m_BytesSaved;			//result bytes that came from the cache
+	std::atomic<unsigned int> m_TempCounter;
+
+	ResultCache(const std::string &directory, uint64_t maxBytes)
+	{
+		m_Directory = directory;
+		m_MaxBytes = maxBytes;
+		m_Hits = 0;
+		m_Misses = 0;
+		m_Evictions = 0;
+		m_BytesSaved = 0;
+		m_TempCounter = 0;
+
+		std::error_code _error;
+		std::experimental::filesystem::create_directories(m_Directory, _error);
+	}
+
+	//The hash of a whole file, straight from its mapping, 0 if it can't be read
+	static uint64_t HashFile(const std::string &path, uint64_t seed)
+	{
+		MappedFile _mapping;
+		if (_mapping.Open(path.c_str()))
+			return Hash::XXH64(_mapping.m_Data, _mapping.m_Size, seed);
+
+		//no mapping (an empty file, ...), the plain read of it
+		FILE *_file;
+		fopen_s(&_file, path.c_str(), "rb");
+		if (_file == NULL)
+			return 0;
+		std::vector<uint8_t> _bytes;
+		uint8_t _chunk[4096];
+		size_t _read;
+		while ((_read = fread(_chunk, 1, sizeof(_chunk), _file)) > 0)
+			_bytes.insert(_bytes.end(), _chunk, _chunk + _read);
+		fclose(_file);
+		return Hash::XXH64(_bytes.data(), _bytes.size(), seed);
+	}
+
+	//The cache file of an input & its parameters, the output extension is kept so the entry is a valid image itself
+	std::string EntryPath(const std::string &inputPath, const std::string &parameters, const std::string &outputPath)
+	{
+		PROFILE_SCOPE("hash");
+		uint64_t _key = Hash::XXH64(parameters.data(), parameters.size(), HashFile(inputPath, 0));
+
+		char _name[17];
+		sprintf_s(_name, "%016llx", (unsigned long long)_key);
+
+		std::experimental::filesystem::path _path = m_Directory;
+		_path /= std::string(_name) + std::experimental::filesystem::path(outputPath).extension().string();
+		return _path.string();
+	}
+
+	//Puts the cached result at the output path, false on a miss
+	bool Fetch(const std::string &entryPath, const std::string &outputPath)
+	{
+		namespace fs = std::experimental::filesystem;
+		std::error_code _error;
+		uint64_t _size = fs::file_size(entryPath, _error);
+		if (_error)
+		{
+			m_Misses++;
+			return false;
+		}
+
+		fs::remove(outputPath, _error);
+		_error.clear();
+		fs::create_hard_link(entryPath, outputPath, _error);
+		if (_error)
+		{
+			_error.clear();
+			fs::copy_file(entryPath, outputPath, fs::copy_options::overwrite_existing, _error);
+			if (_error)
+			{
+				m_Misses++;
+				return false;
+			}
+		}
+
+		//the mtime is the recency of the entry
+		fs::last_write_time(entryPath, fs::file_time_type::clock::now(), _error);
+		m_Hits++;
+		m_BytesSaved += _size;
+		return true;
+	}
+
+	//Keeps a copy of a fresh result, a failure only means the next run misses again
+	void Store(const std::string &entryPath, const std::string &outputPath)
+	{
+		namespace fs = std::experimental::filesystem;
+		std::error_code _error;
+
+		//a job that reported success without writing anything must not turn into a hit for a missing result
+		uint64_t _size = fs::file_size(outputPath, _error);
+		if (_error || _size == 0)
+		{
+			LOG_WARNING("No result at " << outputPath << " to store in the cache");
+			return;
+		}
+
+		std::string _temp = entryPath + ".tmp" + std::to_string(m_TempCounter++);
+		fs::copy_file(outputPath, _temp, fs::copy_options::overwrite_existing, _error);
+		if (!_error)
+			fs::rename(_temp, entryPath, _error);
+		if (_error)
+		{
+			LOG_WARNING("Can't store " << outputPath << " in the cache");
+			fs::remove(_temp, _error);
+		}
+	}
+
+	//Deletes the least recently used entries until the cache is under its bound again
+	void Trim()
+	{
+		namespace fs = std::experimental::filesystem;
+		struct Entry
+		{
+			fs::path m_Path;
+			fs::file_time_type m_Time;
+			uint64_t m_Size;
+		};
+
+		std::vector<Entry> _entries;
+		uint64_t _totalBytes = 0;
+		std::error_code _error;
+		for (fs::directory_iterator _item(m_Directory, _error), _end; !_error && _item != _end; _item.increment(_error))
+		{
+			Entry _entry;
+			_entry.m_Path = _item->path();
+			_entry.m_Time = fs::last_write_time(_entry.m_Path, _error);
+			_entry.m_Size = fs::file_size(_entry.m_Path, _error);
+			if (_error)
+			{
+				_error.clear();
+				continue;
+			}
+			_entries.push_back(_entry);
+			_totalBytes += _entry.m_Size;
+		}
+
+		if (_totalBytes <= m_MaxBytes)
+			return;
+
+		std::sort(_entries.begin(), _entries.end(), [](const Entry &a, const Entry &b)
+		{
+			return a.m_Time < b.m_Time;
+		});
+
+		for (size_t i = 0; i < _entries.size() && _totalBytes > m_MaxBytes; i++)
+		{
+			if (fs::remove(_entries[i].m_Path, _error))
+			{
+				_totalBytes -= _entries[i].m_Size;
+				m_Evictions++;
+			}
+			_error.clear();
+		}
+	}
+};
\ No newline at end of file
@@ -5,9 +5,11 @@
 //----------------------
 #define USE_LOG									1
 #define USE_THROW_ERRORS						1
-#define USE_LOG_TIME							1
 #define USE_LOG_IMAGE_DATA						1
 #define USE_WAIT_FOR_INPUT						1
+#define USE_SIMD_KERNELS						1
+#define USE_MAPPED_READ							1
+#define USE_BOX_DOWNSCALE						1				//1/2, 1/4 & 1/8 average whole blocks instead of bilinear
 
 
 //----------------------
@@ -15,4 +17,22 @@
 //----------------------
 #define DEFAULT_RESIZE_MULTIPLIER				0.5f
 #define MIN_COLOR								0.0f
-#define MAX_COLOR								255.0f
\ No newline at end of file
+#define MAX_COLOR								255.0f
+#define DEFAULT_THREADS							0				//0 means all the hardware threads
+#define RESIZE_BANDS_PER_THREAD					4
+#define RESIZE_MIN_BAND_ROWS					16
+#define RESIZE_TILE_MAX_WIDTH					8192
+#define DEFAULT_BATCH_MAX_MEMORY_MB				1024
+#define DEFAULT_CACHE_MAX_MB					4096			//the result cache bound, least recently used out first
+#define IMAGE_ROW_ALIGNMENT						64				//bytes, a cache line & an AVX-512 register
+#define IMAGE_POOL_MAX_MB						256				//pixel blocks kept around for reuse
+#define STREAM_CHUNK_ROWS						64				//output rows resampled per block in the streaming mode
+#define FILTER_WEIGHTS_CACHE_SIZE				64				//weight tables kept, one per filter & axis sizes
+#define PROFILE_SLOWEST_FILES					10				//files listed by the profiler report
+#define LOG_MAX_LEVEL							3				//ELogLevel, the levels above are compiled out (3 is debug)
+#define LOG_DEFAULT_LEVEL						2				//info, --log=LEVEL changes it at runtime
+#define LOG_THREAD_BUFFER_KB					64				//log ring per thread, a power of 2
+#define LOG_FLUSH_INTERVAL_MS					10				//the background writer drains at least this often
+#define FILE_WRITE_BUFFER_KB					256				//the most a written file gets buffered, bigger blocks go straight out
+#define SERVER_MAX_PIPELINE						64				//requests in flight per connection, past that the server stops reading it
+#define SERVER_MAX_REQUEST_MB					512				//a bigger frame closes the connection
\ No newline at end of file
@@ -7,6 +7,13 @@ http://tfc.duke.free.fr/coding/tga_specs.pdf
 #pragma once
 
 #include "ImageFormatBase.h"
+#include "ImageBuffer.h"
+#include "Resampler.h"
+#include "MappedFile.h"
+#include "FileWriter.h"
+#include "ByteOrder.h"
+#include "Profiler.h"
+#include "TGARLE.h"
 
 /*
 As we deal with TGA Ver.2, then have to fill 26bytes for the footer
@@ -25,6 +32,7 @@ static const char tgaEmptyFooterBytes[] =
 "."												//[1byte]	-	Contains "."
 "\0";											//[1byte]	-	Contains NULL
 static const size_t tgaFooterSize = 26;
+static const size_t tgaHeaderSize = 18;
 
 /*
 - I decided to go with class
@@ -63,20 +71,26 @@ public:
 
 	uint8_t *m_Id;
 	uint8_t *m_ColorMapData;
-	std::vector<uint8_t> m_Pixels;
-	long m_Channels;							//make more sense of the number 32 is 4 channels and 24 is 3 channels
+
+	//a mapped read leaves the pixels inside the file mapping, m_Image is just a view over them then
+	MappedFile m_Mapping;
+	ImageBuffer m_Image;
+	bool m_FlipRows;							//the pixels are in the other rows order than the header says (a converted BMP), reversed on their way out
 
 	//I don't need so far to initialize the constructor with any values
 	TGA_Format()
 	{
 		ImageFormat = EImageFormat::TGA;
+		//a failed read must still be safe to destruct (batch mode carries on after it)
+		m_Id = NULL;
+		m_ColorMapData = NULL;
+		m_FlipRows = false;
 	}
 	//Just in case i forget to deallocate something, this may be not needed later
 	~TGA_Format()
 	{
 		//just in case
-		m_Pixels.clear();
-		m_Pixels.shrink_to_fit();
+		m_Image.Release();
 		free(m_Id);
 		free(m_ColorMapData);
 	}
@@ -84,7 +98,37 @@ public:
 	size_t SizeInBytes() override
 	{
 		//this shall match the size found in [Right click-> properties] within explorer, if not, then there is an issue
-		return (m_ImageWidth * m_ImageHeigh * m_ImagePixelDepth / 8);
+		//in size_t, a 16k x 16k 32bit image is over what an int holds
+		return (size_t(m_ImageWidth) * m_ImageHeigh * m_ImagePixelDepth / 8);
+	}
+
+	//A row as it is in the file, no padding
+	long RowSizeInBytes() const
+	{
+		return long(m_ImageWidth) * (m_ImagePixelDepth / 8);
+	}
+
+	EPixelFormat PixelFormat() const
+	{
+		return ImageBuffer::FromDepth(m_ImagePixelDepth);
+	}
+
+	//True color 24/32bit, or a single 8bit channel for the grayscale types (the resampler has an 8bit path)
+	bool IsSupportedDepth()
+	{
+		return m_ImagePixelDepth >= 24 || (m_ImagePixelDepth == 8 && IsGrayScale(*this));
+	}
+
+	//The first row in the file is the top one, bottom-left is the usual origin
+	bool IsTopDown() const
+	{
+		return (m_ImageDescription & TGA_SPECIFICATION_DESCRIPTION_TOP_TO_BOTTOM) != 0;
+	}
+
+	//The first pixel of a row in the file is the right-most one
+	bool IsRightToLeft() const
+	{
+		return (m_ImageDescription & TGA_SPECIFICATION_DESCRIPTION_RIGHT_TO_LEFT) != 0;
 	}
 
 	uint8_t IsGrayScale(const TGA_Format &format)
@@ -104,53 +148,74 @@ public:
 			);
 	}
 
-	void OnImageRead(const char *path) override
+	//Decodes the 18 bytes of the header, the fields are little endian & packed, whatever the host is
+	void ParseHeader(const uint8_t *data)
 	{
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
-#endif // USE_LOG_TIME
-
-		//open the file
-		//I usually use fopen, but at the same time didn't want to hide warnings with _CRT_SECURE_NO_WARNINGS in a job application test, so used the secure one
-		FILE *_file;
-		fopen_s(&_file, path, "rb");
-		LOG(path);
-		if (_file == NULL)
-		{
-			LOG("ERR	fopen is NULL [Read]");
-			THROW_ERROR("fopen is NULL  [Read]");
-		}
-
-		m_Id = NULL;
-		m_ColorMapData = NULL;
-
-		//read from file with the same order & store into the TGA blocks.
+		//same order as the file format specification
 		//ID Length						[1byte] 8
 		//Color Map Type				[1byte] 8
 		//Image Type					[1byte] 8
 		//Color Map Specification		[5bytes] 16, 16, 8
 		//Image Specification			[10bytes] 16, 16, 16, 16, 8, 8
-		fread(&m_IdLength, 1, 1, _file);
-
-		fread(&m_ColorMapType, 1, 1, _file);
+		m_IdLength = data[0];
+		m_ColorMapType = data[1];
+		m_ImageType = data[2];
+
+		m_ColorMapFirstEntryIndex = ByteOrder::Read16(data + 3);
+		m_ColorMapLength = ByteOrder::Read16(data + 5);
+		m_ColorMapEntrySize = data[7];
+
+		m_ImageOriginX = ByteOrder::Read16(data + 8);
+		m_ImageOriginY = ByteOrder::Read16(data + 10);
+		m_ImageWidth = ByteOrder::Read16(data + 12);
+		m_ImageHeigh = ByteOrder::Read16(data + 14);
+		m_ImagePixelDepth = data[16];
+		m_ImageDescription = data[17];
+	}
 
-		fread(&m_ImageType, 1, 1, _file);
+	//The other way around, the 18 bytes as they go in the file
+	void PackHeader(uint8_t *data) const
+	{
+		data[0] = m_IdLength;
+		data[1] = m_ColorMapType;
+		data[2] = m_ImageType;
+
+		ByteOrder::Write16(data + 3, m_ColorMapFirstEntryIndex);
+		ByteOrder::Write16(data + 5, m_ColorMapLength);
+		data[7] = m_ColorMapEntrySize;
+
+		ByteOrder::Write16(data + 8, m_ImageOriginX);
+		ByteOrder::Write16(data + 10, m_ImageOriginY);
+		ByteOrder::Write16(data + 12, m_ImageWidth);
+		ByteOrder::Write16(data + 14, m_ImageHeigh);
+		data[16] = m_ImagePixelDepth;
+		data[17] = m_ImageDescription;
+	}
 
-		fread(&m_ColorMapFirstEntryIndex, 2, 1, _file);
-		fread(&m_ColorMapLength, 2, 1, _file);
-		fread(&m_ColorMapEntrySize, 1, 1, _file);
+	//A read that has to get all its bytes, the file gets closed & it throws if it's cut short
+	static void ReadFully(void *data, size_t size, FILE *file)
+	{
+		if (size > 0 && fread(data, size, 1, file) != 1)
+		{
+			fclose(file);
+			LOG_ERROR("TGA file is cut short");
+			THROW_ERROR("TGA file is cut short");
+		}
+	}
 
-		fread(&m_ImageOriginX, 2, 1, _file);
-		fread(&m_ImageOriginY, 2, 1, _file);
-		fread(&m_ImageWidth, 2, 1, _file);
-		fread(&m_ImageHeigh, 2, 1, _file);
-		fread(&m_ImagePixelDepth, 1, 1, _file);
-		fread(&m_ImageDescription, 1, 1, _file);
+	//Reads the header, the ID & the color map, leaving the file at the first pixel. The file gets closed if it throws
+	void ReadHeader(FILE *file)
+	{
+		//the whole header in one read
+		uint8_t _header[tgaHeaderSize] = {};
+		ReadFully(_header, tgaHeaderSize, file);
+		ParseHeader(_header);
 
-		if (m_ImagePixelDepth < 24)
+		if (!IsSupportedDepth())
 		{
-			LOG("ERR	m_imagePixelDepth is neither 32b nor 24b");
-			THROW_ERROR("m_imagePixelDepth is neither 32b nor 24b");
+			fclose(file);
+			LOG_ERROR("m_imagePixelDepth is neither 32b, 24b nor 8b grayscale");
+			THROW_ERROR("m_imagePixelDepth is neither 32b, 24b nor 8b grayscale");
 		}
 
 		//It's a good place to check if any of the read values is invalid, if needed.
@@ -162,175 +227,336 @@ public:
 
 			if (m_Id == NULL)
 			{
-				LOG("ERR	m_id is NULL");
+				fclose(file);
+				LOG_ERROR("m_id is NULL");
 				THROW_ERROR("m_id is NULL");
 			}
 
-			fread(&m_Id, m_IdLength, 1, _file);
+			ReadFully(m_Id, m_IdLength, file);
 		}
 
 		if (m_ColorMapType == TGA_COLOR_MAP_TYPE_PRESENT)
 		{
-			m_ColorMapData = (uint8_t*)malloc((m_ColorMapFirstEntryIndex + m_ColorMapLength) * m_ColorMapEntrySize / 8);
+			m_ColorMapData = (uint8_t*)malloc(ColorMapSizeInBytes());
 
 			if (m_ColorMapData == NULL)
 			{
-				LOG("ERR	m_colorMapData is NULL");
+				fclose(file);
+				LOG_ERROR("m_colorMapData is NULL");
 				THROW_ERROR("m_colorMapData is NULL");
 			}
 
-			fread(&m_ColorMapData + (m_ColorMapFirstEntryIndex * m_ColorMapEntrySize / 8), m_ColorMapLength * m_ColorMapEntrySize / 8, 1, _file);
+			ReadFully(m_ColorMapData + (m_ColorMapFirstEntryIndex * m_ColorMapEntrySize / 8), m_ColorMapLength * m_ColorMapEntrySize / 8, file);
 		}
+	}
 
-		m_Pixels.resize(SizeInBytes());
+	//Writes the header, the ID & the color map, the pixels come next
+	void WriteHeader(FileWriter &file)
+	{
+		uint8_t _header[tgaHeaderSize];
+		PackHeader(_header);
+		file.Write(_header, tgaHeaderSize);
 
-		//check for RLE
-		if (IsCompressed(*this))
+		if (m_IdLength > 0)
 		{
-			LOG("ERR	RLE not supported yet!");
-			THROW_ERROR("RLE not supported yet!");
+			file.Write(m_Id, m_IdLength);
 		}
-		else
+
+		if (m_ColorMapType == TGA_COLOR_MAP_TYPE_PRESENT)
 		{
-			fread(&m_Pixels[0], SizeInBytes(), 1, _file);
+			file.Write(m_ColorMapData + (m_ColorMapFirstEntryIndex * m_ColorMapEntrySize / 8), m_ColorMapLength * m_ColorMapEntrySize / 8);
 		}
+	}
 
-		m_Channels = m_ImageWidth * (m_ImagePixelDepth > 24 ? m_ImagePixelDepth > 16 ? 4 : 3 : 3);
-
-		//close the file
-		fclose(_file);
+	//Everything before the pixels
+	size_t HeaderSizeInBytes() const
+	{
+		return tgaHeaderSize + m_IdLength + (m_ColorMapType == TGA_COLOR_MAP_TYPE_PRESENT ? m_ColorMapLength * m_ColorMapEntrySize / 8 : 0);
+	}
 
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _endTime = std::chrono::high_resolution_clock::now();
-		std::chrono::duration<float> _duration = _endTime - _startTime;
-		LOG("Time Spent - Reading: " << _duration.count()* 1000.f << "ms");
-#endif // USE_LOG_TIME
+	size_t ColorMapSizeInBytes() const
+	{
+		return (m_ColorMapFirstEntryIndex + m_ColorMapLength) * m_ColorMapEntrySize / 8;
+	}
 
-#ifdef USE_LOG_IMAGE_DATA
-		if (m_Pixels.size() != 0)
-			LOG(m_Pixels.data());
-		else
-			LOG("ERR, the pixels vector is empty or null!");
-#endif // USE_LOG_IMAGE_DATA
+	//The ID & color map are owned by every format, a resized copy gets its own copy of them
+	void CopyHeaderData(const TGA_Format &source)
+	{
+		free(m_Id);
+		free(m_ColorMapData);
+		m_Id = NULL;
+		m_ColorMapData = NULL;
 
+		if (source.m_Id != NULL && source.m_IdLength > 0)
+		{
+			m_Id = (uint8_t*)malloc(source.m_IdLength);
+			memcpy(m_Id, source.m_Id, source.m_IdLength);
+		}
 
-		LOG("=================R=E=A=D====T=G=A===============");
-		LOG("ImageWidth: " << m_ImageWidth);
-		LOG("ImageHeigh: " << m_ImageHeigh);
-		LOG("ImageSize: " << SizeInBytes() << "Bytes");
-		LOG("ImageBitsPerPixel: " << size_t(m_ImagePixelDepth) << "bit");
-		LOG("================================================");
+		if (source.m_ColorMapData != NULL)
+		{
+			m_ColorMapData = (uint8_t*)malloc(source.ColorMapSizeInBytes());
+			memcpy(m_ColorMapData, source.m_ColorMapData, source.ColorMapSizeInBytes());
+		}
 	}
 
-	void OnImageWrite(const char *path) override
+	//Switches the image type between its uncompressed & RLE versions (2 <-> 10, 3 <-> 11, 1 <-> 9)
+	void ApplyCompression(EOutputCompression compression)
 	{
-		LOG("===================W=R=I=T=E====================");
-		LOG("ImageWidth: " << m_ImageWidth);
-		LOG("ImageHeigh: " << m_ImageHeigh);
-		LOG("ImageSize: " << SizeInBytes() << "Bytes");
-		LOG("ImageBitsPerPixel: " << size_t(m_ImagePixelDepth) << "bit");
-		LOG("================================================");
-
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
-#endif // USE_LOG_TIME
+		if (compression == EOutputCompression::RLE && !IsCompressed(*this) && m_ImageType != TGA_IMAGE_TYPE_NO_DATA)
+			m_ImageType += 8;
+		else if (compression == EOutputCompression::Uncompressed && IsCompressed(*this))
+			m_ImageType -= 8;
+	}
 
-		//same here, I usually use fopen, but at the same time didn't want to hide warnings with _CRT_SECURE_NO_WARNINGS in a job application test, so used the secure one
-		FILE *_file;
-		fopen_s(&_file, path, "wb");
-		LOG(path);
-		if (_file == NULL)
+	//Expands the RLE packets of data into m_Image, packed as packets can run over the end of a row
+	void DecodeRLE(const uint8_t *data, size_t size)
+	{
+		m_Image.Allocate(m_ImageWidth, m_ImageHeigh, PixelFormat(), RowSizeInBytes());
+		if (TGA_RLE::Decode(data, size, m_Image.m_Data, size_t(m_ImageWidth) * m_ImageHeigh, m_ImagePixelDepth / 8) == 0 && SizeInBytes() > 0)
 		{
-			LOG("ERR	fopen is NULL [Write]");
-			THROW_ERROR("fopen is NULL [Write]");
+			LOG_ERROR("RLE data is corrupted or cut short");
+			THROW_ERROR("RLE data is corrupted or cut short");
 		}
+	}
 
-		//wrtie with the same order used to read (matching the file format specification order)
-		//ID Length						[1byte] 8
-		//Color Map Type				[1byte] 8
-		//Image Type					[1byte] 8
-		//Color Map Specification		[5bytes] 16, 16, 8
-		//Image Specification			[10bytes] 16, 16, 16, 16, 8, 8
-		fwrite(&m_IdLength, 1, 1, _file);
+	/*
+	The whole file as bytes in memory (the mapping, or a buffer handed over by the caller), the header is parsed
+	straight from there & uncompressed pixels are left in place for the resampler, m_Image is a view over them.
+	An RLE image is decoded straight from the bytes, no copy in between.
+	Returns false when the bytes are cut short, the caller decides what that means.
+	*/
+	bool ReadSpan(const uint8_t *data, size_t size)
+	{
+		if (size < tgaHeaderSize)
+			return false;
 
-		fwrite(&m_ColorMapType, 1, 1, _file);
+		//same decoding as ReadHeader()
+		ParseHeader(data);
 
-		fwrite(&m_ImageType, 1, 1, _file);
+		if (!IsSupportedDepth())
+		{
+			LOG_ERROR("m_imagePixelDepth is neither 32b, 24b nor 8b grayscale");
+			THROW_ERROR("m_imagePixelDepth is neither 32b, 24b nor 8b grayscale");
+		}
 
-		fwrite(&m_ColorMapFirstEntryIndex, 2, 1, _file);
-		fwrite(&m_ColorMapLength, 2, 1, _file);
-		fwrite(&m_ColorMapEntrySize, 1, 1, _file);
+		size_t _colorMapOffset = tgaHeaderSize + m_IdLength;
+		size_t _pixelsOffset = _colorMapOffset;
+		if (m_ColorMapType == TGA_COLOR_MAP_TYPE_PRESENT)
+			_pixelsOffset += m_ColorMapLength * m_ColorMapEntrySize / 8;
 
-		fwrite(&m_ImageOriginX, 2, 1, _file);
-		fwrite(&m_ImageOriginY, 2, 1, _file);
-		fwrite(&m_ImageWidth, 2, 1, _file);
-		fwrite(&m_ImageHeigh, 2, 1, _file);
-		fwrite(&m_ImagePixelDepth, 1, 1, _file);
-		fwrite(&m_ImageDescription, 1, 1, _file);
+		if (_pixelsOffset + (IsCompressed(*this) ? 0 : SizeInBytes()) > size)
+			return false;
 
+		//the ID & color map are tiny, they get their own copies like the buffered read does
 		if (m_IdLength > 0)
 		{
-			fwrite(&m_Id, m_IdLength, 1, _file);
+			m_Id = (uint8_t*)malloc(m_IdLength);
+			memcpy(m_Id, data + tgaHeaderSize, m_IdLength);
 		}
 
 		if (m_ColorMapType == TGA_COLOR_MAP_TYPE_PRESENT)
 		{
-			fwrite(&m_ColorMapData + (m_ColorMapFirstEntryIndex * m_ColorMapEntrySize / 8), m_ColorMapLength * m_ColorMapEntrySize / 8, 1, _file);
+			m_ColorMapData = (uint8_t*)malloc(ColorMapSizeInBytes());
+			memcpy(m_ColorMapData + (m_ColorMapFirstEntryIndex * m_ColorMapEntrySize / 8), data + _colorMapOffset, m_ColorMapLength * m_ColorMapEntrySize / 8);
 		}
 
 		if (IsCompressed(*this))
 		{
-			//When i support RLE, need to update here!
+			DecodeRLE(data + _pixelsOffset, size - _pixelsOffset);
+			PROFILE_COUNT(BytesRead, size - _pixelsOffset);
+			return true;
 		}
-		else
+
+		m_Image.View(data + _pixelsOffset, m_ImageWidth, m_ImageHeigh, PixelFormat(), RowSizeInBytes());
+		PROFILE_COUNT(BytesRead, SizeInBytes());
+		return true;
+	}
+
+	/*
+	The zero-copy read, the file is mapped & read by ReadSpan().
+	Returns false for anything it can't map (short file, no mapping at all) so the caller falls back to the buffered read.
+	*/
+	bool ReadMapped(const char *path)
+	{
+		if (!m_Mapping.Open(path))
+			return false;
+
+		if (!ReadSpan(m_Mapping.m_Data, m_Mapping.m_Size))
 		{
-			fwrite(&m_Pixels[0], SizeInBytes(), 1, _file);
+			m_Mapping.Close();
+			return false;
 		}
 
-		fwrite(tgaEmptyFooterBytes, tgaFooterSize, 1, _file);
+		//the mapping isn't needed anymore once RLE pixels are expanded
+		if (!m_Image.IsView())
+			m_Mapping.Close();
+		return true;
+	}
 
-		//close
-		fclose(_file);
+	//A whole TGA file already in memory (off the network, out of an archive), uncompressed pixels stay a view over data, keep it alive
+	void OnImageDecode(const uint8_t *data, size_t size) override
+	{
+		PROFILE_SCOPE("read");
+
+		if (!ReadSpan(data, size))
+		{
+			LOG_ERROR("TGA data is cut short");
+			THROW_ERROR("TGA data is cut short");
+		}
+
+		LOG("Decoded " << m_ImageWidth << "x" << m_ImageHeigh << " " << size_t(m_ImagePixelDepth) << "bit TGA from memory");
+	}
+
+	void OnImageRead(const char *path) override
+	{
+		PROFILE_SCOPE("read");
+
+		LOG(path);
 
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _endTime = std::chrono::high_resolution_clock::now();
-		std::chrono::duration<float> _duration = _endTime - _startTime;
-		LOG("Time Spent - Writing: " << _duration.count()* 1000.f << "ms");
-#endif // USE_LOG_TIME
+		//uncompressed images are mapped & resampled in place, RLE ones get decoded from the mapping, fread is the fallback
+		if (USE_MAPPED_READ == 0 || !ReadMapped(path))
+		{
+			//open the file
+			//I usually use fopen, but at the same time didn't want to hide warnings with _CRT_SECURE_NO_WARNINGS in a job application test, so used the secure one
+			FILE *_file;
+			fopen_s(&_file, path, "rb");
+			if (_file == NULL)
+			{
+				LOG_ERROR("fopen is NULL [Read]");
+				THROW_ERROR("fopen is NULL  [Read]");
+			}
+
+			//header, ID & color map, the file is left at the first pixel
+			ReadHeader(_file);
+
+			//check for RLE
+			if (IsCompressed(*this))
+			{
+				//the packets are whatever is left of the file (the footer too, the decoder stops before it)
+				long _start = ftell(_file);
+				fseek(_file, 0, SEEK_END);
+				long _end = ftell(_file);
+				fseek(_file, _start, SEEK_SET);
+
+				std::vector<uint8_t> _packets(_end > _start ? size_t(_end - _start) : 0);
+				ReadFully(_packets.data(), _packets.size(), _file);
+				fclose(_file);
+
+				DecodeRLE(_packets.data(), _packets.size());
+				PROFILE_COUNT(BytesRead, _packets.size());
+			}
+			else
+			{
+				//packed like the file, so it is a single read. The pooled block holds whatever the last image left, a short read must not pass
+				m_Image.Allocate(m_ImageWidth, m_ImageHeigh, PixelFormat(), RowSizeInBytes());
+				ReadFully(m_Image.m_Data, SizeInBytes(), _file);
+				fclose(_file);
+				PROFILE_COUNT(BytesRead, SizeInBytes());
+			}
+		}
+
+#ifdef USE_LOG_IMAGE_DATA
+		//a peek at the first bytes, the pixels aren't a string to print
+		if (m_Image.IsView())
+			LOG_DEBUG("Pixels mapped in place: " << Logger::Hex(m_Image.m_Data, SizeInBytes()));
+		else if (!m_Image.IsEmpty())
+			LOG_DEBUG("Pixels: " << Logger::Hex(m_Image.m_Data, SizeInBytes()));
+		else
+			LOG_WARNING("the pixels vector is empty or null!");
+#endif // USE_LOG_IMAGE_DATA
+
+
+		LOG("=================R=E=A=D====T=G=A===============");
+		LOG("ImageWidth: " << m_ImageWidth);
+		LOG("ImageHeigh: " << m_ImageHeigh);
+		LOG("ImageSize: " << SizeInBytes() << "Bytes");
+		LOG("ImageBitsPerPixel: " << size_t(m_ImagePixelDepth) << "bit");
+		LOG("================================================");
 	}
 
-	const uint8_t* NeighbourPtr(const TGA_Format &format, int xIndex, int yIndex)
+	//Writes the rows of pixels the way this header says, RLE packets or raw rows (in a single write when there is no padding)
+	//flip writes the last row first, while writing, there is no flipped copy of the image
+	void WritePixels(FileWriter &file, const ImageBuffer &pixels, bool flip = false)
 	{
-		CLAMP_PIXEL(xIndex, 0, format.m_ImageWidth - 1, yIndex, 0, format.m_ImageHeigh - 1);
-		return &format.m_Pixels[(yIndex * format.m_Channels) + xIndex * (format.m_ImagePixelDepth > 24 ? format.m_ImagePixelDepth > 16 ? 4 : 3 : 3)];
+		if (pixels.IsEmpty())
+			return;
+
+		if (IsCompressed(*this))
+		{
+			//packets are built in memory, then go out in a single write. Flipped is the last row & a negative stride
+			std::vector<uint8_t> _packets;
+			const uint8_t *_first = flip ? pixels.m_Data + size_t(pixels.m_Height - 1) * pixels.m_Stride : pixels.m_Data;
+			TGA_RLE::Encode(_first, pixels.m_Width, pixels.m_Height, flip ? -pixels.m_Stride : pixels.m_Stride, pixels.Channels(), _packets);
+			file.Write(_packets.data(), _packets.size());
+			PROFILE_COUNT(BytesWritten, _packets.size());
+		}
+		else if (pixels.IsPacked() && !flip)
+		{
+			file.Write(pixels.m_Data, pixels.SizeInBytes());
+			PROFILE_COUNT(BytesWritten, pixels.SizeInBytes());
+		}
+		else
+		{
+			for (int y = 0; y < pixels.m_Height; y++)
+				file.Write(pixels.Row(flip ? pixels.m_Height - 1 - y : y), pixels.RowBytes());
+			PROFILE_COUNT(BytesWritten, size_t(pixels.RowBytes()) * pixels.m_Height);
+		}
 	}
 
-	uint8_t BilinearPixelColor(const uint8_t* BL, const uint8_t* BR, const uint8_t* TL, const uint8_t* TR, float W, float H, int index)
+	void OnImageWrite(const char *path) override
 	{
-		float _colorA;
-		float _colorB;
-		float _color;
+		LOG("===================W=R=I=T=E====================");
+		LOG("ImageWidth: " << m_ImageWidth);
+		LOG("ImageHeigh: " << m_ImageHeigh);
+		LOG("ImageSize: " << SizeInBytes() << "Bytes");
+		LOG("ImageBitsPerPixel: " << size_t(m_ImagePixelDepth) << "bit");
+		LOG("================================================");
 
-		//The vertical (on Y) linear interpolation
-		LERP(TL[index], BL[index], _colorA, W);
-		LERP(TR[index], BR[index], _colorB, W);
-		LERP(_colorA, _colorB, _color, H);
+		PROFILE_SCOPE("write");
+
+		//the whole file is gathered in one buffer, a small image goes out in a single write
+		FileWriter _file;
+		bool _opened = _file.Open(path, HeaderSizeInBytes() + SizeInBytes() + tgaFooterSize);
+		LOG(path);
+		if (!_opened)
+		{
+			LOG_ERROR("fopen is NULL [Write]");
+			THROW_ERROR("fopen is NULL [Write]");
+		}
 
-		CLAMP(_color, MIN_COLOR, MAX_COLOR);
+		WriteImage(_file);
 
-		return uint8_t(_color);
+		//close
+		_file.Close();
+	}
+
+	//The whole file, to disk or to memory
+	void WriteImage(FileWriter &file)
+	{
+		WriteHeader(file);
+
+		WritePixels(file, m_Image, m_FlipRows);
+
+		file.Write(tgaEmptyFooterBytes, tgaFooterSize);
 	}
 
-	void OnImageResize(TGA_Format &newFormat, float resizeMultiplier)
+	//The same bytes OnImageWrite() puts in the file, appended to output instead
+	void OnImageEncode(std::vector<uint8_t> &output) override
 	{
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
-#endif // USE_LOG_TIME
+		PROFILE_SCOPE("write");
 
+		FileWriter _memory;
+		_memory.Open(output, HeaderSizeInBytes() + SizeInBytes() + tgaFooterSize);
+		WriteImage(_memory);
+		_memory.Close();
+	}
+
+	//Fills the header of the resized version, everything but the pixels
+	void ResizedHeader(TGA_Format &newFormat, float resizeMultiplier)
+	{
 		//Fill members of the new resized version
 		//let's start with the idintical ones, info that will probably remain the same
-		newFormat.m_Id = m_Id;
-		newFormat.m_ColorMapData = m_ColorMapData;
 		newFormat.m_IdLength = m_IdLength;
 		newFormat.m_ColorMapType = m_ColorMapType;
 		newFormat.m_ImageType = m_ImageType;
@@ -341,109 +567,50 @@ public:
 		newFormat.m_ImageOriginY = m_ImageOriginY;
 		newFormat.m_ImagePixelDepth = m_ImagePixelDepth;
 		newFormat.m_ImageDescription = m_ImageDescription;
+		newFormat.CopyHeaderData(*this);
 
 		//of course the diminsions will be based on the scaleMultiplier
 		newFormat.m_ImageWidth = uint16_t(float(m_ImageWidth)*resizeMultiplier);
 		newFormat.m_ImageHeigh = uint16_t(float(m_ImageHeigh)*resizeMultiplier);
+	}
 
-		newFormat.m_Channels = newFormat.m_ImageWidth * (newFormat.m_ImagePixelDepth > 24 ? newFormat.m_ImagePixelDepth > 16 ? 4 : 3 : 3);
-
-		//expand or shrink, to fit the amount of pixels and channels for the new image size [NewWidth*NewHigh*Depth/8b]
-		newFormat.m_Pixels.resize((const unsigned int)(
-			(m_ImageWidth*resizeMultiplier) *
-			(m_ImageHeigh*resizeMultiplier) *
-			(m_ImagePixelDepth) / 8));
+	/*
+	The depth & origin a resize asks for, on the header of the resized version. The pixels get there in the store step
+	of the resampler, which flips whatever differs between the two descriptions (an asked origin is always left to right).
+	*/
+	void ResizedLayout(TGA_Format &newFormat, const ResampleSettings &settings)
+	{
+		if (settings.m_OutputDepth != 0 && settings.m_OutputDepth != m_ImagePixelDepth)
+		{
+			//gray or true color, RLE or not as the source was, with the alpha bits of the new depth
+			uint8_t _type = settings.m_OutputDepth == 8 ? TGA_IMAGE_TYPE_UNCOMPRESSED_GRAYSCALE : TGA_IMAGE_TYPE_UNCOMPRESSED_TRUE_COLOR;
+			newFormat.m_ImageType = IsCompressed(*this) ? uint8_t(_type + 8) : _type;
+			newFormat.m_ImagePixelDepth = uint8_t(settings.m_OutputDepth);
+			newFormat.m_ImageDescription = uint8_t((m_ImageDescription & ~TGA_SPECIFICATION_DESCRIPTION_ALPHA_DEPTH) | (settings.m_OutputDepth == 32 ? 8 : 0));
+		}
 
-		uint8_t *_currentRow = &newFormat.m_Pixels[0];
-		for (int y = 0; y < newFormat.m_ImageHeigh; y++)
+		if (settings.m_Origin != EOutputOrigin::KeepOrigin)
 		{
-			uint8_t *_pixel = _currentRow;
-			float _vertical = float(y) / float(newFormat.m_ImageHeigh - 1);
-			for (int x = 0; x < newFormat.m_ImageWidth; x++)
-			{
-				float _horizontal = float(x) / float(newFormat.m_ImageWidth - 1);
-
-				//start resampling in bilinear
-				//TODO::may be good move this to its own function later. Also can put macros here to measure the bilinear time only if needed
-
-				//ease the move between pixels of the TGA vertically and horizontally
-				float _w = (_horizontal * m_ImageWidth);
-				float _h = (_vertical * m_ImageHeigh);
-
-				int _indexX = int(_w);
-				int _indexY = int(_h);
-
-				float _W = _w - floor(_w);
-				float _H = _h - floor(_h);
-
-				/*
-					[0.1]			[1.1]
-					TL				TR
-					-----------------
-					|			|	|
-					|-----------|----
-					|			|	|
-					|			|	|
-					|			|	|
-					-----------------
-					BL				BR
-					[0.0]			[1.0]
-
-					TL => Top Left
-					TR => Top Right
-					BL => Bottom Left
-					BR => Bottom Right
-
-					- Let's first interpolate linearlly between the two bottom points. [X]
-					- Then interpolate linearlly between the two top points. [X]
-					- Then we interpolate linearlly between the two results. [Y]
-				*/
-
-				//The Horizontal linear interpolation (on X) two times
-				auto _BL = NeighbourPtr(*this, _indexX + 1, _indexY + 0);
-				auto _BR = NeighbourPtr(*this, _indexX + 1, _indexY + 1);
-				auto _TL = NeighbourPtr(*this, _indexX + 0, _indexY + 0);
-				auto _TR = NeighbourPtr(*this, _indexX + 0, _indexY + 1);
-
-				std::array<uint8_t, 3> _outRGB;
-				std::array<uint8_t, 4> _outRGBA;
-
-				//interpolate the colors for the new pixels
-				if (m_ImagePixelDepth > 24) //32RGBA
-				{
-					for (int i = 0; i < 4; i++)
-					{
-						_outRGBA[i] = BilinearPixelColor(_BL, _BR, _TL, _TR, _W, _H, i);
-					}
-
-					//use the out results & jump forward 4*size_t
-					_pixel[0] = _outRGBA[0];
-					_pixel[1] = _outRGBA[1];
-					_pixel[2] = _outRGBA[2];
-					_pixel[3] = _outRGBA[3];
-					_pixel += 4; //skip 4
-				}
-				else //24RGB (or something else that is not supported, but won't reach that line due to the runtime error thrown at load time if less than 24bit)
-				{
-					for (int i = 0; i < 3; i++)
-					{
-						_outRGB[i] = BilinearPixelColor(_BL, _BR, _TL, _TR, _W, _H, i);
-					}
-
-					//use the out results & jump forward 3*size_t
-					_pixel[0] = _outRGB[0];
-					_pixel[1] = _outRGB[1];
-					_pixel[2] = _outRGB[2];
-					_pixel += 3; //skip 3
-				}
-			}
-			_currentRow += newFormat.m_Channels;
+			newFormat.m_ImageDescription &= ~(TGA_SPECIFICATION_DESCRIPTION_RIGHT_TO_LEFT | TGA_SPECIFICATION_DESCRIPTION_TOP_TO_BOTTOM);
+			if (settings.m_Origin == EOutputOrigin::TopLeft)
+				newFormat.m_ImageDescription |= TGA_SPECIFICATION_DESCRIPTION_TOP_TO_BOTTOM;
 		}
+	}
+
+	void OnImageResize(TGA_Format &newFormat, float resizeMultiplier, const ResampleSettings &settings = ResampleSettings())
+	{
+		PROFILE_SCOPE("resize");
+
+		ResizedHeader(newFormat, resizeMultiplier);
+		ResizedLayout(newFormat, settings);
+
+		//expand or shrink, to fit the amount of pixels and channels for the new image size, every row 64 bytes aligned
+		newFormat.m_Image.Allocate(newFormat.m_ImageWidth, newFormat.m_ImageHeigh, newFormat.PixelFormat());
 
-#ifdef USE_LOG_TIME
-		std::chrono::high_resolution_clock::time_point _endTime = std::chrono::high_resolution_clock::now();
-		std::chrono::duration<float> _duration = _endTime - _startTime;
-		LOG("Time Spent - Resizing: " << _duration.count()* 1000.f << "ms");
-#endif // USE_LOG_TIME
+		//the separable resampler does the horizontal & vertical passes over whole rows, bilinear is the box for 1/2, 1/4 & 1/8
+		Resampler _resampler;
+		_resampler.Configure(resizeMultiplier, settings);
+		_resampler.Orient(IsTopDown() != newFormat.IsTopDown(), IsRightToLeft() != newFormat.IsRightToLeft(), false);
+		_resampler.Resize(m_Image, newFormat.m_Image);
 	}
 };
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+/*
+The TGA run-length encoding (image types 9, 10 & 11)
+Every packet starts with a 1 byte header, the top bit tells the packet type & the low 7 bits the count - 1
+- Run packet	[1xxxxxxx] + 1 pixel, that pixel repeated count times
+- Raw packet	[0xxxxxxx] + count pixels, as they are
+So a packet is never more than 128 pixels.
+- The decoder expands packets straight into the pixel buffer, a raw packet is a single memcpy & a run is
+	a fill of whole pixels, no per-byte branching.
+- The encoder compares whole pixels as words (two 32bit pixels as one 64bit word) to find the runs, and it
+	never lets a packet cross a row, as the TGA 2.0 specification asks for.
+*/
+class TGA_RLE
+{
+public:
+	//A pixel as a single word, so comparing two pixels is a single compare whatever the depth is
+	static uint32_t LoadPixel(const uint8_t *pixel, int bytesPerPixel)
+	{
+		uint32_t _value = 0;
+		memcpy(&_value, pixel, bytesPerPixel);
+		return _value;
+	}
+
+	static uint64_t Load64(const uint8_t *data)
+	{
+		uint64_t _value;
+		memcpy(&_value, data, 8);
+		return _value;
+	}
+
+	/*
+	Expands the packets of src until pixelsCount pixels are in dst.
+	Returns the bytes of src it used, 0 if src ends before the image does or a packet overflows the image.
+	*/
+	static size_t Decode(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t pixelsCount, int bytesPerPixel)
+	{
+		const uint8_t *_src = src;
+		const uint8_t *_srcEnd = src + srcSize;
+		uint8_t *_dst = dst;
+		uint8_t *_dstEnd = dst + pixelsCount * bytesPerPixel;
+
+		while (_dst < _dstEnd)
+		{
+			if (_src >= _srcEnd)
+				return 0;
+
+			uint8_t _header = *_src++;
+			size_t _count = (_header & 0x7F) + 1;
+			size_t _bytes = _count * bytesPerPixel;
+
+			if (_dst + _bytes > _dstEnd)
+				return 0;
+
+			if (_header & 0x80)
+			{
+				if (_src + bytesPerPixel > _srcEnd)
+					return 0;
+
+				if (bytesPerPixel == 4)
+				{
+					uint32_t _pixel = LoadPixel(_src, 4);
+					for (size_t i = 0; i < _count; i++)
+						memcpy(_dst + i * 4, &_pixel, 4);
+				}
+				else if (bytesPerPixel == 1)
+				{
+					memset(_dst, *_src, _count);
+				}
+				else
+				{
+					//copy the first pixel, then keep doubling what is already there
+					memcpy(_dst, _src, bytesPerPixel);
+					size_t _done = bytesPerPixel;
+					while (_done < _bytes)
+					{
+						size_t _chunk = (_bytes - _done < _done) ? _bytes - _done : _done;
+						memcpy(_dst + _done, _dst, _chunk);
+						_done += _chunk;
+					}
+				}
+				_src += bytesPerPixel;
+			}
+			else
+			{
+				if (_src + _bytes > _srcEnd)
+					return 0;
+
+				memcpy(_dst, _src, _bytes);
+				_src += _bytes;
+			}
+			_dst += _bytes;
+		}
+
+		return size_t(_src - src);
+	}
+
+	//How many pixels from x on are the same as the one at x, capped to a packet
+	static int RunLength(const uint8_t *row, int x, int width, int bytesPerPixel)
+	{
+		int _max = width - x < 128 ? width - x : 128;
+		const uint8_t *_pixel = row + x * bytesPerPixel;
+		uint32_t _value = LoadPixel(_pixel, bytesPerPixel);
+		int _run = 1;
+
+		if (bytesPerPixel == 4)
+		{
+			//two pixels per compare
+			uint64_t _pair = uint64_t(_value) | (uint64_t(_value) << 32);
+			while (_run + 2 <= _max && Load64(_pixel + _run * 4) == _pair)
+				_run += 2;
+		}
+
+		while (_run < _max && LoadPixel(_pixel + _run * bytesPerPixel, bytesPerPixel) == _value)
+			_run++;
+
+		return _run;
+	}
+
+	//How many pixels from x on are worth a raw packet, it stops right where a run of 2 or more starts
+	static int RawLength(const uint8_t *row, int x, int width, int bytesPerPixel)
+	{
+		int _max = width - x < 128 ? width - x : 128;
+		const uint8_t *_pixel = row + x * bytesPerPixel;
+		uint32_t _current = LoadPixel(_pixel, bytesPerPixel);
+		int _raw = 1;
+
+		while (_raw < _max)
+		{
+			uint32_t _next = LoadPixel(_pixel + _raw * bytesPerPixel, bytesPerPixel);
+			if (_next == _current)
+				return _raw - 1;
+			_current = _next;
+			_raw++;
+		}
+
+		return _raw;
+	}
+
+	static void EncodeRow(const uint8_t *row, int width, int bytesPerPixel, std::vector<uint8_t> &out)
+	{
+		int x = 0;
+		while (x < width)
+		{
+			int _run = RunLength(row, x, width, bytesPerPixel);
+			if (_run > 1)
+			{
+				out.push_back(uint8_t(0x80 | (_run - 1)));
+				out.insert(out.end(), row + x * bytesPerPixel, row + (x + 1) * bytesPerPixel);
+				x += _run;
+				continue;
+			}
+
+			int _raw = RawLength(row, x, width, bytesPerPixel);
+			out.push_back(uint8_t(_raw - 1));
+			out.insert(out.end(), row + x * bytesPerPixel, row + (x + _raw) * bytesPerPixel);
+			x += _raw;
+		}
+	}
+
+	//Appends the packets of height rows to out, rows are stride bytes apart
+	static void Encode(const uint8_t *pixels, int width, int height, long stride, int bytesPerPixel, std::vector<uint8_t> &out)
+	{
+		//the worst case, everything in raw packets
+		out.reserve(out.size() + size_t(height) * (width * bytesPerPixel + (width + 127) / 128));
+
+		for (int y = 0; y < height; y++)
+			EncodeRow(pixels + y * stride, width, bytesPerPixel, out);
+	}
+};
\ No newline at end of file
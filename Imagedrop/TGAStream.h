@@ -0,0 +1,234 @@
+#pragma once
+
+#include <vector>
+#include <future>
+#include <chrono>
+#include <cstring>
+#include "Macros.h"
+#include "FileWriter.h"
+#include "TGAFormat.h"
+#include "Resampler.h"
+
+/*
+The streaming TGA resize, decode -> resize -> encode a block of rows at a time
+- Only the headers are read up front, the pixels never live whole in memory. The output goes out in
+	blocks of STREAM_CHUNK_ROWS rows, every block needs just the window of source rows its taps read.
+- Two source windows: while the pool resamples one block from the current window, the next window
+	is read from the disk on the side. Same for the output, a block gets written while the next one
+	is being resampled. So the memory is O(rows of a block), not O(image), and the disk is busy
+	while the CPU is busy.
+- The rows are taken in the file order, same as the in-memory path, so the result is the same bytes.
+- The source has to be uncompressed, an RLE image has no random access to its rows. The result can be
+	RLE, every block gets encoded on the writing side (packets never cross a row, so blocks are independent).
+*/
+
+//A window of consecutive source rows [m_FirstRow, m_LastRow] as they are in the file
+struct TGA_StreamWindow
+{
+	ImageBuffer m_Rows;
+	int m_FirstRow;
+	int m_LastRow;
+
+	TGA_StreamWindow() : m_FirstRow(0), m_LastRow(-1) {}
+};
+
+class TGA_Stream
+{
+public:
+	TGA_Format m_Source;						//header only, the pixels stay in the file
+	TGA_Format m_Result;						//header only, the pixels go straight to the file
+
+	FILE *m_SourceFile;
+	int m_FileRow;								//the source row the source file is at
+
+	TGA_Stream() : m_SourceFile(NULL), m_FileRow(0) {}
+
+	//An uncompressed TGA by the image type of its header, an RLE one has to go the whole image way. A file that can't be read is left to Resize() to report
+	static bool IsStreamable(const char *inputPath)
+	{
+		FILE *_file;
+		fopen_s(&_file, inputPath, "rb");
+		if (_file == NULL)
+			return true;
+
+		uint8_t _header[3];
+		bool _read = fread(_header, 1, sizeof(_header), _file) == sizeof(_header);
+		fclose(_file);
+		return !_read || _header[2] < TGA_IMAGE_TYPE_RLE_ENCODED_COLOR_MAPPED;
+	}
+	~TGA_Stream()
+	{
+		if (m_SourceFile != NULL)
+			fclose(m_SourceFile);
+	}
+
+	/*
+	Fills next with the source rows [first, last]. The rows it shares with previous (scaling up, the
+	neighbour blocks share an edge row) are copied over, the rest come from the file, skipping the rows
+	nobody reads (scaling down a lot).
+	Runs on the side while previous is still being resampled, but only reads from it.
+	*/
+	void LoadWindow(const TGA_StreamWindow &previous, TGA_StreamWindow &next, int first, int last)
+	{
+		//packed like the file, so the rows missing come in a single read
+		const long _stride = m_Source.RowSizeInBytes();
+		next.m_FirstRow = first;
+		next.m_LastRow = last;
+		next.m_Rows.Allocate(m_Source.m_ImageWidth, last - first + 1, m_Source.PixelFormat(), _stride);
+
+		int _row = first;
+		for (; _row <= last && _row <= previous.m_LastRow; _row++)
+		{
+			if (_row >= previous.m_FirstRow)
+				memcpy(next.m_Rows.Row(_row - first), previous.m_Rows.Row(_row - previous.m_FirstRow), _stride);
+		}
+
+		if (_row > last)
+			return;
+
+		if (_row != m_FileRow)
+			fseek(m_SourceFile, long(_row - m_FileRow) * _stride, SEEK_CUR);
+
+		//the rows land in a pooled block, rows missing from the file would be another image's pixels
+		size_t _rows = size_t(last - _row + 1);
+		if (fread(next.m_Rows.Row(_row - first), _stride, _rows, m_SourceFile) != _rows)
+		{
+			LOG_ERROR("TGA file is cut short");
+			THROW_ERROR("TGA file is cut short");
+		}
+		PROFILE_COUNT(BytesRead, size_t(_stride) * (last - _row + 1));
+		m_FileRow = last + 1;
+	}
+
+	void Resize(const char *inputPath, const char *outputPath, float resizeMultiplier, EOutputCompression compression, const ResampleSettings &settings = ResampleSettings())
+	{
+		PROFILE_SCOPE("stream");
+
+		fopen_s(&m_SourceFile, inputPath, "rb");
+		LOG(inputPath);
+		if (m_SourceFile == NULL)
+		{
+			LOG_ERROR("fopen is NULL [Read]");
+			THROW_ERROR("fopen is NULL  [Read]");
+		}
+
+		//ReadHeader closes the file itself if it throws
+		FILE *_sourceFile = m_SourceFile;
+		m_SourceFile = NULL;
+		m_Source.ReadHeader(_sourceFile);
+		m_SourceFile = _sourceFile;
+
+		if (m_Source.IsCompressed(m_Source))
+		{
+			LOG_ERROR("RLE can't be streamed!");
+			THROW_ERROR("RLE can't be streamed!");
+		}
+
+		m_Source.ResizedHeader(m_Result, resizeMultiplier);
+		m_Source.ResizedLayout(m_Result, settings);
+		m_Result.ApplyCompression(compression);
+		if (m_Source.IsTopDown() != m_Result.IsTopDown())
+		{
+			LOG_ERROR("The rows order can't be flipped while streaming!");
+			THROW_ERROR("The rows order can't be flipped while streaming!");
+		}
+
+		LOG("=================S=T=R=E=A=M===================");
+		LOG("ImageWidth: " << m_Source.m_ImageWidth << " -> " << m_Result.m_ImageWidth);
+		LOG("ImageHeigh: " << m_Source.m_ImageHeigh << " -> " << m_Result.m_ImageHeigh);
+		LOG("ImageBitsPerPixel: " << size_t(m_Source.m_ImagePixelDepth) << "bit");
+		LOG("================================================");
+
+		//a block of rows bigger than the writer buffer goes straight to the file
+		FileWriter _resultFile;
+		bool _opened = _resultFile.Open(outputPath, m_Result.HeaderSizeInBytes() + m_Result.SizeInBytes() + tgaFooterSize);
+		LOG(outputPath);
+		if (!_opened)
+		{
+			LOG_ERROR("fopen is NULL [Write]");
+			THROW_ERROR("fopen is NULL [Write]");
+		}
+
+		m_Result.WriteHeader(_resultFile);
+
+		if (m_Result.m_ImageWidth > 0 && m_Result.m_ImageHeigh > 0 && m_Source.m_ImageWidth > 0 && m_Source.m_ImageHeigh > 0)
+		{
+			//a source cut short throws halfway, the half written result is removed rather than left looking done
+			try
+			{
+				ResizeRows(_resultFile, resizeMultiplier, settings);
+			}
+			catch (...)
+			{
+				_resultFile.Close();
+				remove(outputPath);
+				throw;
+			}
+		}
+
+		_resultFile.Write(tgaEmptyFooterBytes, tgaFooterSize);
+		_resultFile.Close();
+	}
+
+	//The block loop, read the next window & write the previous block while resampling the current one
+	void ResizeRows(FileWriter &resultFile, float resizeMultiplier, const ResampleSettings &settings)
+	{
+		const int _height = m_Result.m_ImageHeigh;
+
+		Resampler _resampler;
+		_resampler.Configure(resizeMultiplier, settings);
+		_resampler.Orient(false, m_Source.IsRightToLeft() != m_Result.IsRightToLeft(), false);
+		_resampler.Prepare(m_Source.m_ImageWidth, m_Source.m_ImageHeigh, m_Result.m_ImageWidth, m_Result.m_ImageHeigh, m_Source.PixelFormat(), m_Result.PixelFormat());
+
+		TGA_StreamWindow _windows[2];
+		ImageBuffer _blocks[2];
+		//declared after the buffers, an std::async future waits for its job when destroyed, so a throw can't leave one running on freed buffers
+		std::future<void> _reading;
+		std::future<void> _writing;
+
+		int _first, _last;
+		_resampler.SourceRows(0, STREAM_CHUNK_ROWS < _height ? STREAM_CHUNK_ROWS : _height, _first, _last);
+		LoadWindow(_windows[1], _windows[0], _first, _last);
+
+		int _current = 0;
+		for (int y = 0; y < _height; y += STREAM_CHUNK_ROWS)
+		{
+			int _y1 = (_height - y > STREAM_CHUNK_ROWS) ? y + STREAM_CHUNK_ROWS : _height;
+
+			//prefetch the window of the next block
+			if (_y1 < _height)
+			{
+				int _nextY1 = (_height - _y1 > STREAM_CHUNK_ROWS) ? _y1 + STREAM_CHUNK_ROWS : _height;
+				_resampler.SourceRows(_y1, _nextY1, _first, _last);
+
+				const TGA_StreamWindow &_previous = _windows[_current];
+				TGA_StreamWindow &_next = _windows[1 - _current];
+				_reading = std::async(std::launch::async, [this, &_previous, &_next, _first, _last]()
+				{
+					LoadWindow(_previous, _next, _first, _last);
+				});
+			}
+
+			const TGA_StreamWindow &_window = _windows[_current];
+			ImageBuffer &_block = _blocks[_current];
+			_block.Allocate(m_Result.m_ImageWidth, _y1 - y, m_Result.PixelFormat());
+
+			_resampler.Run(_window.m_Rows.m_Data, _window.m_Rows.m_Stride, _window.m_FirstRow, _block.m_Data, _block.m_Stride, y, _y1);
+
+			//the other block buffer is free again once its write is done
+			if (_writing.valid())
+				_writing.get();
+			_writing = std::async(std::launch::async, [this, &_block, &resultFile]()
+			{
+				m_Result.WritePixels(resultFile, _block);
+			});
+
+			if (_reading.valid())
+				_reading.get();
+			_current = 1 - _current;
+		}
+
+		if (_writing.valid())
+			_writing.get();
+	}
+};
\ No newline at end of file
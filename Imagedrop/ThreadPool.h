@@ -0,0 +1,219 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+
+/*
+A small work-stealing thread pool
+- Every worker owns a queue, it pops its own work from the back (the most recent, still hot in cache)
+	and when it runs dry it steals from the front of the other queues (the oldest, biggest chunks of work).
+- The thread that waits on a ParallelFor doesn't sleep, it helps running tasks until its own are done,
+	so nesting a ParallelFor inside a task (batch of images -> bands of an image) can't deadlock the pool.
+- A pool of 1 thread has no workers at all, everything runs inline on the caller.
+*/
+class ThreadPool
+{
+public:
+	struct WorkQueue
+	{
+		std::mutex m_Lock;
+		std::deque<std::function<void()>> m_Tasks;
+	};
+
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+	std::vector<std::thread> m_Threads;
+
+	std::mutex m_WakeLock;
+	std::condition_variable m_Wake;
+	std::atomic<int> m_Pending;
+	std::atomic<unsigned int> m_NextQueue;
+	bool m_Stop;
+
+	//threads count includes the caller thread, 0 means all the hardware threads
+	ThreadPool(unsigned int threads)
+	{
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+		if (threads == 0)
+			threads = 1;
+
+		m_Pending = 0;
+		m_NextQueue = 0;
+		m_Stop = false;
+
+		//queue 0 belongs to the outside threads (main & whoever calls in), the rest to the workers
+		for (unsigned int i = 0; i < threads; i++)
+			m_Queues.emplace_back(new WorkQueue());
+
+		for (unsigned int i = 1; i < threads; i++)
+			m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> _lock(m_WakeLock);
+			m_Stop = true;
+		}
+		m_Wake.notify_all();
+
+		for (size_t i = 0; i < m_Threads.size(); i++)
+			m_Threads[i].join();
+	}
+
+	unsigned int ThreadsCount() const
+	{
+		return (unsigned int)m_Queues.size();
+	}
+
+	//The pool the whole app shares, configured once from the command line before the first use
+	static ThreadPool& Get(unsigned int threads = 0)
+	{
+		static ThreadPool _pool(threads);
+		return _pool;
+	}
+
+	void Submit(std::function<void()> task)
+	{
+		//a worker pushes to its own queue, anyone else spreads the work round robin
+		unsigned int _index = CurrentQueue();
+		if (_index == 0 && m_Queues.size() > 1)
+			_index = 1 + (m_NextQueue++ % (unsigned int)(m_Queues.size() - 1));
+
+		{
+			std::lock_guard<std::mutex> _lock(m_Queues[_index]->m_Lock);
+			m_Queues[_index]->m_Tasks.push_back(std::move(task));
+		}
+
+		m_Pending++;
+		{
+			std::lock_guard<std::mutex> _lock(m_WakeLock);
+		}
+		m_Wake.notify_one();
+	}
+
+	//Runs a queued task on the calling thread if there is one, so a thread waiting on something else helps meanwhile instead of blocking
+	bool HelpOne()
+	{
+		return TryRunOne(CurrentQueue());
+	}
+
+	//Runs body(i) for every i in [0, count) across the pool & returns when all of them are done
+	//a body that throws doesn't stop the others, the first exception is rethrown here once every task is over
+	void ParallelFor(int count, const std::function<void(int)> &body)
+	{
+		if (count <= 0)
+			return;
+
+		if (m_Queues.size() == 1 || count == 1)
+		{
+			for (int i = 0; i < count; i++)
+				body(i);
+			return;
+		}
+
+		std::atomic<int> _remaining(count);
+		std::mutex _errorLock;
+		std::exception_ptr _error;
+		for (int i = 0; i < count; i++)
+		{
+			Submit([&body, &_remaining, &_errorLock, &_error, i]()
+			{
+				//the tasks point at this stack frame, so every path has to count itself done before it leaves
+				try
+				{
+					body(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> _lock(_errorLock);
+					if (!_error)
+						_error = std::current_exception();
+				}
+				_remaining--;
+			});
+		}
+
+		//help instead of blocking, then spin politely on whatever is still running on the other threads
+		unsigned int _index = CurrentQueue();
+		while (_remaining > 0)
+		{
+			if (!TryRunOne(_index))
+				std::this_thread::yield();
+		}
+
+		if (_error)
+			std::rethrow_exception(_error);
+	}
+
+private:
+	static unsigned int& CurrentQueueSlot()
+	{
+		static thread_local unsigned int _index = 0;
+		return _index;
+	}
+
+	static unsigned int CurrentQueue()
+	{
+		return CurrentQueueSlot();
+	}
+
+	bool TryPop(unsigned int index, std::function<void()> &task, bool steal)
+	{
+		WorkQueue &_queue = *m_Queues[index];
+		std::lock_guard<std::mutex> _lock(_queue.m_Lock);
+		if (_queue.m_Tasks.empty())
+			return false;
+
+		if (steal)
+		{
+			task = std::move(_queue.m_Tasks.front());
+			_queue.m_Tasks.pop_front();
+		}
+		else
+		{
+			task = std::move(_queue.m_Tasks.back());
+			_queue.m_Tasks.pop_back();
+		}
+		return true;
+	}
+
+	bool TryRunOne(unsigned int index)
+	{
+		std::function<void()> _task;
+		bool _found = TryPop(index, _task, false);
+
+		for (size_t i = 1; !_found && i < m_Queues.size(); i++)
+			_found = TryPop((unsigned int)((index + i) % m_Queues.size()), _task, true);
+
+		if (!_found)
+			return false;
+
+		m_Pending--;
+		_task();
+		return true;
+	}
+
+	void WorkerLoop(unsigned int index)
+	{
+		CurrentQueueSlot() = index;
+
+		while (true)
+		{
+			if (TryRunOne(index))
+				continue;
+
+			std::unique_lock<std::mutex> _lock(m_WakeLock);
+			m_Wake.wait(_lock, [this]() { return m_Stop || m_Pending > 0; });
+			if (m_Stop)
+				return;
+		}
+	}
+};
\ No newline at end of file
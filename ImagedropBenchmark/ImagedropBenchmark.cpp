@@ -0,0 +1,143 @@
+/*
+The stages benchmark of Imagedrop, read, resize & write timed over synthetic images of many sizes & formats.
+Any optimization comes with its numbers from here, before & after.
+
+The usage:
+	ImagedropBenchmark.exe [options]
+	- Options, as --name=value
+		--sizes=LIST		WxH or N (square) comma separated (default 256 to 16384 squares + 1023x769, 1921x1081, 3001x1999)
+		--depths=LIST		24,32 (default both)
+		--formats=LIST		tga, tga-rle, bmp (default tga,bmp)
+		--scales=LIST		resize factors (default 0.5,0.25,1.5,3.5)
+		--iterations=N		timed runs per stage (default 50)
+		--max-seconds=F		stop a stage early past this (default 2), never under 3 runs
+		--max-mpix=F		skip the images & results bigger than this many megapixels (default 300)
+		--threads=N		threads used to process a single image (default is all the hardware threads)
+		--filter=NAME, --linear, --premultiply	the resize settings, same as Imagedrop.exe
+		--dir=PATH		where the temp files go (default the system temp directory)
+		--label=TEXT		a commit or a machine name, copied into the reports
+		--csv=PATH		the results as CSV
+		--json=PATH		the results as JSON
+	- The pixel checks run first, the exit code is 1 if one fails
+	example:
+		ImagedropBenchmark.exe --sizes=1024,4096 --formats=tga,tga-rle --json=D:\bench\before.json --label=before
+*/
+
+//Includes
+//The headers of the app, from ..\Imagedrop (the project include path)
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include "Settings.h"
+
+//the stages are timed, logging every read & write would be timed along
+#undef USE_LOG
+#define USE_LOG									0
+#undef USE_LOG_IMAGE_DATA
+
+#include "Consts.h"
+#include "Bits.h"
+#include "Macros.h"
+#include "CommandLine.h"
+#include "ThreadPool.h"
+#include "ImageFormatBase.h"
+#include "Profiler.h"
+#include "ImageBuffer.h"
+#include "MappedFile.h"
+#include "ByteOrder.h"
+#include "FileWriter.h"
+#include "CpuFeatures.h"
+#include "LinearLight.h"
+#include "ResampleKernels.h"
+#include "ResampleFilters.h"
+#include "Resampler.h"
+#include "BMPFormat.h"
+#include "TGARLE.h"
+#include "TGAFormat.h"
+#include "FormatConverter.h"
+#include "StageBenchmark.h"
+
+//Splits a comma separated option
+std::vector<std::string> SplitList(const std::string &list)
+{
+	std::vector<std::string> _items;
+	std::stringstream _stream(list);
+	std::string _item;
+	while (std::getline(_stream, _item, ','))
+	{
+		if (!_item.empty())
+			_items.push_back(_item);
+	}
+	return _items;
+}
+
+int main(int argc, char *argv[])
+{
+	CommandLine _commandLine(argc, argv);
+
+	//The pool is created on its first use, so size it before any image work starts, 0 is all the hardware threads
+	int _threads = _commandLine.GetInt("threads", DEFAULT_THREADS);
+	if (_threads < 0)
+	{
+		std::cout << "Unsupported threads count " << _commandLine.Get("threads", "") << std::endl;
+		return 1;
+	}
+	ThreadPool::Get((unsigned int)_threads);
+
+	StageBenchmarkOptions _options;
+	if (_commandLine.Has("sizes"))
+	{
+		_options.m_Sizes.clear();
+		std::vector<std::string> _sizes = SplitList(_commandLine.Get("sizes", ""));
+		for (size_t i = 0; i < _sizes.size(); i++)
+		{
+			int _width = atoi(_sizes[i].c_str());
+			size_t _x = _sizes[i].find('x');
+			int _height = _x == std::string::npos ? _width : atoi(_sizes[i].c_str() + _x + 1);
+			if (_width > 0 && _height > 0)
+				_options.m_Sizes.push_back(std::make_pair(_width, _height));
+		}
+	}
+	if (_commandLine.Has("depths"))
+	{
+		_options.m_Depths.clear();
+		std::vector<std::string> _depths = SplitList(_commandLine.Get("depths", ""));
+		for (size_t i = 0; i < _depths.size(); i++)
+			_options.m_Depths.push_back(atoi(_depths[i].c_str()) == 32 ? 32 : 24);
+	}
+	if (_commandLine.Has("formats"))
+		_options.m_Formats = SplitList(_commandLine.Get("formats", ""));
+	if (_commandLine.Has("scales"))
+	{
+		_options.m_Scales.clear();
+		std::vector<std::string> _scales = SplitList(_commandLine.Get("scales", ""));
+		for (size_t i = 0; i < _scales.size(); i++)
+			_options.m_Scales.push_back((float)atof(_scales[i].c_str()));
+	}
+	_options.m_Iterations = _commandLine.GetInt("iterations", _options.m_Iterations);
+	_options.m_MaxSeconds = _commandLine.GetFloat("max-seconds", float(_options.m_MaxSeconds));
+	_options.m_MaxMegaPixels = _commandLine.GetFloat("max-mpix", float(_options.m_MaxMegaPixels));
+	_options.m_Directory = _commandLine.Get("dir", "");
+	_options.m_Label = _commandLine.Get("label", "");
+
+	_options.m_Resample.m_Linear = _commandLine.Has("linear");
+	_options.m_Resample.m_Premultiplied = _commandLine.Has("premultiply");
+	if (_commandLine.Has("filter") && !ResampleFilters::Parse(_commandLine.Get("filter", ""), _options.m_Resample.m_Filter))
+	{
+		std::cout << "Unknown filter " << _commandLine.Get("filter", "") << std::endl;
+		return 1;
+	}
+
+	if (!StageBenchmark::CheckConversion())
+		return 1;
+
+	StageBenchmark _benchmark(_options);
+	_benchmark.Run();
+
+	if (_commandLine.Has("csv"))
+		_benchmark.WriteCSV(_commandLine.Get("csv", ""));
+	if (_commandLine.Has("json"))
+		_benchmark.WriteJSON(_commandLine.Get("json", ""));
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,397 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include "TGAFormat.h"
+#include "BMPFormat.h"
+#include "FormatConverter.h"
+#include "ResampleKernels.h"
+#include "ThreadPool.h"
+
+/*
+The stages benchmark, the numbers any optimization has to come with
+- Synthetic images are made in memory (gradients + noise, 24 & 32bit, TGA, RLE TGA & BMP), from 256^2 up to
+	16k^2 plus a few odd, non power of two sizes.
+- Every image is written once to a temp file, then read, resized at every scale & written again, many times each.
+	Read & write go through the very same OnImageRead/OnImageWrite of the app (the mapped read, the RLE codec),
+	the files sit in the OS cache after the first run so it's the code that gets timed, not the disk.
+	An uncompressed file is mapped, its read is just the mapping, the pages come in on the first resize touching them.
+- A case runs once untimed (page cache, pool blocks, weight tables), then up to m_Iterations times, stopping
+	early past m_MaxSeconds (never under BENCHMARK_MIN_SAMPLES though).
+- Median & p99 (nearest rank) in ms, MPix/s of the source pixels & GB/s of the bytes in + out of the stage.
+	A resize counts its source & result pixels bytes, a read or a write the file bytes.
+- Sizes whose source or result is over m_MaxMegaPixels are skipped, a 3.5x of 16k^2 is gigabytes of pixels.
+- A few pixel exact checks run before any timing (a conversion that gets the pixels wrong isn't worth timing),
+	a failing one fails the whole run.
+*/
+#define BENCHMARK_MIN_SAMPLES					3
+
+//The numbers of one stage of one image
+struct StageResult
+{
+	std::string m_Stage;						//read, resize or write
+	std::string m_Format;						//tga, tga-rle or bmp
+	int m_Depth;
+	int m_Width;
+	int m_Height;
+	float m_Scale;								//0 for read & write
+	int m_Samples;
+	double m_Median;							//ms
+	double m_P99;								//ms
+	double m_Min;								//ms
+	double m_MegaPixelsPerSecond;
+	double m_GigaBytesPerSecond;
+};
+
+struct StageBenchmarkOptions
+{
+	std::vector<std::pair<int, int>> m_Sizes;
+	std::vector<int> m_Depths;
+	std::vector<std::string> m_Formats;
+	std::vector<float> m_Scales;
+	int m_Iterations;
+	double m_MaxSeconds;						//per stage of an image
+	double m_MaxMegaPixels;
+	ResampleSettings m_Resample;
+	std::string m_Directory;					//where the temp files go
+	std::string m_Label;						//a commit or a machine, copied into the reports
+
+	StageBenchmarkOptions() : m_Iterations(50), m_MaxSeconds(2.0), m_MaxMegaPixels(300.0)
+	{
+		const int _sizes[][2] = { { 256, 256 }, { 512, 512 }, { 1024, 1024 }, { 2048, 2048 }, { 4096, 4096 }, { 8192, 8192 }, { 16384, 16384 },
+			{ 1023, 769 }, { 1921, 1081 }, { 3001, 1999 } };
+		for (size_t i = 0; i < sizeof(_sizes) / sizeof(_sizes[0]); i++)
+			m_Sizes.push_back(std::make_pair(_sizes[i][0], _sizes[i][1]));
+
+		m_Depths = { 24, 32 };
+		m_Formats = { "tga", "bmp" };
+		m_Scales = { 0.5f, 0.25f, 1.5f, 3.5f };
+	}
+};
+
+class StageBenchmark
+{
+public:
+	StageBenchmarkOptions m_Options;
+	std::vector<StageResult> m_Results;
+
+	StageBenchmark(const StageBenchmarkOptions &options) : m_Options(options) {}
+
+	//Smooth gradients (so RLE has runs to find) with noise in the low bits (so it isn't all runs), alpha ramps across
+	static void FillPixels(ImageBuffer &image)
+	{
+		const int _channels = image.Channels();
+		uint32_t _noise = 2463534242u;
+
+		for (int y = 0; y < image.m_Height; y++)
+		{
+			uint8_t *_row = image.Row(y);
+			for (int x = 0; x < image.m_Width; x++, _row += _channels)
+			{
+				_noise ^= _noise << 13;
+				_noise ^= _noise >> 17;
+				_noise ^= _noise << 5;
+
+				uint8_t _low = uint8_t(((x >> 5) & 1) ? _noise & 3 : 0);
+				_row[0] = uint8_t((x * 255 / image.m_Width) ^ _low);
+				_row[1] = uint8_t((y * 255 / image.m_Height) ^ _low);
+				_row[2] = uint8_t(((x + y) >> 3) ^ _low);
+				if (_channels == 4)
+					_row[3] = uint8_t(x * 255 / image.m_Width);
+			}
+		}
+	}
+
+	static void SyntheticTGA(TGA_Format &format, int width, int height, int depth, bool rle)
+	{
+		format.m_IdLength = 0;
+		format.m_ColorMapType = 0;
+		format.m_ImageType = TGA_IMAGE_TYPE_UNCOMPRESSED_TRUE_COLOR;
+		format.m_ColorMapFirstEntryIndex = 0;
+		format.m_ColorMapLength = 0;
+		format.m_ColorMapEntrySize = 0;
+		format.m_ImageOriginX = 0;
+		format.m_ImageOriginY = 0;
+		format.m_ImageWidth = uint16_t(width);
+		format.m_ImageHeigh = uint16_t(height);
+		format.m_ImagePixelDepth = uint8_t(depth);
+		format.m_ImageDescription = uint8_t(depth == 32 ? 8 : 0);
+		format.ApplyCompression(rle ? EOutputCompression::RLE : EOutputCompression::Uncompressed);
+
+		format.m_Image.Allocate(width, height, format.PixelFormat(), format.RowSizeInBytes());
+		FillPixels(format.m_Image);
+	}
+
+	static void SyntheticBMP(BMP_Format &format, int width, int height, int depth)
+	{
+		format.m_Type = 0x4D42;				//BM
+		format.m_Reserved1 = 0;
+		format.m_Reserved2 = 0;
+		format.m_OffsetBits = uint32_t(bmpHeaderSize);
+		format.m_Size = uint32_t(bmpHeaderSize) - 14;
+		format.m_Width = uint32_t(width);
+		format.m_Height = uint32_t(height);
+		format.m_Planes = 1;
+		format.m_BitCount = uint16_t(depth);
+		format.m_Compression = BMP_COMPRESSION_METHOD_BI_RGB;
+		format.m_XPelsPerMeter = 0;
+		format.m_YPelsPerMeter = 0;
+		format.m_ColorsUsed = 0;
+		format.m_ColorsImportant = 0;
+		format.m_SizeImage = uint32_t(format.PixelArraySize());
+		format.m_FileSize = format.m_OffsetBits + format.m_SizeImage;
+
+		format.m_Image.Allocate(width, height, format.PixelFormat(), BMP_Format::RowStride(format.m_Width, format.m_BitCount));
+		format.m_Image.ClearPadding();
+		FillPixels(format.m_Image);
+	}
+
+	/*
+	A right-to-left TGA (both depths, both rows orders) converted to a BMP & read back has to show the very same pixels,
+	a BMP has no right-to-left origin so its columns are the mirrored ones of the TGA
+	*/
+	static bool CheckConversion()
+	{
+		bool _passed = true;
+		const int _depths[] = { 24, 32 };
+		for (int d = 0; d < 2; d++)
+		{
+			for (int topDown = 0; topDown < 2; topDown++)
+			{
+				TGA_Format _source;
+				SyntheticTGA(_source, 37, 5, _depths[d], false);
+				_source.m_ImageDescription |= TGA_SPECIFICATION_DESCRIPTION_RIGHT_TO_LEFT;
+				if (topDown)
+					_source.m_ImageDescription |= TGA_SPECIFICATION_DESCRIPTION_TOP_TO_BOTTOM;
+
+				BMP_Format _converted;
+				FormatConverter::Convert(_source, _converted);
+				std::vector<uint8_t> _file;
+				_converted.OnImageEncode(_file);
+				BMP_Format _result;
+				_result.OnImageDecode(_file.data(), _file.size());
+
+				//the pixel at the same place on screen, counted from the top-left
+				const ImageBuffer &_sourcePixels = _source.m_Image;
+				const ImageBuffer &_resultPixels = _result.m_Image;
+				bool _same = _resultPixels.m_Width == _sourcePixels.m_Width && _resultPixels.m_Height == _sourcePixels.m_Height &&
+					_resultPixels.m_Format == _sourcePixels.m_Format;
+				const int _channels = _sourcePixels.Channels();
+				for (int y = 0; _same && y < _sourcePixels.m_Height; y++)
+				{
+					const uint8_t *_sourceRow = _sourcePixels.Row(_source.IsTopDown() ? y : _sourcePixels.m_Height - 1 - y);
+					const uint8_t *_resultRow = _resultPixels.Row(_result.IsTopDown() ? y : _resultPixels.m_Height - 1 - y);
+					for (int x = 0; _same && x < _sourcePixels.m_Width; x++)
+						_same = memcmp(_sourceRow + (_sourcePixels.m_Width - 1 - x) * _channels, _resultRow + x * _channels, _channels) == 0;
+				}
+
+				std::cout << "check   right-to-left " << (topDown ? "top-down " : "bottom-up ") << _depths[d] << "bit tga -> bmp: "
+					<< (_same ? "OK" : "FAILED") << std::endl;
+				_passed = _passed && _same;
+			}
+		}
+		return _passed;
+	}
+
+	//Runs function once untimed, then times it, in ms per run
+	template<typename Function>
+	std::vector<double> Measure(Function function)
+	{
+		function();
+
+		std::vector<double> _samples;
+		std::chrono::high_resolution_clock::time_point _caseStart = std::chrono::high_resolution_clock::now();
+		while (int(_samples.size()) < m_Options.m_Iterations)
+		{
+			std::chrono::high_resolution_clock::time_point _startTime = std::chrono::high_resolution_clock::now();
+			function();
+			std::chrono::high_resolution_clock::time_point _endTime = std::chrono::high_resolution_clock::now();
+			_samples.push_back(std::chrono::duration<double, std::milli>(_endTime - _startTime).count());
+
+			std::chrono::duration<double> _elapsed = _endTime - _caseStart;
+			if (_samples.size() >= BENCHMARK_MIN_SAMPLES && _elapsed.count() > m_Options.m_MaxSeconds)
+				break;
+		}
+		return _samples;
+	}
+
+	void AddResult(const char *stage, const std::string &format, int depth, int width, int height, float scale,
+		std::vector<double> &samples, double bytes)
+	{
+		std::sort(samples.begin(), samples.end());
+		const size_t _count = samples.size();
+
+		StageResult _result;
+		_result.m_Stage = stage;
+		_result.m_Format = format;
+		_result.m_Depth = depth;
+		_result.m_Width = width;
+		_result.m_Height = height;
+		_result.m_Scale = scale;
+		_result.m_Samples = int(_count);
+		_result.m_Median = (_count % 2) ? samples[_count / 2] : (samples[_count / 2 - 1] + samples[_count / 2]) * 0.5;
+		_result.m_P99 = samples[size_t(std::ceil(0.99 * _count)) - 1];
+		_result.m_Min = samples[0];
+		_result.m_MegaPixelsPerSecond = double(width) * height / (_result.m_Median * 1e3);
+		_result.m_GigaBytesPerSecond = bytes / (_result.m_Median * 1e6);
+		m_Results.push_back(_result);
+
+		std::cout << std::left << std::setw(8) << _result.m_Stage << std::setw(9) << _result.m_Format << std::right
+			<< std::setw(4) << depth << std::setw(7) << width << "x" << std::left << std::setw(7) << height << std::right
+			<< std::setw(6) << std::setprecision(3) << std::defaultfloat << scale
+			<< std::fixed << std::setprecision(3) << std::setw(12) << _result.m_Median << std::setw(12) << _result.m_P99
+			<< std::setprecision(1) << std::setw(13) << _result.m_MegaPixelsPerSecond
+			<< std::setprecision(2) << std::setw(11) << _result.m_GigaBytesPerSecond
+			<< std::setw(6) << _result.m_Samples << std::defaultfloat << std::endl;
+	}
+
+	static double FileBytes(const std::string &path)
+	{
+		return double(std::experimental::filesystem::file_size(path));
+	}
+
+	//The read, write & resizes of a synthetic image, Format is TGA_Format or BMP_Format
+	template<typename Format>
+	void RunImage(Format &source, const std::string &name, const char *extension, int depth, int width, int height)
+	{
+		std::experimental::filesystem::path _directory = m_Options.m_Directory.empty() ?
+			std::experimental::filesystem::temp_directory_path() : std::experimental::filesystem::path(m_Options.m_Directory);
+		const std::string _sourcePath = (_directory / (std::string("imagedrop_benchmark_source.") + extension)).string();
+		const std::string _resultPath = (_directory / (std::string("imagedrop_benchmark_result.") + extension)).string();
+		const double _pixelBytes = double(width) * height * (depth / 8);
+
+		source.OnImageWrite(_sourcePath.c_str());
+		const double _fileBytes = FileBytes(_sourcePath);
+
+		std::vector<double> _samples = Measure([&]()
+		{
+			Format _format;
+			_format.OnImageRead(_sourcePath.c_str());
+		});
+		AddResult("read", name, depth, width, height, 0.0f, _samples, _fileBytes);
+
+		//the loaded one is the source of the resizes, a mapped view for the uncompressed files, like the app has it
+		Format _loaded;
+		_loaded.OnImageRead(_sourcePath.c_str());
+		for (size_t s = 0; s < m_Options.m_Scales.size(); s++)
+		{
+			const float _scale = m_Options.m_Scales[s];
+			const double _resultPixels = double(int(width * _scale)) * int(height * _scale);
+			if (_resultPixels < 1.0 || _resultPixels > m_Options.m_MaxMegaPixels * 1e6)
+				continue;
+
+			_samples = Measure([&]()
+			{
+				Format _resized;
+				_loaded.OnImageResize(_resized, _scale, m_Options.m_Resample);
+			});
+			AddResult("resize", name, depth, width, height, _scale, _samples, _pixelBytes + _resultPixels * (depth / 8));
+		}
+
+		_samples = Measure([&]()
+		{
+			source.OnImageWrite(_resultPath.c_str());
+		});
+		AddResult("write", name, depth, width, height, 0.0f, _samples, _fileBytes);
+
+		//the mapping has to go before the file
+		_loaded.m_Mapping.Close();
+		std::experimental::filesystem::remove(_sourcePath);
+		std::experimental::filesystem::remove(_resultPath);
+	}
+
+	void Run()
+	{
+		const char *_kernels[] = { "Reference", "Scalar", "SSE2", "AVX2" };
+		std::cout << "=================S=T=A=G=E=S====================" << "\n";
+		std::cout << "Kernel: " << _kernels[ResampleKernels::Detect()] << ", threads: " << ThreadPool::Get().ThreadsCount() << "\n";
+		std::cout << std::left << std::setw(8) << "stage" << std::setw(9) << "format" << std::right << std::setw(4) << "bit"
+			<< std::setw(15) << "size" << std::setw(6) << "scale" << std::setw(12) << "median ms" << std::setw(12) << "p99 ms"
+			<< std::setw(13) << "MPix/s" << std::setw(11) << "GB/s" << std::setw(6) << "runs" << std::endl;
+
+		for (size_t i = 0; i < m_Options.m_Sizes.size(); i++)
+		{
+			const int _width = m_Options.m_Sizes[i].first;
+			const int _height = m_Options.m_Sizes[i].second;
+			if (double(_width) * _height > m_Options.m_MaxMegaPixels * 1e6)
+			{
+				std::cout << "skipped " << _width << "x" << _height << ", over --max-mpix" << std::endl;
+				continue;
+			}
+
+			for (size_t d = 0; d < m_Options.m_Depths.size(); d++)
+			{
+				const int _depth = m_Options.m_Depths[d];
+				for (size_t f = 0; f < m_Options.m_Formats.size(); f++)
+				{
+					const std::string &_name = m_Options.m_Formats[f];
+					if (_name == "bmp")
+					{
+						BMP_Format _source;
+						SyntheticBMP(_source, _width, _height, _depth);
+						RunImage(_source, _name, "bmp", _depth, _width, _height);
+					}
+					else
+					{
+						//TGA sizes are 16bit
+						if (_width > 65535 || _height > 65535)
+							continue;
+
+						TGA_Format _source;
+						SyntheticTGA(_source, _width, _height, _depth, _name == "tga-rle");
+						RunImage(_source, _name, "tga", _depth, _width, _height);
+					}
+				}
+			}
+		}
+		std::cout << "================================================" << std::endl;
+	}
+
+	void WriteCSV(const std::string &path) const
+	{
+		std::ofstream _file(path);
+		_file << "label,stage,format,depth,width,height,scale,samples,median_ms,p99_ms,min_ms,mpix_s,gb_s\n";
+		for (size_t i = 0; i < m_Results.size(); i++)
+		{
+			const StageResult &_result = m_Results[i];
+			_file << m_Options.m_Label << "," << _result.m_Stage << "," << _result.m_Format << "," << _result.m_Depth << ","
+				<< _result.m_Width << "," << _result.m_Height << "," << _result.m_Scale << "," << _result.m_Samples << ","
+				<< _result.m_Median << "," << _result.m_P99 << "," << _result.m_Min << ","
+				<< _result.m_MegaPixelsPerSecond << "," << _result.m_GigaBytesPerSecond << "\n";
+		}
+	}
+
+	void WriteJSON(const std::string &path) const
+	{
+		const char *_kernels[] = { "Reference", "Scalar", "SSE2", "AVX2" };
+
+		std::ofstream _file(path);
+		_file << "{\n";
+		_file << "\t\"label\": \"" << m_Options.m_Label << "\",\n";
+		_file << "\t\"kernel\": \"" << _kernels[ResampleKernels::Detect()] << "\",\n";
+		_file << "\t\"threads\": " << ThreadPool::Get().ThreadsCount() << ",\n";
+		_file << "\t\"filter\": \"" << ResampleFilters::Name(m_Options.m_Resample.m_Filter) << "\",\n";
+		_file << "\t\"linear\": " << (m_Options.m_Resample.m_Linear ? "true" : "false") << ",\n";
+		_file << "\t\"premultiplied\": " << (m_Options.m_Resample.m_Premultiplied ? "true" : "false") << ",\n";
+		_file << "\t\"results\": [\n";
+		for (size_t i = 0; i < m_Results.size(); i++)
+		{
+			const StageResult &_result = m_Results[i];
+			_file << "\t\t{ \"stage\": \"" << _result.m_Stage << "\", \"format\": \"" << _result.m_Format << "\", \"depth\": " << _result.m_Depth
+				<< ", \"width\": " << _result.m_Width << ", \"height\": " << _result.m_Height << ", \"scale\": " << _result.m_Scale
+				<< ", \"samples\": " << _result.m_Samples << ", \"median_ms\": " << _result.m_Median << ", \"p99_ms\": " << _result.m_P99
+				<< ", \"min_ms\": " << _result.m_Min << ", \"mpix_s\": " << _result.m_MegaPixelsPerSecond
+				<< ", \"gb_s\": " << _result.m_GigaBytesPerSecond << " }" << (i + 1 < m_Results.size() ? "," : "") << "\n";
+		}
+		_file << "\t]\n";
+		_file << "}\n";
+	}
+};
\ No newline at end of file